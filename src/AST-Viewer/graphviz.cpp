@@ -7,10 +7,12 @@
 #include "graphviz.hpp"
 
 #include "Lucy/AST.hpp"
+#include "Lucy/Visitor.hpp"
 
 namespace {
 
-class GraphContext {
+class GraphContext : public AST::Visitor<GraphContext> {
+	friend class AST::Visitor<GraphContext>;
 public:
 	GraphContext(const AST::Chunk &root);
 	GraphContext(const GraphContext &) = delete;
@@ -24,15 +26,15 @@ public:
 
 private:
 	struct GraphNode {
-		GraphNode(const char *label, const yy::location &loc, Agnode_t *node)
-			: label{label}, loc{loc}, node{node} {}
+		GraphNode(const char *label, const Location &loc, Agnode_t *node)
+			: label{label}, loc{loc.resolve()}, node{node} {}
 
 		std::string label;
-		yy::location loc;
+		SourceRange loc;
 		Agnode_t *node = nullptr;
 	};
 
-	unsigned createNode(const char *label, const yy::location &loc)
+	unsigned createNode(const char *label, const Location &loc)
 	{
 		const unsigned nodeIdx = m_graphNodes.size();
 		char buff[25];
@@ -46,7 +48,7 @@ private:
 		return nodeIdx;
 	}
 
-	void pushNode(const char *label, const yy::location &loc)
+	void pushNode(const char *label, const Location &loc)
 	{
 		const unsigned parentIdx = m_nodeStack.back(), curIdx = createNode(label, loc);
 
@@ -60,14 +62,19 @@ private:
 		m_nodeStack.pop_back();
 	}
 
-	void walk(const AST::Assignment &assignment);
-	void walk(const AST::BinOp &binOp);
-	void walk(const AST::ExprList &exprList);
-	void walk(const AST::LValue &lval);
-	void walk(const AST::NestedExpr &expr);
-	void walk(const AST::Node &node);
-	void walk(const AST::UnOp &unOp);
-	void walk(const AST::VarList &varList);
+	void visit(const AST::Assignment &assignment);
+	void visit(const AST::BinOp &binOp);
+	void visit(const AST::LValue &lval);
+	void visit(const AST::UnOp &unOp);
+
+	/* other nodes are labelled by their type */
+	template <typename T>
+	void visit(const T &node)
+	{
+		pushNode(node.type(), node.location());
+		visitChildren(node);
+		popNode();
+	}
 
 	Agraph_t *m_graph = nullptr;
 	std::vector <GraphNode> m_graphNodes;
@@ -82,8 +89,7 @@ GraphContext::GraphContext(const AST::Chunk &root)
 	agattr(m_graph, AGNODE, const_cast<char *>("comment"), const_cast<char *>(""));
 
 	m_nodeStack.push_back(createNode("Chunk", root.location()));
-	for (const auto &n : root.children())
-		walk(*n);
+	visitChildren(root);
 }
 
 GraphContext::~GraphContext()
@@ -134,74 +140,30 @@ void GraphContext::reload(std::vector <Node> &nodes, std::vector <Edge> &edges,
 	edges = std::move(m_edges);
 }
 
-void GraphContext::walk(const AST::Assignment &assignment)
+void GraphContext::visit(const AST::Assignment &assignment)
 {
 	pushNode("=", assignment.location());
-	walk(assignment.varList());
-	walk(assignment.exprList());
+	visitChildren(assignment);
 	popNode();
 }
 
-void GraphContext::walk(const AST::BinOp &binOp)
+void GraphContext::visit(const AST::BinOp &binOp)
 {
 	pushNode(binOp.toString(), binOp.location());
-	walk(binOp.left());
-	walk(binOp.right());
-	popNode();
-}
-
-void GraphContext::walk(const AST::ExprList &exprList)
-{
-	pushNode("ExprList", exprList.location());
-	for (const auto &e : exprList.exprs())
-		walk(*e);
-	popNode();
-}
-
-void GraphContext::walk(const AST::LValue &lval)
-{
-	pushNode(lval.resolveName().c_str(), lval.location());
+	visitChildren(binOp);
 	popNode();
 }
 
-void GraphContext::walk(const AST::NestedExpr &expr)
+void GraphContext::visit(const AST::LValue &lval)
 {
-	pushNode("NestedExpr", expr.location());
-	walk(expr.expr());
+	pushNode(lval.resolveName().str().c_str(), lval.location());
 	popNode();
 }
 
-void GraphContext::walk(const AST::Node &node)
-{
-	#define SUBCASE(type) case AST::Node::Type::type: walk(static_cast<const AST::type &>(node)); break
-
-	switch (node.type().value()) {
-		SUBCASE(Assignment);
-		SUBCASE(BinOp);
-		SUBCASE(LValue);
-		SUBCASE(NestedExpr);
-		SUBCASE(UnOp);
-		default:
-			pushNode(node.type(), node.location());
-			popNode();
-			break;
-	}
-
-	#undef SUBCASE
-}
-
-void GraphContext::walk(const AST::UnOp &unOp)
+void GraphContext::visit(const AST::UnOp &unOp)
 {
 	pushNode(unOp.toString(), unOp.location());
-	walk(unOp.operand());
-	popNode();
-}
-
-void GraphContext::walk(const AST::VarList &varList)
-{
-	pushNode("VarList", varList.location());
-	for (const auto &v : varList.vars())
-		walk(*v);
+	visitChildren(unOp);
 	popNode();
 }
 
@@ -3,7 +3,7 @@
 #include <string>
 #include <vector>
 
-#include "location.hh"
+#include "Location.hpp"
 
 struct Rect {
 	float x, y, width, height;
@@ -12,7 +12,7 @@ struct Rect {
 struct Node {
 	Rect r;
 	std::string label;
-	yy::location codeLocation;
+	SourceRange codeLocation;
 };
 
 struct Edge {
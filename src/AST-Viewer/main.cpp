@@ -11,7 +11,9 @@
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_opengl3.h"
 
-#include "Lucy/Driver.hpp"
+#include "Lucy/AnalysisSession.hpp"
+#include "Lucy/AST.hpp"
+#include "Lucy/IncrementalParser.hpp"
 #include "graphviz.hpp"
 
 std::ostream & operator << (std::ostream &os, const ImVec2 &vec);
@@ -64,25 +66,23 @@ int sourceEditCallback(ImGuiInputTextCallbackData *data)
 	return 0;
 }
 
-ASTGenState generateAST(const std::string &luaCode)
+/* the source is parsed on every change, generating the AST only takes a copy of the current tree */
+ASTGenState generateAST(AnalysisSession &session, const IncrementalParser &parser, const std::string &parseErrors)
 {
-	std::istringstream ss{luaCode};
-	Driver d;
-	d.setInputStream(&ss);
-
-	std::ostringstream errorStream;
-	d.setErrorStream(&errorStream);
-
 	ASTGenState result;
-	result.luaCode = luaCode;
-	if (result.luaCode.back() == '\n')
+	result.luaCode = parser.text();
+	if (!result.luaCode.empty() && result.luaCode.back() == '\n')
 		result.luaCode.pop_back();
 
-	if (d.parse() != 0) {
-		result.errorLog = errorStream.str();
+	if (!parser.chunk()) {
+		result.errorLog = parseErrors.empty() ? "Parse error\n" : parseErrors;
 	} else {
-		result.astRoot = std::move(d.chunks()[0]);
-		result.graph.prepare(*result.astRoot);
+		/* string literals of the tree are read from the text of the session */
+		session.run([&result, &parser]() {
+			result.astRoot = parser.chunk()->clone<AST::Chunk>();
+			result.graph.prepare(*result.astRoot);
+			return 0;
+		});
 
 		std::ostringstream ss;
 		ss << "View##" << result.astRoot.get();
@@ -93,7 +93,7 @@ ASTGenState generateAST(const std::string &luaCode)
 	return result;
 }
 
-void renderCode(const std::vector <std::string_view> &code, yy::location highlight)
+void renderCode(const std::vector <std::string_view> &code, SourceRange highlight)
 {
 	auto *drawList = ImGui::GetWindowDrawList();
 	const auto textColor = ImGui::GetColorU32(ImGuiCol_Text);
@@ -257,6 +257,18 @@ int main()
 	bool done = false;
 	std::string buffer = "a = b + c\nx = 2 + 3 * 4";
 
+	/* unrecognized input aborts the session, not the viewer */
+	AnalysisSession session;
+	std::ostringstream parseErrors;
+	session.setOutput(parseErrors);
+
+	std::unique_ptr <IncrementalParser> parser;
+	session.run([&]() {
+		parser = std::make_unique<IncrementalParser>("<editor>");
+		parser->setErrorStream(&parseErrors);
+		return parser->parse(buffer);
+	});
+
 	std::vector <ASTGenState> astViews;
 	std::string astError;
 
@@ -284,11 +296,18 @@ int main()
 				ImGuiInputTextFlags_AllowTabInput | ImGuiInputTextFlags_CallbackResize,
 				sourceEditCallback, &buffer);
 
+			if (buffer != parser->text()) {
+				parseErrors.str("");
+				session.run([&]() {
+					return parser->edit(IncrementalParser::diff(parser->text(), buffer));
+				});
+			}
+
 			if (!astError.empty())
 				ImGui::Text(astError.data());
 
 			if (ImGui::Button("Generate AST")) {
-				auto ast = generateAST(buffer);
+				auto ast = generateAST(session, *parser, parseErrors.str());
 				astError.clear();
 				if (!ast.errorLog.empty()) {
 					astError = std::move(ast.errorLog);
@@ -302,7 +321,7 @@ int main()
 			while (idx < astViews.size()) {
 				auto &ast = astViews[idx];
 				if (ast.show) {
-					static yy::location codeHighlight;
+					static SourceRange codeHighlight;
 
 					ImGui::Begin(ast.windowId.c_str(), &ast.show);
 					renderCode(ast.lines, codeHighlight);
@@ -315,7 +334,7 @@ int main()
 					std::vector <ImVec2> nodeCenter;
 
 					drawList->ChannelsSetCurrent(1);
-					codeHighlight.initialize();
+					codeHighlight = SourceRange{};
 					for (const auto &n : nodes) {
 						ImGui::SetCursorPos(ImVec2{n.r.x, pos.y + n.r.y});
 						ImGui::Button(n.label.c_str());
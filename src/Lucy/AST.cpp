@@ -1,14 +1,46 @@
+#include "AnalysisSession.hpp"
 #include "AST.hpp"
+#include "Driver.hpp"
+#include "Logger.hpp"
 
-namespace {
-	const std::string EmptyString;
+namespace AST {
+
+void Function::parseBody() const
+{
+	const SourceFile &source = AnalysisSession::current().sourceFile(m_body.file);
+	if (!source.text())
+		FATAL(location() << " : Text of the skipped function body is no longer available\n");
+
+	/* the body is parsed as a chunk of its own, skipping nested function bodies again */
+	const uint32_t end = m_body.end - (sizeof("end") - 1);
+
+	Driver driver;
+	driver.setErrorStream(&Logger::log());
+	driver.setLazyFunctions(true);
+	if (driver.parseRange(m_body.file, m_body.begin, end) != 0)
+		Logger::abort();
+
+	m_chunk = std::move(driver.chunks()[0]);
+
+	/* as parsed in place, an empty body is located at its end */
+	if (m_chunk->isEmpty())
+		m_chunk = std::make_unique<Chunk>(Location{m_body.file, end, m_body.end});
 }
 
-namespace AST {
+std::string_view StringValue::value() const
+{
+	if (m_delimiter == 0)
+		return m_value;
+
+	const Location &loc = location();
+	const SourceFile &source = AnalysisSession::current().sourceFile(loc.file);
+	if (!source.text())
+		FATAL(loc << " : Text of the string literal is no longer available\n");
 
-const Chunk Chunk::Empty;
+	return std::string_view{source.text() + loc.begin + m_delimiter, loc.end - loc.begin - 2u * m_delimiter};
+}
 
-const std::string & LValue::resolveName() const
+SymbolId LValue::resolveName() const
 {
 	if (m_type == LValue::Type::Name)
 		return name();
@@ -16,10 +48,219 @@ const std::string & LValue::resolveName() const
 	if (m_tableExpr->type() != Node::Type::LValue) {
 		LOG(Logger::Warning, location() << " : nontrivial (" << m_tableExpr->type() << ") expression for table name\n");
 		assert(m_tableExpr->type() == Node::Type::LValue);
-		return EmptyString;
+		return SymbolId{};
 	}
 
 	return static_cast<const LValue *>(m_tableExpr.get())->resolveName();
 }
 
+TableCtor::TableCtor(std::vector <TableField> &&fields, const Location &location)
+	: Node{location}
+{
+	m_fields.reserve(fields.size());
+	for (auto &f : fields) {
+		switch (f.type) {
+			case Field::Type::Brackets:
+				append(std::make_unique<Field>(std::move(f.key), std::move(f.value), f.location));
+				break;
+			case Field::Type::Literal:
+				append(std::make_unique<Field>(f.name, std::move(f.value), f.location));
+				break;
+			case Field::Type::NoIndex:
+				append(std::make_unique<Field>(std::move(f.value), f.location));
+				break;
+		}
+	}
+}
+
+std::unique_ptr <ConstTable> ConstTable::fromFields(const std::shared_ptr <ConstTableStorage> &storage, const std::vector <TableField> &fields,
+	const Location &location)
+{
+	for (const auto &f : fields) {
+		if (f.type == Field::Type::Brackets) {
+			if (!f.key->isValue() || static_cast<const Value &>(*f.key).valueType() == ValueType::Nil)
+				return nullptr;
+		}
+
+		if (!f.value->isValue() && f.value->type() != Node::Type::ConstTable)
+			return nullptr;
+	}
+
+	/* the nested tables are the last ones stored, this table follows them */
+	ConstTableStorage &data = *storage;
+	Range tables{static_cast<uint32_t>(data.tables.size()), 0};
+	Range entries{static_cast<uint32_t>(data.fields.size()), 0};
+
+	for (const auto &f : fields) {
+		if (f.value->type() == Node::Type::ConstTable) {
+			const auto &nested = static_cast<const ConstTable &>(*f.value);
+			assert(nested.m_storage == storage);
+			tables.first = std::min(tables.first, nested.m_tables.first);
+			entries.first = std::min(entries.first, nested.m_fields.first);
+		}
+	}
+
+	const uint32_t first = data.fields.size();
+	for (const auto &f : fields) {
+		Entry entry{f.type, f.name, Item{}, item(*f.value, f.location.begin), f.location, f.value->location().begin - f.location.begin};
+		if (f.type == Field::Type::Brackets)
+			entry.key = item(*f.key, f.location.begin);
+		data.fields.push_back(entry);
+	}
+	data.tables.push_back(Table{Range{first, static_cast<uint32_t>(fields.size())}, location});
+
+	tables.size = data.tables.size() - tables.first;
+	entries.size = data.fields.size() - entries.first;
+	return std::unique_ptr <ConstTable>{new ConstTable{location, storage, tables, entries}};
+}
+
+ConstTable::ConstTable(const ConstTable &other)
+	: Node{other.location()}, m_storage{std::make_shared<ConstTableStorage>()},
+	  m_tables{0, other.m_tables.size}, m_fields{0, other.m_fields.size}
+{
+	/* ids and ranges are moved to start at 0 */
+	for (TableId id = other.m_tables.first; id != other.m_tables.end(); ++id) {
+		Table table = other.table(id);
+		table.fields.first -= other.m_fields.first;
+		m_storage->tables.push_back(table);
+	}
+
+	for (uint32_t idx = other.m_fields.first; idx != other.m_fields.end(); ++idx) {
+		Entry entry = other.field(idx);
+		if (entry.value.type == ValueType::Table)
+			entry.value.table -= other.m_tables.first;
+		m_storage->fields.push_back(entry);
+	}
+}
+
+std::string_view ConstTable::string(const Entry &field, Range range) const
+{
+	const SourceFile &source = AnalysisSession::current().sourceFile(field.location.file);
+	if (!source.text())
+		FATAL(field.location << " : Text of the constant table is no longer available\n");
+
+	return std::string_view{source.text() + field.location.begin + range.first, range.size};
+}
+
+ConstTable::Item ConstTable::item(const Node &node, uint32_t fieldBegin)
+{
+	Item result;
+
+	if (node.type() == Node::Type::ConstTable) {
+		result.type = ValueType::Table;
+		result.table = static_cast<const ConstTable &>(node).root();
+		return result;
+	}
+
+	const auto &value = static_cast<const Value &>(node);
+	result.type = value.valueType();
+	switch (value.valueType().value()) {
+		case ValueType::Boolean:
+			result.boolean = static_cast<const BooleanValue &>(value).value();
+			break;
+		case ValueType::Integer:
+			result.integer = static_cast<const IntValue &>(value).value();
+			break;
+		case ValueType::Real:
+			result.real = static_cast<const RealValue &>(value).value();
+			break;
+		case ValueType::String: {
+			/* parsed literals only, their text is not copied */
+			const auto &string = static_cast<const StringValue &>(value);
+			assert(string.delimiter() != 0);
+			const Location &loc = string.location();
+			result.string = Range{loc.begin + string.delimiter() - fieldBegin, loc.end - loc.begin - 2 * string.delimiter()};
+			break;
+		}
+		default:
+			break;
+	}
+
+	return result;
+}
+
+void ConstTable::print(unsigned indent) const
+{
+	printLocation(indent);
+	do_indent(indent);
+	std::cout << "Const table:\n";
+
+	const Table &root = table(this->root());
+	for (uint32_t i = root.fields.first; i != root.fields.end(); ++i) {
+		do_indent(indent + 1);
+		std::cout << field(i).location << '\n';
+		do_indent(indent + 1);
+		printField(std::cout, field(i), false);
+		std::cout << '\n';
+	}
+}
+
+void ConstTable::printField(std::ostream &os, const Entry &field, bool escape) const
+{
+	switch (field.type) {
+		case Field::Type::Brackets:
+			os << '[';
+			printItem(os, field, field.key, escape);
+			os << "] = ";
+			break;
+		case Field::Type::Literal:
+			os << field.name << " = ";
+			break;
+		case Field::Type::NoIndex:
+			break;
+	}
+
+	printItem(os, field, field.value, escape);
+}
+
+void ConstTable::printItem(std::ostream &os, const Entry &field, const Item &item, bool escape) const
+{
+	switch (item.type.value()) {
+		case ValueType::Boolean:
+			os << (item.boolean ? "true" : "false");
+			break;
+		case ValueType::Integer:
+			os << item.integer;
+			break;
+		case ValueType::Real:
+			os << item.real;
+			break;
+		case ValueType::String:
+			os << '"';
+			if (!escape) {
+				os << string(field, item.string);
+			} else {
+				for (char c : string(field, item.string)) {
+					switch (c) {
+						case '<': os << "&lt;"; break;
+						case '>': os << "&gt;"; break;
+						case '&': os << "&amp;"; break;
+						default: os << c;
+					}
+				}
+			}
+			os << '"';
+			break;
+		case ValueType::Table:
+			printTable(os, item.table, escape);
+			break;
+		default:
+			os << "nil";
+			break;
+	}
+}
+
+void ConstTable::printTable(std::ostream &os, TableId id, bool escape) const
+{
+	const Range fields = table(id).fields;
+
+	os << "{ ";
+	for (uint32_t i = fields.first; i != fields.end(); ++i) {
+		if (i != fields.first)
+			os << ", ";
+		printField(os, field(i), escape);
+	}
+	os << " }";
+}
+
 }
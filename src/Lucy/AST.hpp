@@ -2,20 +2,32 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include "EnumHelpers.hpp"
+#include "Location.hpp"
 #include "Logger.hpp"
+#include "Symbol.hpp"
 #include "ValueType.hpp"
 #include "ValueVariant.hpp"
 
+class IncrementalParser;
+
 namespace AST {
 
+class CachedTree;
+
 class Node {
+	friend class CachedTree;
+	friend class ::IncrementalParser;
 public:
 	EnumClass(Type, uint32_t,
 		Chunk,
@@ -30,6 +42,7 @@ public:
 		Assignment,
 		Value,
 		TableCtor,
+		ConstTable,
 		Field,
 		BinOp,
 		UnOp,
@@ -55,7 +68,7 @@ public:
 		os << "-- INVALID (" << type().value() << ')';
 	}
 
-	constexpr Node(const yy::location &location = yy::location{}) : m_location{location} {}
+	constexpr Node(const Location &location = Location{}) : m_location{location} {}
 	virtual ~Node() = default;
 	Node(Node &&) = default;
 
@@ -75,7 +88,7 @@ public:
 		return std::unique_ptr <T>{static_cast<T *>(clone().release())};
 	}
 
-	const yy::location & location() const
+	const Location & location() const
 	{
 		return m_location;
 	}
@@ -92,10 +105,10 @@ protected:
 			os << '\t';
 	}
 
-	void extendLocation(const yy::location &location)
+	void extendLocation(const Location &location)
 	{
-		if (m_location.begin.filename == nullptr)
-			m_location.begin.filename = location.begin.filename;
+		if (m_location.file == NoFile)
+			m_location.file = location.file;
 		m_location.end = location.end;
 	}
 
@@ -106,25 +119,117 @@ protected:
 	}
 
 private:
-	yy::location m_location;
+	Location m_location;
+};
+
+/*
+ * Owning link to a child node. Nodes desugared during analysis (see
+ * ControlFlowGraph::rewrite) refer to subtrees of the parsed tree through
+ * borrowed links instead of copies, those are not deleted with the parent.
+ * Nodes are aligned, the lowest bit of the address marks a borrowed one, so a
+ * link is as large as a plain pointer. Constness is deep, a borrowed node is
+ * const and reachable through const links only.
+ */
+template <typename T>
+class NodePtr {
+	template <typename U>
+	friend class NodePtr;
+public:
+	constexpr NodePtr() = default;
+	constexpr NodePtr(std::nullptr_t) {}
+	template <typename U, typename = std::enable_if_t<std::is_convertible_v<U *, T *> > >
+	NodePtr(std::unique_ptr <U> &&node) : m_bits{address(node.release())} {}
+	template <typename U, typename = std::enable_if_t<std::is_convertible_v<U *, T *> > >
+	NodePtr(NodePtr <U> &&other) : m_bits{address(other.pointer()) | (other.m_bits & Borrowed)} { other.m_bits = 0; }
+	NodePtr(NodePtr &&other) noexcept : m_bits{other.m_bits} { other.m_bits = 0; }
+	NodePtr(const NodePtr &) = delete;
+	~NodePtr() { reset(); }
+
+	NodePtr & operator = (NodePtr &&other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			m_bits = other.m_bits;
+			other.m_bits = 0;
+		}
+		return *this;
+	}
+	void operator = (const NodePtr &) = delete;
+
+	/* the node has to outlive the tree it is borrowed into */
+	static NodePtr borrowed(const T &node)
+	{
+		static_assert(alignof(T) > Borrowed, "the tag needs the lowest bit of node addresses");
+
+		NodePtr result;
+		result.m_bits = address(&node) | Borrowed;
+		return result;
+	}
+
+	bool isBorrowed() const { return m_bits & Borrowed; }
+
+	const T * get() const { return pointer(); }
+	T * get()
+	{
+		assert(!isBorrowed());
+		return pointer();
+	}
+
+	const T & operator * () const { return *get(); }
+	T & operator * () { return *get(); }
+	const T * operator -> () const { return get(); }
+	T * operator -> () { return get(); }
+	explicit operator bool () const { return m_bits != 0; }
+
+	friend bool operator == (const NodePtr &ptr, std::nullptr_t) { return !ptr; }
+	friend bool operator != (const NodePtr &ptr, std::nullptr_t) { return static_cast<bool>(ptr); }
+
+	void reset()
+	{
+		if (!isBorrowed())
+			delete pointer();
+		m_bits = 0;
+	}
+
+private:
+	static constexpr uintptr_t Borrowed = 1;
+
+	static uintptr_t address(const T *node) { return reinterpret_cast<uintptr_t>(node); }
+	T * pointer() const { return reinterpret_cast<T *>(m_bits & ~Borrowed); }
+
+	uintptr_t m_bits = 0;
 };
 
+/* the node has to outlive the tree it is borrowed into */
+template <typename T>
+NodePtr <T> borrow(const T &node)
+{
+	return NodePtr <T>::borrowed(node);
+}
+
 class Chunk : public Node {
 	friend std::unique_ptr <Chunk> std::make_unique<Chunk>(const Chunk &);
+	friend class ::IncrementalParser;
 public:
-	static const Chunk Empty;
-
-	Chunk(const yy::location &location = yy::location{}) : Node{location} {}
+	Chunk(const Location &location = Location{}) : Node{location} {}
 
 	bool isEmpty() const { return m_children.empty(); }
 
-	void append(std::unique_ptr <Node> &&n)
+	void append(NodePtr <Node> &&n)
 	{
-		extendLocation(n->location());
+		extendLocation(std::as_const(n)->location());
 		m_children.emplace_back(std::move(n));
 	}
 
-	const std::vector <std::unique_ptr <Node> > & children() const { return m_children; }
+	/* moves the statements of other to the end of this chunk */
+	void splice(Chunk &&other)
+	{
+		for (auto &n : other.m_children)
+			append(std::move(n));
+		other.m_children.clear();
+	}
+
+	const std::vector <NodePtr <Node> > & children() const { return m_children; }
 
 	void print(unsigned indent = 0) const override
 	{
@@ -152,27 +257,21 @@ private:
 			m_children.emplace_back(n->clone());
 	}
 
-	std::vector <std::unique_ptr <Node> > m_children;
+	std::vector <NodePtr <Node> > m_children;
 };
 
 class ParamList : public Node {
-	friend class Function;
 	friend std::unique_ptr <ParamList> std::make_unique<ParamList>(const ParamList &);
+	friend class ::IncrementalParser;
 public:
-	ParamList(const yy::location &location = yy::location{}) : Node{location}, m_ellipsis{false} {}
+	ParamList(const Location &location = Location{}) : Node{location}, m_ellipsis{false} {}
 
-	void append(const std::string &name, const yy::location &location = yy::location{})
+	void append(SymbolId name, const Location &location = Location{})
 	{
 		m_names.emplace_back(name, location);
 		extendLocation(location);
 	}
 
-	void append(std::string &&name, const yy::location &location = yy::location{})
-	{
-		m_names.emplace_back(std::move(name), location);
-		extendLocation(location);
-	}
-
 	bool hasEllipsis() const { return m_ellipsis; }
 	void setEllipsis() { m_ellipsis = true; };
 
@@ -211,7 +310,7 @@ public:
 		os << " )";
 	}
 
-	const std::vector <std::pair <std::string, yy::location> > & names() const { return m_names; }
+	const std::vector <std::pair <SymbolId, Location> > & names() const { return m_names; }
 
 	Node::Type type() const override { return Type::ParamList; }
 
@@ -228,22 +327,22 @@ private:
 	{
 	}
 
-	std::vector <std::pair <std::string, yy::location> > m_names;
+	std::vector <std::pair <SymbolId, Location> > m_names;
 	bool m_ellipsis;
 };
 
 class ExprList : public Node {
 	friend std::unique_ptr <ExprList> std::make_unique<ExprList>(const ExprList &);
 public:
-	ExprList(const yy::location &location = yy::location{}) : Node{location} {}
+	ExprList(const Location &location = Location{}) : Node{location} {}
 
-	void append(std::unique_ptr <Node> &&n)
+	void append(NodePtr <Node> &&n)
 	{
-		extendLocation(n->location());
+		extendLocation(std::as_const(n)->location());
 		m_exprs.emplace_back(std::move(n));
 	}
 
-	void prepend(std::unique_ptr <Node> &&n)
+	void prepend(NodePtr <Node> &&n)
 	{
 		m_exprs.emplace(m_exprs.begin(), std::move(n));
 	}
@@ -251,7 +350,7 @@ public:
 	bool empty() const { return m_exprs.empty(); }
 	size_t size() const { return m_exprs.size(); }
 
-	const std::vector <std::unique_ptr <Node> > & exprs() const { return m_exprs; }
+	const std::vector <NodePtr <Node> > & exprs() const { return m_exprs; }
 
 	void print(unsigned indent = 0) const override
 	{
@@ -293,13 +392,13 @@ private:
 			m_exprs.emplace_back(n->clone());
 	}
 
-	std::vector <std::unique_ptr <Node> > m_exprs;
+	std::vector <NodePtr <Node> > m_exprs;
 };
 
 class NestedExpr : public Node {
 	friend std::unique_ptr <NestedExpr> std::make_unique<NestedExpr>(const NestedExpr &);
 public:
-	NestedExpr(std::unique_ptr <Node> &&expr, const yy::location &location = yy::location{})
+	NestedExpr(NodePtr <Node> &&expr, const Location &location = Location{})
 		: Node{location}, m_expr{std::move(expr)}
 	{
 	}
@@ -334,7 +433,7 @@ private:
 	{
 	}
 
-	std::unique_ptr <Node> m_expr;
+	NodePtr <Node> m_expr;
 };
 
 class LValue : public Node {
@@ -346,31 +445,21 @@ public:
 		Name,
 	};
 
-	LValue(std::unique_ptr <Node> &&tableExpr, std::unique_ptr <Node> &&keyExpr, const yy::location &location = yy::location{})
+	LValue(NodePtr <Node> &&tableExpr, NodePtr <Node> &&keyExpr, const Location &location = Location{})
 		: Node{location}, m_type{Type::Bracket}, m_tableExpr{std::move(tableExpr)}, m_keyExpr{std::move(keyExpr)}
 	{
 	}
 
-	LValue(std::unique_ptr <Node> &&tableExpr, const std::string &fieldName, const yy::location &location = yy::location{})
+	LValue(NodePtr <Node> &&tableExpr, SymbolId fieldName, const Location &location = Location{})
 		: Node{location}, m_type{Type::Dot}, m_tableExpr{std::move(tableExpr)}, m_name{fieldName}
 	{
 	}
 
-	LValue(std::unique_ptr <Node> &&tableExpr, std::string &&fieldName, const yy::location &location = yy::location{})
-		: Node{location}, m_type{Type::Dot}, m_tableExpr{std::move(tableExpr)}, m_name{std::move(fieldName)}
-	{
-	}
-
-	LValue(const std::string &varName, const yy::location &location = yy::location{})
+	LValue(SymbolId varName, const Location &location = Location{})
 		: Node{location}, m_type{Type::Name}, m_name{varName}
 	{
 	}
 
-	LValue(std::string &&varName, const yy::location &location = yy::location{})
-		: Node{location}, m_type{Type::Name}, m_name{std::move(varName)}
-	{
-	}
-
 	void print(unsigned indent = 0) const override
 	{
 		printLocation(indent);
@@ -417,11 +506,11 @@ public:
 		}
 	}
 
-	const std::string & name() const { return m_name; }
+	SymbolId name() const { return m_name; }
 	const Node & tableExpr() const { return *m_tableExpr; }
 	const Node & keyExpr() const { return *m_keyExpr; }
 
-	const std::string & resolveName() const;
+	SymbolId resolveName() const;
 
 	Type lvalueType() const { return m_type; }
 	Node::Type type() const override { return Node::Type::LValue; }
@@ -455,29 +544,29 @@ private:
 	}
 
 	Type m_type;
-	std::unique_ptr <Node> m_tableExpr;
-	std::unique_ptr <Node> m_keyExpr;
-	std::string m_name;
+	NodePtr <Node> m_tableExpr;
+	NodePtr <Node> m_keyExpr;
+	SymbolId m_name;
 };
 
 class VarList : public Node {
 	friend std::unique_ptr <VarList> std::make_unique<VarList>(const VarList &);
 public:
-	VarList(const yy::location &location = yy::location{}) : Node{location} {}
+	VarList(const Location &location = Location{}) : Node{location} {}
 
-	VarList(std::initializer_list <const char *> varNames, const yy::location &location = yy::location{}) : Node{location}
+	VarList(std::initializer_list <const char *> varNames, const Location &location = Location{}) : Node{location}
 	{
 		for (auto varName : varNames)
 			append(std::make_unique<LValue>(varName));
 	}
 
-	void append(std::unique_ptr <LValue> &&lval)
+	void append(NodePtr <LValue> &&lval)
 	{
-		extendLocation(lval->location());
+		extendLocation(std::as_const(lval)->location());
 		m_vars.emplace_back(std::move(lval));
 	}
 
-	const std::vector <std::unique_ptr <LValue> > & vars() const
+	const std::vector <NodePtr <LValue> > & vars() const
 	{
 		return m_vars;
 	}
@@ -522,12 +611,12 @@ private:
 			m_vars.emplace_back(n->clone<LValue>());
 	}
 
-	std::vector <std::unique_ptr <LValue> > m_vars;
+	std::vector <NodePtr <LValue> > m_vars;
 };
 
 class Ellipsis : public Node {
 public:
-	constexpr Ellipsis(const yy::location &location) : Node{location} {}
+	constexpr Ellipsis(const Location &location) : Node{location} {}
 
 	void print(unsigned indent = 0) const override
 	{
@@ -547,36 +636,36 @@ public:
 class Assignment : public Node {
 	friend std::unique_ptr <Assignment> std::make_unique<Assignment>(const Assignment &);
 public:
-	Assignment(std::unique_ptr <LValue> &&lval, std::unique_ptr <Node> &&expr, const yy::location &location = yy::location{})
+	Assignment(NodePtr <LValue> &&lval, NodePtr <Node> &&expr, const Location &location = Location{})
 		: Node{location}, m_varList{std::make_unique<VarList>()}, m_exprList{std::make_unique<ExprList>()}, m_local{false}
 	{
 		m_varList->append(std::move(lval));
 		m_exprList->append(std::move(expr));
 	}
 
-	Assignment(const std::string &name, std::unique_ptr <Node> &&expr, const yy::location &location = yy::location{})
+	Assignment(SymbolId name, NodePtr <Node> &&expr, const Location &location = Location{})
 		: Node{location}, m_varList{std::make_unique<VarList>()}, m_exprList{std::make_unique<ExprList>()}, m_local{false}
 	{
 		m_varList->append(std::make_unique<LValue>(name)); //TODO name location
 		m_exprList->append(std::move(expr));
 	}
 
-	Assignment(const std::string &dstVar, const std::string &srcVar, const yy::location &location = yy::location{})
+	Assignment(SymbolId dstVar, SymbolId srcVar, const Location &location = Location{})
 		: Assignment{dstVar, std::make_unique<LValue>(srcVar), location} //TODO dstVar, srcVar location
 	{
 	}
 
-	Assignment(std::unique_ptr <VarList> &&vl, std::unique_ptr <ExprList> &&el, const yy::location &location = yy::location{})
+	Assignment(NodePtr <VarList> &&vl, NodePtr <ExprList> &&el, const Location &location = Location{})
 		: Node{location}, m_varList{std::move(vl)}, m_exprList{std::move(el)}, m_local{false}
 	{
 		if (!m_exprList)
 			m_exprList = std::make_unique<ExprList>();
 	}
 
-	Assignment(std::unique_ptr <ParamList> &&pl, std::unique_ptr <ExprList> &&el, const yy::location &location = yy::location{})
+	Assignment(NodePtr <ParamList> &&pl, NodePtr <ExprList> &&el, const Location &location = Location{})
 		: Node{location}, m_varList{std::make_unique<VarList>()}, m_exprList{std::move(el)}, m_local{true}
 	{
-		for (const auto &name : pl->names())
+		for (const auto &name : std::as_const(pl)->names())
 			m_varList->append(std::make_unique<LValue>(name.first, name.second));
 
 		if (!m_exprList)
@@ -632,14 +721,14 @@ private:
 	{
 	}
 
-	std::unique_ptr <VarList> m_varList;
-	std::unique_ptr <ExprList> m_exprList;
+	NodePtr <VarList> m_varList;
+	NodePtr <ExprList> m_exprList;
 	bool m_local;
 };
 
 class Value : public Node {
 public:
-	constexpr Value(const yy::location &location) : Node{location} {}
+	constexpr Value(const Location &location) : Node{location} {}
 
 	bool isValue() const override { return true; }
 
@@ -651,7 +740,7 @@ public:
 
 class NilValue : public Value {
 public:
-	constexpr NilValue(const yy::location &location = yy::location{}) : Value{location} {}
+	constexpr NilValue(const Location &location = Location{}) : Value{location} {}
 
 	void print(unsigned indent = 0) const override
 	{
@@ -676,7 +765,7 @@ public:
 
 class BooleanValue : public Value {
 public:
-	constexpr BooleanValue(bool v, const yy::location &location = yy::location{}) : Value{location}, m_value{v} {}
+	constexpr BooleanValue(bool v, const Location &location = Location{}) : Value{location}, m_value{v} {}
 
 	void print(unsigned indent = 0) const override
 	{
@@ -707,22 +796,30 @@ private:
 	bool m_value;
 };
 
+/*
+ * A literal of the source text only keeps its location, its value is read
+ * from the text between the delimiters when needed. Values of other strings,
+ * as of copies of a tree which may outlive the text, are held by the node.
+ */
 class StringValue : public Value {
 public:
-	StringValue(const std::string &v, const yy::location &location = yy::location{}) : Value{location}, m_value{v} {}
-	StringValue(std::string &&v, const yy::location &location = yy::location{}) : Value{location}, m_value{std::move(v)} {}
+	/* literal: the value as lexed, a view of the text at location inside its delimiters */
+	StringValue(std::string_view literal, const Location &location)
+		: Value{location}, m_delimiter{static_cast<uint8_t>((location.end - location.begin - literal.size()) / 2)} {}
+	StringValue(const std::string &v, const Location &location = Location{}) : Value{location}, m_value{v} {}
+	StringValue(std::string &&v, const Location &location = Location{}) : Value{location}, m_value{std::move(v)} {}
 
 	void print(unsigned indent = 0) const override
 	{
 		printLocation(indent);
 		do_indent(indent);
-		std::cout << "String: " << m_value << '\n';
+		std::cout << "String: " << value() << '\n';
 	}
 
 	void printCode(std::ostream &os) const override
 	{
 		os << '"';
-		for (char c : m_value) {
+		for (char c : value()) {
 			switch (c) {
 				case '<': os << "&lt;"; break;
 				case '>': os << "&gt;"; break;
@@ -734,22 +831,26 @@ public:
 	}
 
 	ValueType valueType() const override { return ValueType::String; }
-	ValueVariant toValueVariant() const override { return m_value; }
+	ValueVariant toValueVariant() const override { return value(); }
 
-	const std::string & value() const { return m_value; }
+	std::string_view value() const;
+	/* length of each delimiter of a literal read from the text, 0 if the value is held */
+	unsigned delimiter() const { return m_delimiter; }
 
 	std::unique_ptr <Node> clone() const override
 	{
-		return std::make_unique<StringValue>(m_value, location());
+		return std::make_unique<StringValue>(std::string{value()}, location());
 	}
 
 private:
 	std::string m_value;
+	/* length of the delimiters of a literal read from the text, 0 if the value is held */
+	uint8_t m_delimiter = 0;
 };
 
 class IntValue : public Value {
 public:
-	constexpr IntValue(long v, const yy::location &location = yy::location{}) : Value{location}, m_value{v} {}
+	constexpr IntValue(long v, const Location &location = Location{}) : Value{location}, m_value{v} {}
 
 	void print(unsigned indent = 0) const override
 	{
@@ -779,7 +880,7 @@ private:
 
 class RealValue : public Value {
 public:
-	constexpr RealValue(double v, const yy::location &location = yy::location{}) : Value{location}, m_value{v} {}
+	constexpr RealValue(double v, const Location &location = Location{}) : Value{location}, m_value{v} {}
 
 	void print(unsigned indent = 0) const override
 	{
@@ -810,7 +911,7 @@ private:
 class FunctionCall : public Node {
 	friend std::unique_ptr <FunctionCall> std::make_unique<FunctionCall>(const FunctionCall &);
 public:
-	FunctionCall(std::unique_ptr <Node> &&funcExpr, std::unique_ptr <ExprList> &&args, const yy::location &location = yy::location{})
+	FunctionCall(NodePtr <Node> &&funcExpr, NodePtr <ExprList> &&args, const Location &location = Location{})
 		: Node{location}, m_functionExpr{std::move(funcExpr)}, m_args{std::move(args)}
 	{
 	}
@@ -858,29 +959,19 @@ protected:
 	{
 	}
 
-	std::unique_ptr <Node> cloneCallExpr() const
-	{
-		return m_functionExpr->clone();
-	}
-
 private:
-	std::unique_ptr <Node> m_functionExpr;
-	std::unique_ptr <ExprList> m_args;
+	NodePtr <Node> m_functionExpr;
+	NodePtr <ExprList> m_args;
 };
 
 class MethodCall : public FunctionCall {
 	friend std::unique_ptr <MethodCall> std::make_unique<MethodCall>(const MethodCall &);
 public:
-	MethodCall(std::unique_ptr <Node> &&funcExpr, std::unique_ptr <ExprList> &&args, const std::string &methodName, const yy::location &location = yy::location{})
+	MethodCall(NodePtr <Node> &&funcExpr, NodePtr <ExprList> &&args, SymbolId methodName, const Location &location = Location{})
 		: FunctionCall{std::move(funcExpr), std::move(args), location}, m_methodName{methodName}
 	{
 	}
 
-	MethodCall(std::unique_ptr <Node> &&funcExpr, std::unique_ptr <ExprList> &&args, std::string &&methodName, const yy::location &location = yy::location{})
-		: FunctionCall{std::move(funcExpr), std::move(args), location}, m_methodName{std::move(methodName)}
-	{
-	}
-
 	void print(unsigned indent = 0) const override
 	{
 		printLocation(indent);
@@ -907,6 +998,8 @@ public:
 		os << " )";
 	}
 
+	SymbolId methodName() const { return m_methodName; }
+
 	Node::Type type() const override { return Type::MethodCall; }
 
 	std::unique_ptr <Node> clone() const override
@@ -914,13 +1007,14 @@ public:
 		return std::make_unique<MethodCall>(*this);
 	}
 
-	std::unique_ptr <FunctionCall> cloneAsFunctionCall() const
+	/* obj:name(args) as obj.name(obj, args), borrowing the subtrees of this call */
+	std::unique_ptr <FunctionCall> desugar() const
 	{
-		auto fnCallExpr = std::make_unique<LValue>(cloneCallExpr(), m_methodName);
+		auto fnCallExpr = std::make_unique<LValue>(borrow(functionExpr()), m_methodName);
 		auto methodArgs = std::make_unique<ExprList>();
-		methodArgs->append(cloneCallExpr());
+		methodArgs->append(borrow(functionExpr()));
 		for (const auto &e : args().exprs())
-			methodArgs->append(e->clone());
+			methodArgs->append(borrow(*e));
 		return std::make_unique<FunctionCall>(std::move(fnCallExpr), std::move(methodArgs), location());
 	}
 
@@ -931,7 +1025,7 @@ private:
 	{
 	}
 
-	std::string m_methodName;
+	SymbolId m_methodName;
 };
 
 class Field : public Node {
@@ -943,17 +1037,17 @@ public:
 		NoIndex,
 	};
 
-	Field(std::unique_ptr <Node> &&expr, std::unique_ptr <Node> &&val, const yy::location &location = yy::location{})
+	Field(NodePtr <Node> &&expr, NodePtr <Node> &&val, const Location &location = Location{})
 		: Node{location}, m_type{Type::Brackets}, m_keyExpr{std::move(expr)}, m_valueExpr{std::move(val)}
 	{
 	}
 
-	Field(const std::string &s, std::unique_ptr <Node> &&val, const yy::location &location = yy::location{})
-		: Node{location}, m_type{Type::Literal}, m_fieldName{s}, m_valueExpr{std::move(val)}
+	Field(SymbolId name, NodePtr <Node> &&val, const Location &location = Location{})
+		: Node{location}, m_type{Type::Literal}, m_fieldName{name}, m_valueExpr{std::move(val)}
 	{
 	}
 
-	Field(std::unique_ptr <Node> &&val, const yy::location &location = yy::location{})
+	Field(NodePtr <Node> &&val, const Location &location = Location{})
 		: Node{location}, m_type{Type::NoIndex}, m_keyExpr{nullptr}, m_valueExpr{std::move(val)}
 	{
 	}
@@ -1002,7 +1096,7 @@ public:
 
 	Node::Type type() const override { return Node::Type::Field; }
 
-	const std::string & fieldName() const { return m_fieldName; }
+	SymbolId fieldName() const { return m_fieldName; }
 	const Node & keyExpr() const { return *m_keyExpr; }
 	const Node & valueExpr() const { return *m_valueExpr; }
 
@@ -1035,17 +1129,27 @@ private:
 	}
 
 	Type m_type;
-	std::string m_fieldName;
-	std::unique_ptr <Node> m_keyExpr;
-	std::unique_ptr <Node> m_valueExpr;
+	SymbolId m_fieldName;
+	NodePtr <Node> m_keyExpr;
+	NodePtr <Node> m_valueExpr;
+};
+
+/* field of a table constructor as parsed, it becomes a Field node or an entry of a ConstTable */
+struct TableField {
+	Field::Type type;
+	SymbolId name;
+	NodePtr <Node> key;
+	NodePtr <Node> value;
+	Location location;
 };
 
 class TableCtor : public Node {
 	friend std::unique_ptr <TableCtor> std::make_unique<TableCtor>(const TableCtor &);
 public:
-	TableCtor(const yy::location &location = yy::location{}) : Node{location} {}
+	TableCtor(const Location &location = Location{}) : Node{location} {}
+	TableCtor(std::vector <TableField> &&fields, const Location &location);
 
-	void append(std::unique_ptr <Field> &&f) { m_fields.emplace_back(std::move(f)); }
+	void append(NodePtr <Field> &&f) { m_fields.emplace_back(std::move(f)); }
 
 	void print(unsigned indent = 0) const override
 	{
@@ -1072,7 +1176,7 @@ public:
 		os << " }";
 	}
 
-	const std::vector <std::unique_ptr <Field> > & fields() const { return m_fields; }
+	const std::vector <NodePtr <Field> > & fields() const { return m_fields; }
 
 	Node::Type type() const override { return Node::Type::TableCtor; }
 
@@ -1088,9 +1192,121 @@ private:
 			m_fields.emplace_back(f->clone<Field>());
 	}
 
-	std::vector <std::unique_ptr <Field> > m_fields;
+	std::vector <NodePtr <Field> > m_fields;
 };
 
+/*
+ * Table constructor with literal keys and values only, nested constructors of
+ * the same kind included. Instead of Field and Value nodes, the fields are
+ * entries of a ConstTableStorage shared by the constant tables parsed by one
+ * Driver: every (nested) table is a range of its fields, a literal is a range
+ * of tables ending with its root. Nested tables are stored when they are
+ * parsed and only referred to by their parent, strings are views of the
+ * source text as in StringValue. Analyses see the table as a single value,
+ * the IR refers to it instead of building it field by field.
+ */
+class ConstTable : public Node {
+	friend class CachedTree;
+	friend class ::IncrementalParser;
+public:
+	using TableId = uint32_t;
+
+	struct Range {
+		uint32_t first;
+		uint32_t size;
+
+		uint32_t end() const { return first + size; }
+	};
+
+	/* literal key or value, nested tables by their id, strings by their range in the text relative to the start of the field */
+	struct Item {
+		ValueType type = ValueType::Nil;
+		union {
+			bool boolean;
+			long integer;
+			double real;
+			Range string;
+			TableId table;
+		};
+	};
+
+	/* Literal fields have a name instead of a key, the key is nil for them and for NoIndex */
+	struct Entry {
+		Field::Type type;
+		SymbolId name;
+		Item key;
+		Item value;
+		Location location;
+		/* the value ends with the field */
+		uint32_t valueOffset;
+
+		Location valueLocation() const { return Location{location.file, location.begin + valueOffset, location.end}; }
+	};
+
+	struct Table {
+		Range fields;
+		Location location;
+	};
+
+	/*
+	 * Constant form of a constructor with fields, nullptr unless all of its
+	 * keys and values are literal. Its entries are appended to storage, which
+	 * has to hold the constant tables nested in it.
+	 */
+	static std::unique_ptr <ConstTable> fromFields(const std::shared_ptr <ConstTableStorage> &storage, const std::vector <TableField> &fields,
+		const Location &location);
+
+	void print(unsigned indent = 0) const override;
+	void printCode(std::ostream &os) const override { printTable(os, root(), true); }
+
+	TableId root() const { return m_tables.end() - 1; }
+	inline const Table & table(TableId id) const;
+	inline const Entry & field(uint32_t idx) const;
+	size_t fieldCount() const { return m_fields.size; }
+	/* text of the string item of field */
+	std::string_view string(const Entry &field, Range range) const;
+
+	Node::Type type() const override { return Node::Type::ConstTable; }
+
+	std::unique_ptr <Node> clone() const override
+	{
+		return std::unique_ptr <ConstTable>{new ConstTable{*this}};
+	}
+
+private:
+	ConstTable(const Location &location, std::shared_ptr <ConstTableStorage> storage, Range tables, Range fields)
+		: Node{location}, m_storage{std::move(storage)}, m_tables{tables}, m_fields{fields} {}
+
+	/* copies only the tables of this literal, to a storage of its own */
+	ConstTable(const ConstTable &other);
+
+	static Item item(const Node &node, uint32_t fieldBegin);
+	/* escape: strings are escaped as StringValue::printCode() does */
+	void printField(std::ostream &os, const Entry &field, bool escape) const;
+	void printItem(std::ostream &os, const Entry &field, const Item &item, bool escape) const;
+	void printTable(std::ostream &os, TableId id, bool escape) const;
+
+	std::shared_ptr <ConstTableStorage> m_storage;
+	/* tables (the root is the last one) and fields of this literal in m_storage */
+	Range m_tables;
+	Range m_fields;
+};
+
+struct ConstTableStorage {
+	std::vector <ConstTable::Table> tables;
+	std::vector <ConstTable::Entry> fields;
+};
+
+const ConstTable::Table & ConstTable::table(TableId id) const
+{
+	return m_storage->tables[id];
+}
+
+const ConstTable::Entry & ConstTable::field(uint32_t idx) const
+{
+	return m_storage->fields[idx];
+}
+
 class BinOp : public Node {
 	friend std::unique_ptr <BinOp> std::make_unique<BinOp>(const BinOp &);
 public:
@@ -1112,7 +1328,7 @@ public:
 		Exponentation
 	);
 
-	BinOp(Type t, std::unique_ptr <Node> &&left, std::unique_ptr <Node> &&right, const yy::location &location = yy::location{})
+	BinOp(Type t, NodePtr <Node> &&left, NodePtr <Node> &&right, const Location &location = Location{})
 		: Node{location}, m_type{t}, m_left{std::move(left)}, m_right{std::move(right)}
 	{
 	}
@@ -1192,8 +1408,8 @@ private:
 	}
 
 	Type m_type;
-	std::unique_ptr <Node> m_left;
-	std::unique_ptr <Node> m_right;
+	NodePtr <Node> m_left;
+	NodePtr <Node> m_right;
 };
 
 class UnOp : public Node {
@@ -1205,7 +1421,7 @@ public:
 		Length
 	);
 
-	UnOp(Type t, std::unique_ptr <Node> &&op, const yy::location &location = yy::location{})
+	UnOp(Type t, NodePtr <Node> &&op, const Location &location = Location{})
 		: Node{location}, m_type{t}, m_operand{std::move(op)}
 	{
 	}
@@ -1252,12 +1468,12 @@ private:
 	}
 
 	Type m_type;
-	std::unique_ptr <Node> m_operand;
+	NodePtr <Node> m_operand;
 };
 
 class Break : public Node {
 public:
-	Break(const yy::location &location = yy::location{}) : Node{location} {}
+	Break(const Location &location = Location{}) : Node{location} {}
 
 	void print(unsigned indent = 0) const override
 	{
@@ -1282,7 +1498,7 @@ public:
 class Return : public Node {
 	friend std::unique_ptr <Return> std::make_unique<Return>(const Return &);
 public:
-	Return(std::unique_ptr <ExprList> &&exprList, const yy::location &location = yy::location{})
+	Return(NodePtr <ExprList> &&exprList, const Location &location = Location{})
 		: Node{location}, m_exprList{std::move(exprList)}
 	{
 	}
@@ -1313,46 +1529,46 @@ private:
 	{
 	}
 
-	std::unique_ptr <ExprList> m_exprList;
+	NodePtr <ExprList> m_exprList;
 };
 
 class FunctionName : public Node {
 	friend std::unique_ptr <FunctionName> std::make_unique<FunctionName>(const FunctionName &);
 public:
-	FunctionName(std::string &&base, const yy::location &location = yy::location{})
+	FunctionName(SymbolId base, const Location &location = Location{})
 		: Node{location}
 	{
-		m_name.emplace_back(std::move(base));
+		m_name.emplace_back(base);
 	}
 
 	bool isMethod() const { return !m_method.empty(); }
 	bool isNested() const { return m_name.size() > 1; }
-	const std::vector <std::string> & nameParts() const { return m_name; }
-	const std::string & method() const { return m_method; }
+	const std::vector <SymbolId> & nameParts() const { return m_name; }
+	SymbolId method() const { return m_method; }
 
-	void appendMethodName(std::string &&methodName, const yy::location &location)
+	void appendMethodName(SymbolId methodName, const Location &location)
 	{
-		m_method = std::move(methodName);
+		m_method = methodName;
 		extendLocation(location);
 	}
 
-	void appendNamePart(std::string &&namePart, const yy::location &location)
+	void appendNamePart(SymbolId namePart, const Location &location)
 	{
-		m_name.emplace_back(std::move(namePart));
+		m_name.emplace_back(namePart);
 		extendLocation(location);
 	}
 
 	std::string fullName() const
 	{
-		std::string result = m_name[0];
+		std::string result = m_name[0].str();
 		for (auto iter = m_name.cbegin() + 1; iter != m_name.cend(); ++iter) {
 			result.push_back('.');
-			result += *iter;
+			result += iter->str();
 		}
 
 		if (!m_method.empty()) {
 			result.push_back(':');
-			result += m_method;
+			result += m_method.str();
 		}
 
 		return result;
@@ -1375,25 +1591,37 @@ private:
 	{
 	}
 
-	std::vector <std::string> m_name;
-	std::string m_method;
+	std::vector <SymbolId> m_name;
+	SymbolId m_method;
 };
 
 class Function : public Node {
 	friend std::unique_ptr <Function> std::make_unique<Function>(const Function &);
+	friend class ::IncrementalParser;
 public:
-	Function(std::unique_ptr <ParamList> &&params, std::unique_ptr <Chunk> &&chunk, const yy::location &location = yy::location{})
+	Function(NodePtr <ParamList> &&params, NodePtr <Chunk> &&chunk, const Location &location = Location{})
 		: Node{location}, m_params{std::move(params)}, m_chunk{std::move(chunk)}, m_local{false}
 	{
+		if (!m_chunk)
+			m_chunk = std::make_unique<Chunk>();
 	}
 
+	/* function with the body at body (up to and including its end) left unparsed by a lazy parse */
+	Function(NodePtr <ParamList> &&params, const Location &body, const Location &location)
+		: Node{location}, m_params{std::move(params)}, m_body{body}, m_local{false}
+	{
+	}
+
+	/* parses a skipped body first, the text of the file has to be still available */
 	const Chunk & chunk() const
 	{
 		if (!m_chunk)
-			return Chunk::Empty;
+			parseBody();
 		return *m_chunk;
 	}
 
+	bool isBodyParsed() const { return m_chunk != nullptr; }
+
 	bool isAnonymous() const { return !m_name; }
 	bool isLocal() const { return m_local; }
 	bool isMethod() const { return m_name && m_name->isMethod(); }
@@ -1411,20 +1639,12 @@ public:
 		return m_name->fullName();
 	}
 
-	void clearName()
+	void setName(SymbolId name)
 	{
-		if (m_name->isMethod()) {
-			m_params->m_names.insert(m_params->m_names.begin(), std::make_pair("self", yy::location{}));
-		}
-		m_name.reset();
+		m_name = std::make_unique<FunctionName>(name);
 	}
 
-	void setName(std::string &&name)
-	{
-		m_name = std::make_unique<FunctionName>(std::move(name));
-	}
-
-	void setName(std::unique_ptr <FunctionName> &&name)
+	void setName(NodePtr <FunctionName> &&name)
 	{
 		m_name = std::move(name);
 	}
@@ -1448,12 +1668,7 @@ public:
 
 		do_indent(indent);
 		std::cout << "body:\n";
-		if (m_chunk) {
-			m_chunk->print(indent + 1);
-		} else {
-			do_indent(indent + 1);
-			std::cout << "<empty>\n";
-		}
+		chunk().print(indent + 1);
 	}
 
 	void printCode(std::ostream &os) const override
@@ -1489,20 +1704,24 @@ private:
 		  m_name{other.m_name ? other.m_name->clone<FunctionName>() : nullptr},
 		  m_params{other.m_params ? other.m_params->clone<ParamList>() : nullptr},
 		  m_chunk{other.m_chunk ? other.m_chunk->clone<Chunk>() : nullptr},
+		  m_body{other.m_body},
 		  m_local{other.m_local}
 	{
 	}
 
-	std::unique_ptr <FunctionName> m_name;
-	std::unique_ptr <ParamList> m_params;
-	std::unique_ptr <Chunk> m_chunk;
+	void parseBody() const;
+
+	NodePtr <FunctionName> m_name;
+	NodePtr <ParamList> m_params;
+	mutable NodePtr <Chunk> m_chunk;
+	Location m_body;
 	bool m_local;
 };
 
 class If : public Node {
 	friend std::unique_ptr <If> std::make_unique<If>(const If &);
 public:
-	If(std::unique_ptr <Node> &&condition, std::unique_ptr <Chunk> &&chunk, const yy::location &location = yy::location{})
+	If(NodePtr <Node> &&condition, NodePtr <Chunk> &&chunk, const Location &location = Location{})
 		: Node{location}
 	{
 		m_conditions.emplace_back(std::move(condition));
@@ -1511,12 +1730,12 @@ public:
 
 	bool hasElse() const { return m_else.get() != nullptr; }
 
-	const std::vector <std::unique_ptr <Chunk> > & chunks() const { return m_chunks; }
-	const std::vector <std::unique_ptr <Node> > & conditions() const { return m_conditions; }
+	const std::vector <NodePtr <Chunk> > & chunks() const { return m_chunks; }
+	const std::vector <NodePtr <Node> > & conditions() const { return m_conditions; }
 	const Chunk & elseNode() const { return *m_else; }
-	void setElse(std::unique_ptr <Chunk> &&chunk) { m_else = std::move(chunk); }
+	void setElse(NodePtr <Chunk> &&chunk) { m_else = std::move(chunk); }
 
-	void addElseIf(std::unique_ptr <Node> &&condition, std::unique_ptr <Chunk> &&chunk)
+	void addElseIf(NodePtr <Node> &&condition, NodePtr <Chunk> &&chunk)
 	{
 		m_conditions.emplace_back(std::move(condition));
 		appendChunk(std::move(chunk));
@@ -1552,12 +1771,12 @@ public:
 	}
 
 private:
-	void appendChunk(std::unique_ptr <Chunk> &&chunk)
+	void appendChunk(NodePtr <Chunk> &&chunk)
 	{
 		if (chunk)
 			m_chunks.emplace_back(std::move(chunk));
 		else
-			m_chunks.emplace_back(Chunk::Empty.clone<Chunk>());
+			m_chunks.emplace_back(std::make_unique<Chunk>());
 	}
 
 	If(const If &other)
@@ -1571,15 +1790,15 @@ private:
 			m_else = other.m_else->clone<Chunk>();
 	}
 
-	std::vector <std::unique_ptr <Node> > m_conditions;
-	std::vector <std::unique_ptr <Chunk> > m_chunks;
-	std::unique_ptr <Chunk> m_else;
+	std::vector <NodePtr <Node> > m_conditions;
+	std::vector <NodePtr <Chunk> > m_chunks;
+	NodePtr <Chunk> m_else;
 };
 
 class While : public Node {
 	friend std::unique_ptr <While> std::make_unique<While>(const While &);
 public:
-	While(std::unique_ptr <Node> &&condition, std::unique_ptr <Chunk> &&chunk, const yy::location &location = yy::location{})
+	While(NodePtr <Node> &&condition, NodePtr <Chunk> &&chunk, const Location &location = Location{})
 		: Node{location}, m_condition{std::move(condition)}, m_chunk{std::move(chunk)}
 	{
 	}
@@ -1611,14 +1830,14 @@ private:
 	{
 	}
 
-	std::unique_ptr <Node> m_condition;
-	std::unique_ptr <Chunk> m_chunk;
+	NodePtr <Node> m_condition;
+	NodePtr <Chunk> m_chunk;
 };
 
 class Repeat : public Node {
 	friend std::unique_ptr <Repeat> std::make_unique<Repeat>(const Repeat &);
 public:
-	Repeat(std::unique_ptr <Node> &&condition, std::unique_ptr <Chunk> &&chunk, const yy::location &location = yy::location{})
+	Repeat(NodePtr <Node> &&condition, NodePtr <Chunk> &&chunk, const Location &location = Location{})
 		: Node{location}, m_condition{std::move(condition)}, m_chunk{std::move(chunk)}
 	{
 	}
@@ -1650,14 +1869,14 @@ private:
 	{
 	}
 
-	std::unique_ptr <Node> m_condition;
-	std::unique_ptr <Chunk> m_chunk;
+	NodePtr <Node> m_condition;
+	NodePtr <Chunk> m_chunk;
 };
 
 class For : public Node {
 	friend std::unique_ptr <For> std::make_unique<For>(const For &);
 public:
-	For(const std::string &iterator, std::unique_ptr <Node> &&start, std::unique_ptr <Node> &&limit, std::unique_ptr <Node> &&step, std::unique_ptr <Chunk> &&chunk, const yy::location &location = yy::location{})
+	For(SymbolId iterator, NodePtr <Node> &&start, NodePtr <Node> &&limit, NodePtr <Node> &&step, NodePtr <Chunk> &&chunk, const Location &location = Location{})
 		: Node{location}, m_iterator{iterator}, m_start{std::move(start)}, m_limit{std::move(limit)}, m_step{std::move(step)}, m_chunk{std::move(chunk)}
 	{
 		if (!m_step)
@@ -1666,14 +1885,14 @@ public:
 		if (!m_step->isValue())
 			FATAL(location << " : Nontrival step expressions in for-loop not supported yet\n");
 
-		const Value *v = static_cast<Value *>(m_step.get());
+		const Value *v = static_cast<const Value *>(m_step.get());
 		if (v->valueType() != ValueType::Integer && v->valueType() != ValueType::Real)
 			FATAL(location << " : Step expression in for loops need to be of numeric type\n");
 	}
 
 	const Chunk & chunk() const { return *m_chunk; }
 
-	const std::string & iterator() const { return m_iterator; }
+	SymbolId iterator() const { return m_iterator; }
 	const Node & startExpr() const { return *m_start; }
 	const Node & limitExpr() const { return *m_limit; }
 
@@ -1719,10 +1938,11 @@ public:
 		return std::make_unique<For>(*this);
 	}
 
-	std::unique_ptr <BinOp> cloneCondition() const
+	/* loop condition and step assignment, borrowing the limit and step expressions */
+	std::unique_ptr <BinOp> desugarCondition() const
 	{
 		if (!m_step)
-			return std::make_unique<BinOp>(BinOp::Type::LessEqual, std::make_unique<LValue>(iterator()), limitExpr().clone());
+			return std::make_unique<BinOp>(BinOp::Type::LessEqual, std::make_unique<LValue>(iterator()), borrow(limitExpr()));
 
 		auto binopType = [](auto &&v) {
 			if (v < 0)
@@ -1740,15 +1960,15 @@ public:
 		}
 
 		assert(op != BinOp::Type::_size);
-		return std::make_unique<BinOp>(op, std::make_unique<LValue>(iterator()), limitExpr().clone());
+		return std::make_unique<BinOp>(op, std::make_unique<LValue>(iterator()), borrow(limitExpr()));
 	}
 
-	std::unique_ptr <Assignment> cloneStepExpr() const
+	std::unique_ptr <Assignment> desugarStep() const
 	{
 		if (!m_step)
 			return std::make_unique<Assignment>(m_iterator, std::make_unique<BinOp>(BinOp::Type::Plus, std::make_unique<LValue>(iterator()), std::make_unique<IntValue>(1)));
 
-		return std::make_unique<Assignment>(m_iterator, std::make_unique<BinOp>(BinOp::Type::Plus, std::make_unique<LValue>(iterator()), stepExpr().clone()));
+		return std::make_unique<Assignment>(m_iterator, std::make_unique<BinOp>(BinOp::Type::Plus, std::make_unique<LValue>(iterator()), borrow(stepExpr())));
 	}
 
 private:
@@ -1762,15 +1982,15 @@ private:
 	{
 	}
 
-	std::string m_iterator;
-	std::unique_ptr <Node> m_start, m_limit, m_step;
-	std::unique_ptr <Chunk> m_chunk;
+	SymbolId m_iterator;
+	NodePtr <Node> m_start, m_limit, m_step;
+	NodePtr <Chunk> m_chunk;
 };
 
 class ForEach : public Node {
 	friend std::unique_ptr <ForEach> std::make_unique<ForEach>(const ForEach &);
 public:
-	ForEach(std::unique_ptr <ParamList> &&variables, std::unique_ptr <ExprList> &&exprs, std::unique_ptr <Chunk> &&chunk, const yy::location &location = yy::location{})
+	ForEach(NodePtr <ParamList> &&variables, NodePtr <ExprList> &&exprs, NodePtr <Chunk> &&chunk, const Location &location = Location{})
 		: Node{location}, m_variables{std::move(variables)}, m_exprs{std::move(exprs)}, m_chunk{std::move(chunk)} {}
 
 	void print(unsigned indent = 0) const override
@@ -1793,27 +2013,13 @@ public:
 
 	const ParamList & variables() const { return *m_variables; }
 	const ExprList & exprList() const { return *m_exprs; }
+	const Chunk & chunk() const { return *m_chunk; }
 
 	std::unique_ptr <Node> clone() const override
 	{
 		return std::make_unique<ForEach>(*this);
 	}
 
-	std::unique_ptr <ParamList> cloneVariables() const
-	{
-		return m_variables->clone<ParamList>();
-	}
-
-	std::unique_ptr <ExprList> cloneExprList() const
-	{
-		return m_exprs->clone<ExprList>();
-	}
-
-	std::unique_ptr <Chunk> cloneChunk() const
-	{
-		return m_chunk->clone<Chunk>();
-	}
-
 private:
 	ForEach(const ForEach &other)
 		: Node{other.location()},
@@ -1823,9 +2029,9 @@ private:
 	{
 	}
 
-	std::unique_ptr <ParamList> m_variables;
-	std::unique_ptr <ExprList> m_exprs;
-	std::unique_ptr <Chunk> m_chunk;
+	NodePtr <ParamList> m_variables;
+	NodePtr <ExprList> m_exprs;
+	NodePtr <Chunk> m_chunk;
 };
 
 } //namespace AST
@@ -0,0 +1,219 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "AST.hpp"
+#include "ASTCache.hpp"
+#include "CachedTree.hpp"
+#include "Logger.hpp"
+#include "MappedFile.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+	/* bump whenever the binary form of CachedTree changes without a rebuild, e.g. the order of columns */
+	constexpr uint64_t FormatVersion = 1;
+	constexpr char Magic[8] = {'L', 'u', 'c', 'y', 'A', 'S', 'T', '\0'};
+
+	/* entry file: the header, then the CachedTree, aligned as load() expects it */
+	struct EntryHeader {
+		char magic[8];
+		uint64_t buildId;
+		uint64_t key;
+		uint64_t sourceSize;
+		uint64_t treeSize;
+		uint64_t checksum;
+	};
+
+	static_assert(sizeof(EntryHeader) % AST::CachedTree::Alignment == 0);
+
+	uint64_t mix(uint64_t x)
+	{
+		x ^= x >> 32;
+		x *= 0xd6e8feb86659fd93;
+		x ^= x >> 32;
+		x *= 0xd6e8feb86659fd93;
+		x ^= x >> 32;
+		return x;
+	}
+
+	/* not cryptographic, a word per step keeps hashing far cheaper than parsing */
+	uint64_t hashBytes(const void *data, size_t size, uint64_t seed)
+	{
+		constexpr uint64_t Multiplier = 0x9e3779b97f4a7c15;
+		const char *p = static_cast<const char *>(data);
+		uint64_t result = seed ^ (size * Multiplier);
+
+		size_t offset = 0;
+		for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, p + offset, sizeof(word));
+			result = (result ^ mix(word)) * Multiplier;
+		}
+
+		uint64_t tail = 0;
+		memcpy(&tail, p + offset, size - offset);
+		return mix((result ^ mix(tail)) * Multiplier);
+	}
+
+	/* identifies the executable by its size and modification time, 0 if it cannot be found */
+	uint64_t currentBuildId()
+	{
+		struct stat st;
+		if (stat("/proc/self/exe", &st) != 0)
+			return 0;
+
+		const uint64_t fields[] = {
+			FormatVersion,
+			static_cast<uint64_t>(st.st_size),
+			static_cast<uint64_t>(st.st_ino),
+			static_cast<uint64_t>(st.st_mtim.tv_sec),
+			static_cast<uint64_t>(st.st_mtim.tv_nsec)
+		};
+		return hashBytes(fields, sizeof(fields), 0) | 1;
+	}
+}
+
+ASTCache::ASTCache(const std::string &directory, uint64_t sizeLimit)
+	: m_directory{directory}, m_sizeLimit{sizeLimit}
+{
+	m_buildId = currentBuildId();
+	if (m_buildId == 0) {
+		LOG(Logger::Warning, "AST cache disabled: unable to identify the Lucy executable\n");
+		return;
+	}
+
+	std::error_code ec;
+	fs::create_directories(m_directory, ec);
+	if (ec || !fs::is_directory(m_directory, ec)) {
+		LOG(Logger::Warning, "AST cache disabled: unable to create directory: " << m_directory << '\n');
+		return;
+	}
+
+	m_enabled = true;
+}
+
+uint64_t ASTCache::key(const char *data, size_t size) const
+{
+	return hashBytes(data, size, m_buildId);
+}
+
+std::unique_ptr <AST::Chunk> ASTCache::load(uint64_t key, size_t size, FileId file) const
+{
+	if (!m_enabled)
+		return nullptr;
+
+	const std::string path = entryPath(key);
+	MappedFile entry;
+	if (!entry.open(path) || entry.size() < sizeof(EntryHeader))
+		return nullptr;
+
+	EntryHeader header;
+	memcpy(&header, entry.data(), sizeof(header));
+	const char *tree = entry.data() + sizeof(header);
+
+	/* the checksum catches entries damaged on disk, the tree is trusted by CachedTree::load() */
+	if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.buildId != m_buildId || header.key != key
+		|| header.sourceSize != size || header.treeSize != entry.size() - sizeof(header)
+		|| hashBytes(tree, header.treeSize, key) != header.checksum)
+		return nullptr;
+
+	auto cachedTree = AST::CachedTree::load(tree, header.treeSize, file);
+	if (!cachedTree)
+		return nullptr;
+
+	std::error_code ec;
+	fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+	return cachedTree->expand();
+}
+
+void ASTCache::store(uint64_t key, size_t size, const AST::Chunk &chunk) const
+{
+	if (!m_enabled)
+		return;
+
+	std::ostringstream tree;
+	AST::CachedTree{chunk}.write(tree);
+	const std::string data = tree.str();
+
+	EntryHeader header;
+	memcpy(header.magic, Magic, sizeof(Magic));
+	header.buildId = m_buildId;
+	header.key = key;
+	header.sourceSize = size;
+	header.treeSize = data.size();
+	header.checksum = hashBytes(data.data(), data.size(), key);
+
+	/* unique per process and thread, the rename replaces any entry stored meanwhile */
+	static std::atomic <unsigned> serial{0};
+	const std::string path = entryPath(key);
+	const std::string tmpPath = path + '.' + std::to_string(getpid()) + '.' + std::to_string(serial++) + ".tmp";
+
+	std::ofstream output{tmpPath, std::ios::binary};
+	output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	output.write(data.data(), data.size());
+	output.close();
+
+	std::error_code ec;
+	if (output.fail())
+		fs::remove(tmpPath, ec);
+	else
+		fs::rename(tmpPath, path, ec);
+}
+
+void ASTCache::evict() const
+{
+	if (!m_enabled)
+		return;
+
+	struct Entry {
+		fs::path path;
+		fs::file_time_type lastUse;
+		uint64_t size;
+	};
+
+	std::vector <Entry> entries;
+	uint64_t totalSize = 0;
+
+	std::error_code ec;
+	for (fs::directory_iterator iter{m_directory, ec}, end; !ec && iter != end; iter.increment(ec)) {
+		std::error_code entryEc;
+		if (iter->path().extension() != ".ast" || !iter->is_regular_file(entryEc))
+			continue;
+
+		const uint64_t size = iter->file_size(entryEc);
+		const auto lastUse = iter->last_write_time(entryEc);
+		if (entryEc)
+			continue;
+
+		entries.push_back(Entry{iter->path(), lastUse, size});
+		totalSize += size;
+	}
+
+	if (totalSize <= m_sizeLimit)
+		return;
+
+	std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.lastUse < b.lastUse; });
+	for (const auto &entry : entries) {
+		if (totalSize <= m_sizeLimit)
+			break;
+		if (fs::remove(entry.path, ec))
+			totalSize -= entry.size;
+	}
+}
+
+std::string ASTCache::entryPath(uint64_t key) const
+{
+	std::ostringstream path;
+	path << m_directory << '/' << std::hex << std::setw(16) << std::setfill('0') << key << ".ast";
+	return path.str();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "AST_fwd.hpp"
+#include "Location.hpp"
+
+/*
+ * Directory of parsed trees keyed by the content of the source and the build
+ * of Lucy which parsed it. Every entry is a single file holding a CachedTree,
+ * which is mapped and expanded in place on a hit, so a cached file skips the
+ * scanner and the parser. Only successful parses are stored.
+ *
+ * Entries are written to a temporary file renamed into place, so concurrent
+ * runs (and threads) sharing the directory never see a partial entry. A hit
+ * refreshes the modification time of the entry, evict() then removes the
+ * least recently used entries over the size limit.
+ */
+class ASTCache {
+public:
+	ASTCache(const std::string &directory, uint64_t sizeLimit);
+	ASTCache(const ASTCache &) = delete;
+	void operator = (const ASTCache &) = delete;
+
+	/* false if the directory or the build of Lucy is not usable, lookups then always miss */
+	bool enabled() const { return m_enabled; }
+
+	/* key of size bytes of source at data */
+	uint64_t key(const char *data, size_t size) const;
+
+	/* chunk of the source file `file` of the current session, nullptr on a miss */
+	std::unique_ptr <AST::Chunk> load(uint64_t key, size_t size, FileId file) const;
+	void store(uint64_t key, size_t size, const AST::Chunk &chunk) const;
+
+	void evict() const;
+
+private:
+	std::string entryPath(uint64_t key) const;
+
+	std::string m_directory;
+	uint64_t m_sizeLimit;
+	uint64_t m_buildId = 0;
+	bool m_enabled = false;
+};
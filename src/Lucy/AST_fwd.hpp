@@ -3,6 +3,8 @@ namespace AST {
 	class BinOp;
 	class Break;
 	class Chunk;
+	class ConstTable;
+	struct ConstTableStorage;
 	class Ellipsis;
 	class ExprList;
 	class Field;
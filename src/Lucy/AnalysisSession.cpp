@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+#include "AnalysisSession.hpp"
+#include "ControlFlowGraph.hpp"
+#include "Driver.hpp"
+#include "Scope.hpp"
+
+thread_local AnalysisSession *AnalysisSession::t_active = nullptr;
+
+AnalysisSession::AnalysisSession() = default;
+
+AnalysisSession::AnalysisSession(AnalysisSession &parent)
+	: m_parent{&parent}
+{
+	inheritSettings(parent);
+}
+AnalysisSession::~AnalysisSession() = default;
+
+AnalysisSession & AnalysisSession::current()
+{
+	static AnalysisSession defaultSession;
+
+	if (t_active)
+		return *t_active;
+	return defaultSession;
+}
+
+AnalysisResult AnalysisSession::analyze(const std::string &filename, const char *data, size_t size)
+{
+	AnalysisResult result;
+
+	result.status = run([this, &filename, data, size]
+	{
+		Driver driver;
+		driver.setErrorStream(m_logger.m_output);
+		driver.setInputBuffer(filename, data, size);
+		if (driver.parse() != 0)
+			return 1;
+
+		assert(driver.chunks().size() == 1);
+		Scope globalScope;
+		ControlFlowGraph cfg{*driver.chunks()[0], globalScope};
+		return 0;
+	});
+
+	result.issues = takeIssues();
+	return result;
+}
+
+std::vector <IssueVariant> AnalysisSession::takeIssues()
+{
+	std::vector <IssueVariant> issues;
+	std::swap(issues, m_logger.m_issues);
+	return issues;
+}
+
+void AnalysisSession::merge(AnalysisSession &other, std::vector <IssueVariant> &&otherIssues)
+{
+	auto &issues = m_logger.m_issues;
+	issues.reserve(issues.size() + otherIssues.size());
+	std::move(otherIssues.begin(), otherIssues.end(), std::back_inserter(issues));
+
+	m_filenames.splice(m_filenames.end(), other.m_filenames);
+	std::move(other.m_sourceFiles.begin(), other.m_sourceFiles.end(), std::back_inserter(m_sourceFiles));
+	other.m_sourceFiles.clear();
+}
+
+const std::string * AnalysisSession::internFilename(const std::string &filename)
+{
+	/* sessions usually see just a few files, a linear search is good enough */
+	auto iter = std::find(m_filenames.begin(), m_filenames.end(), filename);
+	if (iter != m_filenames.end())
+		return &*iter;
+
+	return &m_filenames.emplace_back(filename);
+}
+
+FileId AnalysisSession::addSourceFile(const std::string *filename, const char *text, size_t size)
+{
+	assert(!m_parent);
+	m_sourceFiles.push_back(std::make_unique<SourceFile>(filename, text, size));
+	return m_sourceFiles.size();
+}
+
+bool AnalysisSession::isInLineFilter(const Location &location) const
+{
+	if (m_lineFilter.empty())
+		return true;
+
+	const SourceRange range = location.resolve();
+	return std::any_of(m_lineFilter.begin(), m_lineFilter.end(), [&range](const LineRange &lines)
+	{
+		return range.begin.line <= lines.last && lines.first <= range.end.line;
+	});
+}
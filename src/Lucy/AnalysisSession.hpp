@@ -0,0 +1,115 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AST_fwd.hpp"
+#include "Issue.hpp"
+#include "Location.hpp"
+#include "Logger.hpp"
+#include "Symbol.hpp"
+
+struct AnalysisResult {
+	int status = 0;
+	std::vector <IssueVariant> issues;
+};
+
+/*
+ * Owns all state of an analysis: logger settings and output, found issues,
+ * interned identifiers, names and line indexes of analyzed files. Sessions share nothing, so any
+ * number of them can run concurrently (one per thread at a time). The only
+ * exception are helper sessions of threads parsing parts of a file of their
+ * parent, they share its symbols and source files.
+ *
+ * Code executed by run() or analyze() reaches its session through the static
+ * Logger interface. Outside of them, the process-wide default session is used
+ * and FATAL() terminates the process, inside them it aborts the analysis only.
+ */
+class AnalysisSession {
+	friend class Logger;
+public:
+	struct Aborted {};
+
+	AnalysisSession();
+	/* helper session of parent with the settings of its logger */
+	explicit AnalysisSession(AnalysisSession &parent);
+	AnalysisSession(const AnalysisSession &) = delete;
+	void operator = (const AnalysisSession &) = delete;
+	~AnalysisSession();
+
+	static AnalysisSession & current();
+	static bool isActive() { return t_active != nullptr; }
+
+	/*
+	 * Analyzes size bytes of Lua code at data. Locations of the returned issues
+	 * refer to the file owned by this session and remain valid while it exists.
+	 */
+	AnalysisResult analyze(const std::string &filename, const char *data, size_t size);
+
+	template <typename Func>
+	int run(Func &&func);
+
+	void enable(Issue::Type issue) { m_logger.setFlag(issue); }
+	void disable(Issue::Type issue) { m_logger.unsetFlag(issue); }
+	void setOutput(std::ostream &os) { m_logger.m_output = &os; }
+	void setThreshold(unsigned threshold) { m_logger.m_threshold = threshold; }
+	void inheritSettings(const AnalysisSession &other)
+	{
+		m_logger.copySettings(other.m_logger);
+		m_lineFilter = other.m_lineFilter;
+	}
+
+	/* top-level functions not overlapping any of the ranges are not analyzed, an empty filter passes all */
+	void setLineFilter(std::vector <LineRange> ranges) { m_lineFilter = std::move(ranges); }
+	bool isInLineFilter(const Location &location) const;
+
+	const std::vector <IssueVariant> & foundIssues() const { return m_logger.m_issues; }
+	std::vector <IssueVariant> takeIssues();
+
+	/* Moves found issues (and the files and file names they refer to) from other session. */
+	void merge(AnalysisSession &other) { merge(other, other.takeIssues()); }
+	/* the same with issues already taken from other, e.g. returned by analyze() */
+	void merge(AnalysisSession &other, std::vector <IssueVariant> &&issues);
+
+	const std::string * internFilename(const std::string &filename);
+	FileId addSourceFile(const std::string *filename, const char *text, size_t size);
+	const SourceFile & sourceFile(FileId file) const { return m_parent ? m_parent->sourceFile(file) : *m_sourceFiles[file - 1]; }
+	SourceFile & sourceFile(FileId file) { return m_parent ? m_parent->sourceFile(file) : *m_sourceFiles[file - 1]; }
+	SymbolTable & symbols() { return m_parent ? m_parent->symbols() : m_symbols; }
+
+private:
+	class Activation {
+	public:
+		Activation(AnalysisSession *session) : m_previous{t_active} { t_active = session; }
+		Activation(const Activation &) = delete;
+		void operator = (const Activation &) = delete;
+		~Activation() { t_active = m_previous; }
+
+	private:
+		AnalysisSession *m_previous;
+	};
+
+	AnalysisSession *m_parent = nullptr;
+	Logger m_logger;
+	std::list <std::string> m_filenames;
+	/* not moved when merged into another session, issues point to them */
+	std::vector <std::unique_ptr <SourceFile> > m_sourceFiles;
+	SymbolTable m_symbols;
+	std::vector <LineRange> m_lineFilter;
+
+	static thread_local AnalysisSession *t_active;
+};
+
+template <typename Func>
+int AnalysisSession::run(Func &&func)
+{
+	Activation activation{this};
+
+	try {
+		return func();
+	} catch (const Aborted &) {
+		return 1;
+	}
+}
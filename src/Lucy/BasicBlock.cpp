@@ -4,80 +4,118 @@
 #include "AST.hpp"
 #include "BasicBlock.hpp"
 #include "Fold.hpp"
+#include "TableKeys.hpp"
+#include "Visitor.hpp"
 
-struct BasicBlock::BBContext {
-	BasicBlock *current = nullptr;
-	std::vector <BasicBlock *> blockStack;
+struct BasicBlock::BBContext : AST::Visitor<BBContext> {
+	BBContext(std::vector <BasicBlock> &blocks, IR::Code &code) : blocks{blocks}, code{code} {}
+
+	std::vector <BasicBlock> &blocks;
+	IR::Code &code;
+	/* blocks are addressed by id, splitBlock() appends to blocks */
+	BlockId current = NoBlock;
+	std::vector <BlockId> blockStack;
 	std::vector <RValue> stack;
 	std::vector <unsigned> requiredResults;
 	Serial tempCnt;
 
-	template <typename ...Ts>
-	void emplaceTriplet(Ts &&...args)
+	/* the code of a block is contiguous, nothing is emitted for other blocks in between */
+	RValue emplaceTriplet(IR::Op operation, RValue lhs, RValue rhs = RValue::nil())
 	{
-		current->irCode.emplace_back(std::make_unique<IR::Triplet>(args...));
+		assert(block().irCode.end() == code.size());
+		++block().irCode.size;
+		return code.emit(operation, lhs, rhs);
 	}
 
-	IR::Triplet * lastTriplet()
+	BasicBlock & block()
 	{
-		return current->irCode.back().get();
+		return blocks[current];
 	}
 
-	const AST::LValue * getTemporary()
+	RValue constant(const ValueVariant &value)
 	{
-		return RValue::getTemporary(tempCnt.next());
+		return code.constant(value);
+	}
+
+	RValue getTemporary()
+	{
+		return code.virtualRegister(tempCnt.next());
 	}
 
 	void popBlock()
 	{
 		assert(!blockStack.empty());
-		current->finalize(*this);
+		finalize(*this);
 		blockStack.pop_back();
-		current = blockStack.empty() ? nullptr : blockStack.back();
+		current = blockStack.empty() ? NoBlock : blockStack.back();
 	}
 
-	void pushBlock(BasicBlock *b)
+	void pushBlock(BlockId b)
 	{
+		blocks[b].irCode = IR::Range{code.size(), 0};
 		current = b;
 		blockStack.push_back(b);
 	}
-};
 
-BasicBlock::BasicBlock(UID id)
-	: m_label{std::string{"BB_"} + std::to_string(id)}
-{
-}
+	/* expressions and the statements left in blocks are translated by the process() overloads */
+	template <typename T, std::enable_if_t<AST::isOneOf<T, AST::Assignment, AST::BinOp, AST::ConstTable, AST::Ellipsis, AST::ExprList, AST::Function,
+		AST::FunctionCall, AST::LValue, AST::NestedExpr, AST::TableCtor, AST::UnOp, AST::Value>, int> = 0>
+	void visit(const T &node)
+	{
+		process(*this, node);
+	}
 
-BasicBlock::BasicBlock(const std::string &label)
-	: m_label{label}
-{
-}
+	/* control flow is split into blocks by ControlFlowGraph, method calls are rewritten to plain calls */
+	template <typename T, std::enable_if_t<AST::isOneOf<T, AST::Break, AST::Chunk, AST::Field, AST::For, AST::ForEach, AST::FunctionName,
+		AST::If, AST::MethodCall, AST::ParamList, AST::Repeat, AST::Return, AST::VarList, AST::While>, int> = 0>
+	void visit(const T &node)
+	{
+		unexpected(node);
+	}
+};
 
-BasicBlock::BasicBlock(std::string &&label)
-	: m_label{std::move(label)}
+BasicBlock::BasicBlock(UID serial)
+	: m_serial{serial}
 {
 }
 
-BasicBlock & BasicBlock::operator = (BasicBlock &&other) = default;
+BasicBlock::BasicBlock(BasicBlock &&other) noexcept = default;
+
+BasicBlock & BasicBlock::operator = (BasicBlock &&other) noexcept = default;
 
 BasicBlock::~BasicBlock() = default;
 
-void BasicBlock::irDump(unsigned indent) const
+void BasicBlock::irDump(const std::vector <BasicBlock> &blocks, BlockId id, const IR::Code &code, unsigned indent)
 {
-	Logger::indent(std::cout, indent) << '[' << label() << "]\n";
-	for (const auto &t : irCode)
-		Logger::indent(std::cout, indent + 1) << *t << '\n';
+	const BasicBlock &block = blocks[id];
+	const std::string label = BasicBlock::label(blocks, id);
+
+	Logger::indent(std::cout, indent) << '[' << label << "]\n";
+	for (uint32_t idx = block.irCode.first; idx != block.irCode.end(); ++idx) {
+		Logger::indent(std::cout, indent + 1);
+		code.print(std::cout, idx);
+		std::cout << '\n';
+	}
 
-	Logger::indent(std::cout, indent) << "[/" << label() << "]\n";
+	Logger::indent(std::cout, indent) << "[/" << label << "]\n";
 
-	if (m_condNode) {
+	if (block.m_subBlocks[0] != NoBlock) {
 		std::cout << '\n';
-		m_subBlocks[0]->irDump(indent + 1);
+		irDump(blocks, block.m_subBlocks[0], code, indent + 1);
 		std::cout << '\n';
-		m_subBlocks[1]->irDump(indent);
+		irDump(blocks, block.m_subBlocks[1], code, indent);
 	}
 }
 
+std::string BasicBlock::label(const std::vector <BasicBlock> &blocks, BlockId id)
+{
+	const BasicBlock &block = blocks[id];
+	if (block.m_splitFrom == NoBlock)
+		return std::string{"BB_"} + std::to_string(block.m_serial);
+
+	return label(blocks, block.m_splitFrom) + (blocks[block.m_splitFrom].m_subBlocks[0] == id ? "_T" : "_F");
+}
+
 bool BasicBlock::canPrune() const
 {
 	return isEmpty() && !attribute(Attribute::BackEdge) && !attribute(Attribute::LoopFooter);
@@ -88,17 +126,18 @@ bool BasicBlock::isEmpty() const
 	return exitType() == BasicBlock::ExitType::Fallthrough && irCode.empty();
 }
 
-void BasicBlock::generateIR()
+void BasicBlock::generateIR(std::vector <BasicBlock> &blocks, BlockId id, IR::Code &code)
 {
-	BBContext ctx;
-	ctx.pushBlock(this);
+	BBContext ctx{blocks, code};
+	ctx.pushBlock(id);
 
-	for (unsigned idx = 0; idx != insn.size(); ++idx) {
-		const AST::Node *insnNode = insn[idx];
+	/* the statements of the block, blocks may move as others are split off */
+	for (unsigned idx = 0; idx != blocks[id].insn.size(); ++idx) {
+		const AST::Node *insnNode = blocks[id].insn[idx];
 
 		ctx.requiredResults.push_back(0);
 		ctx.tempCnt.reset();
-		ctx.current->process(ctx, *insnNode);
+		ctx.dispatch(*insnNode);
 		ctx.requiredResults.pop_back();
 		assert(ctx.stack.empty());
 	}
@@ -106,7 +145,7 @@ void BasicBlock::generateIR()
 	ctx.popBlock();
 }
 
-void BasicBlock::removePredecessor(BasicBlock *block)
+void BasicBlock::removePredecessor(BlockId block)
 {
 	size_t i = 0;
 	while (i < predecessors.size()) {
@@ -121,37 +160,46 @@ void BasicBlock::removePredecessor(BasicBlock *block)
 	assert(false);
 }
 
-void BasicBlock::setLoopFooter(BasicBlock *dst)
+void BasicBlock::setLoopFooter(std::vector <BasicBlock> &blocks, BlockId src, BlockId dst)
 {
-	this->setAttribute(BasicBlock::Attribute::BackEdge);
-	m_loopFooterEdge = dst;
-	dst->setAttribute(BasicBlock::Attribute::LoopFooter);
+	blocks[src].setAttribute(BasicBlock::Attribute::BackEdge);
+	blocks[src].m_loopFooterEdge = dst;
+	blocks[dst].setAttribute(BasicBlock::Attribute::LoopFooter);
 }
 
 void BasicBlock::finalize(BBContext &ctx)
 {
-	switch (ctx.current->exitType().value()) {
+	switch (ctx.block().exitType().value()) {
 		case ExitType::Conditional: {
-			assert(ctx.current->condition);
-			assert(!ctx.current->returnExprList);
-
-			ctx.requiredResults.push_back(1);
-			process(ctx, *ctx.current->condition);
-			ctx.requiredResults.pop_back();
+			assert(!ctx.block().returnExprList);
+
+			RValue condition;
+			if (ctx.block().m_subBlocks[0] != NoBlock) {
+				condition = ctx.block().m_splitValue;
+				if (ctx.block().m_splitNegated)
+					condition = ctx.emplaceTriplet(IR::Op::UnaryNot, condition);
+			} else {
+				assert(ctx.block().condition);
+				ctx.requiredResults.push_back(1);
+				ctx.dispatch(*ctx.block().condition);
+				ctx.requiredResults.pop_back();
+				condition = ctx.stack.back();
+				ctx.stack.pop_back();
+			}
 
-			ctx.emplaceTriplet(IR::Op::JumpCond, ctx.stack.back(), ValueVariant{ctx.current->nextBlock[0]->label()});
-			ctx.stack.pop_back();
-			ctx.emplaceTriplet(IR::Op::Jump, ValueVariant{ctx.current->nextBlock[1]->label()});
+			const auto [trueBlock, falseBlock] = ctx.block().nextBlock;
+			ctx.emplaceTriplet(IR::Op::JumpCond, condition, ctx.constant(label(ctx.blocks, trueBlock)));
+			ctx.emplaceTriplet(IR::Op::Jump, ctx.constant(label(ctx.blocks, falseBlock)));
 			break;
 		}
 
 		case ExitType::Return: {
-			assert(!ctx.current->condition);
+			assert(!ctx.block().condition);
 
-			if (!ctx.current->returnExprList)
+			if (!ctx.block().returnExprList)
 				break;
 
-			const auto &exprList = static_cast<const AST::ExprList &>(*ctx.current->returnExprList);
+			const auto &exprList = static_cast<const AST::ExprList &>(*ctx.block().returnExprList);
 			ctx.tempCnt.reset();
 			process(ctx, exprList);
 
@@ -160,7 +208,7 @@ void BasicBlock::finalize(BBContext &ctx)
 				ctx.stack.pop_back();
 			}
 			const long resultCnt = exprList.exprs().size();
-			ctx.emplaceTriplet(IR::Op::Return, ValueVariant{resultCnt});
+			ctx.emplaceTriplet(IR::Op::Return, ctx.constant(resultCnt));
 
 			break;
 		}
@@ -183,7 +231,7 @@ void BasicBlock::process(BBContext &ctx, const AST::Assignment &assignment)
 			resultsNeeded = varList.size() - exprList.size() + 1;
 
 		ctx.requiredResults.push_back(resultsNeeded);
-		process(ctx, *e);
+		ctx.dispatch(*e);
 		ctx.requiredResults.pop_back();
 
 		if (e->type() != AST::Node::Type::FunctionCall) {
@@ -216,8 +264,9 @@ void BasicBlock::process(BBContext &ctx, const AST::Assignment &assignment)
 		const auto &lhs = ctx.stack[baseStackSize + varList.size() + i];
 		const auto &rhs = ctx.stack[baseStackSize + i];
 
-		if (auto t = std::get_if<RValue::Type::Temporary>(&lhs.valueRef); t && (*t)->operation == IR::Op::TableIndex) {
-			ctx.emplaceTriplet(IR::Op::TableAssign, ValueVariant{TableReference{&(*t)->operands[0], &(*t)->operands[1]}}, rhs);
+		if (lhs.type() == RValue::Type::Temporary && ctx.code[lhs.index()].operation == IR::Op::TableIndex) {
+			const auto &operands = ctx.code[lhs.index()].operands;
+			ctx.emplaceTriplet(IR::Op::TableAssign, ctx.constant(TableReference{operands[0], operands[1]}), rhs);
 		} else {
 			ctx.emplaceTriplet(IR::Op::Assign, lhs, rhs);
 		}
@@ -229,7 +278,7 @@ void BasicBlock::process(BBContext &ctx, const AST::Assignment &assignment)
 void BasicBlock::process(BBContext &ctx, const AST::BinOp &binOp)
 {
 	ctx.requiredResults.push_back(1);
-	process(ctx, binOp.left());
+	ctx.dispatch(binOp.left());
 	auto lhs = ctx.stack.back();
 	ctx.stack.pop_back();
 
@@ -243,19 +292,18 @@ void BasicBlock::process(BBContext &ctx, const AST::BinOp &binOp)
 		return;
 	}
 
-	process(ctx, binOp.right());
+	ctx.dispatch(binOp.right());
 	ctx.requiredResults.pop_back();
 	auto rhs = ctx.stack.back();
 	ctx.stack.pop_back();
 
-	ctx.emplaceTriplet(IR::Op{binOp.binOpType().value()}, lhs, rhs);
-	ctx.stack.push_back(ctx.lastTriplet());
+	ctx.stack.push_back(ctx.emplaceTriplet(IR::Op{binOp.binOpType().value()}, lhs, rhs));
 }
 
-void BasicBlock::process(BBContext &ctx, const AST::Ellipsis &ellipsis)
+void BasicBlock::process(BBContext &ctx, const AST::Ellipsis &)
 {
 	auto tmp = ctx.getTemporary();
-	ctx.emplaceTriplet(IR::Op::Assign, tmp, ValueVariant{std::string{"arg"}});
+	ctx.emplaceTriplet(IR::Op::Assign, tmp, ctx.constant(std::string{"arg"}));
 	ctx.stack.push_back(tmp);
 }
 
@@ -270,7 +318,7 @@ void BasicBlock::process(BBContext &ctx, const AST::ExprList &exprList)
 			ctx.requiredResults.push_back(1);
 		else
 			ctx.requiredResults.push_back(std::numeric_limits<unsigned>::max());
-		process(ctx, *e);
+		ctx.dispatch(*e);
 		ctx.requiredResults.pop_back();
 
 		auto result = ctx.stack.back();
@@ -284,10 +332,8 @@ void BasicBlock::process(BBContext &ctx, const AST::ExprList &exprList)
 
 void BasicBlock::process(BBContext &ctx, const AST::Function &fnNode)
 {
-	assert(fnNode.isAnonymous());
-
 	auto tmp = ctx.getTemporary();
-	ctx.emplaceTriplet(IR::Op::Assign, tmp, ValueVariant{&fnNode});
+	ctx.emplaceTriplet(IR::Op::Assign, tmp, ctx.constant(&fnNode));
 	ctx.stack.push_back(tmp);
 }
 
@@ -302,7 +348,7 @@ void BasicBlock::process(BBContext &ctx, const AST::FunctionCall &fnCallNode)
 	}
 
 	ctx.requiredResults.push_back(1);
-	process(ctx, fnCallNode.functionExpr());
+	ctx.dispatch(fnCallNode.functionExpr());
 	ctx.requiredResults.pop_back();
 
 	const long requiredArgs = fnCallNode.args().size();
@@ -317,7 +363,7 @@ void BasicBlock::process(BBContext &ctx, const AST::FunctionCall &fnCallNode)
 	if (knownResultCnt) {
 		const long fnCallMeta = (requiredArgs << 16) | requiredResults;
 
-		ctx.emplaceTriplet(IR::Op::Call, ctx.stack.back(), ValueVariant{fnCallMeta});
+		ctx.emplaceTriplet(IR::Op::Call, ctx.stack.back(), ctx.constant(fnCallMeta));
 		ctx.stack.pop_back();
 
 		for (long i = 0; i != requiredResults; ++i) {
@@ -326,7 +372,7 @@ void BasicBlock::process(BBContext &ctx, const AST::FunctionCall &fnCallNode)
 			ctx.stack.push_back(tmp);
 		}
 	} else {
-		ctx.emplaceTriplet(IR::Op::CallUnknownResults, ctx.stack.back(), ValueVariant{requiredArgs});
+		ctx.emplaceTriplet(IR::Op::CallUnknownResults, ctx.stack.back(), ctx.constant(requiredArgs));
 		ctx.stack.pop_back();
 
 		auto tmp = ctx.getTemporary();
@@ -338,61 +384,76 @@ void BasicBlock::process(BBContext &ctx, const AST::FunctionCall &fnCallNode)
 void BasicBlock::process(BBContext &ctx, const AST::LValue &lval)
 {
 	if (lval.lvalueType() == AST::LValue::Type::Name) {
-		ctx.stack.push_back(&lval);
+		ctx.stack.push_back(ctx.code.variable(&lval));
 		return;
 	}
 
 	ctx.requiredResults.push_back(1);
-	process(ctx, lval.tableExpr());
+	ctx.dispatch(lval.tableExpr());
 	auto tableVar = ctx.stack.back();
 	ctx.stack.pop_back();
 
+	RValue element;
 	if (lval.lvalueType() == AST::LValue::Type::Dot) {
-		ctx.emplaceTriplet(IR::Op::TableIndex, tableVar, ValueVariant{lval.name()});
+		element = ctx.emplaceTriplet(IR::Op::TableIndex, tableVar, ctx.constant(std::string_view{lval.name().str()}));
 	} else {
-		process(ctx, lval.keyExpr());
-		ctx.emplaceTriplet(IR::Op::TableIndex, tableVar, ctx.stack.back());
+		ctx.dispatch(lval.keyExpr());
+		element = ctx.emplaceTriplet(IR::Op::TableIndex, tableVar, ctx.stack.back());
 		ctx.stack.pop_back();
 	}
 	ctx.requiredResults.pop_back();
 
-	ctx.stack.push_back(ctx.lastTriplet());
+	ctx.stack.push_back(element);
 }
 
 void BasicBlock::process(BBContext &ctx, const AST::NestedExpr &nestedExpr)
 {
 	ctx.requiredResults.push_back(1);
-	process(ctx, nestedExpr.expr());
+	ctx.dispatch(nestedExpr.expr());
 	ctx.requiredResults.pop_back();
 }
 
-void BasicBlock::process(BBContext &ctx, const AST::Node &node)
+/* keys given by an expression are checked only if they are constant */
+static void addTableKey(TableKeys &keys, const AST::Field &field)
 {
-	#define SUBCASE(type) case AST::Node::Type::type: return process(ctx, static_cast<const AST::type &>(node))
-
-	switch (node.type().value()) {
-		SUBCASE(Assignment);
-		SUBCASE(BinOp);
-		SUBCASE(Ellipsis);
-		SUBCASE(ExprList);
-		SUBCASE(Function);
-		SUBCASE(FunctionCall);
-		SUBCASE(LValue);
-		SUBCASE(NestedExpr);
-		SUBCASE(TableCtor);
-		SUBCASE(UnOp);
-		SUBCASE(Value);
-		default: FATAL(node.location() << " : Unhandled node type: " << node.type() << '\n');
+	switch (field.fieldType()) {
+		case AST::Field::Type::Brackets: {
+			if (!field.keyExpr().isValue())
+				return;
+
+			const auto &key = static_cast<const AST::Value &>(field.keyExpr());
+			switch (key.valueType().value()) {
+				case ValueType::Boolean:
+					keys.addBoolean(static_cast<const AST::BooleanValue &>(key).value(), field.location());
+					break;
+				case ValueType::Integer:
+					keys.addInteger(static_cast<const AST::IntValue &>(key).value(), field.location());
+					break;
+				case ValueType::Real:
+					keys.addReal(static_cast<const AST::RealValue &>(key).value(), field.location());
+					break;
+				case ValueType::String:
+					keys.addString(static_cast<const AST::StringValue &>(key).value(), field.location());
+					break;
+				default:
+					break;
+			}
+			break;
+		}
+		case AST::Field::Type::Literal:
+			keys.addName(field.fieldName(), field.location());
+			break;
+		case AST::Field::Type::NoIndex:
+			keys.addPositional(field.location());
+			break;
 	}
-
-	#undef SUBCASE
 }
 
 void BasicBlock::process(BBContext &ctx, const AST::TableCtor &tableCtor)
 {
+	TableKeys keys;
 	auto table = ctx.getTemporary();
 	ctx.emplaceTriplet(IR::Op::TableCtor, table);
-	const RValue *tableRval = &ctx.lastTriplet()->operands[0];
 
 	long idxCnt = 0;
 	for (const auto &f : tableCtor.fields()) {
@@ -401,36 +462,89 @@ void BasicBlock::process(BBContext &ctx, const AST::TableCtor &tableCtor)
 		switch (f->fieldType()) {
 			case AST::Field::Type::Brackets:
 				ctx.requiredResults.push_back(1);
-				process(ctx, f->keyExpr());
+				ctx.dispatch(f->keyExpr());
 				ctx.requiredResults.pop_back();
 
 				ctx.emplaceTriplet(IR::Op::Assign, k, ctx.stack.back());
 				ctx.stack.pop_back();
 				break;
 			case AST::Field::Type::Literal:
-				ctx.emplaceTriplet(IR::Op::Assign, k, ValueVariant{f->fieldName()});
+				ctx.emplaceTriplet(IR::Op::Assign, k, ctx.constant(std::string_view{f->fieldName().str()}));
 				break;
 			case AST::Field::Type::NoIndex:
-				ctx.emplaceTriplet(IR::Op::Assign, k, ValueVariant{++idxCnt});
+				ctx.emplaceTriplet(IR::Op::Assign, k, ctx.constant(++idxCnt));
 				break;
 		}
 
-		const RValue *keyRval = &ctx.lastTriplet()->operands[0];
-
 		ctx.requiredResults.push_back(1);
-		process(ctx, f->valueExpr());
+		ctx.dispatch(f->valueExpr());
 		ctx.requiredResults.pop_back();
 
 		RValue v = ctx.stack.back();
 		ctx.stack.pop_back();
 
-		TableReference ref{tableRval, keyRval};
-		ctx.emplaceTriplet(IR::Op::TableAssign, ValueVariant{ref}, v);
+		const auto &valueExpr = f->valueExpr();
+		if (valueExpr.isValue() && static_cast<const AST::Value &>(valueExpr).valueType() == ValueType::Nil)
+			Logger::logIssue<Issue::Table::NilValue>(valueExpr.location());
+		addTableKey(keys, *f);
+
+		ctx.emplaceTriplet(IR::Op::TableAssign, ctx.constant(TableReference{table, k}), v);
 	}
 
 	ctx.stack.push_back(table);
 }
 
+/* reports the issues process(TableCtor) reports for the same fields, in the same order */
+static void checkConstTable(const AST::ConstTable &constTable, AST::ConstTable::TableId id)
+{
+	TableKeys keys;
+	const auto &fields = constTable.table(id).fields;
+
+	for (uint32_t i = fields.first; i != fields.end(); ++i) {
+		const auto &f = constTable.field(i);
+
+		if (f.value.type == ValueType::Table) {
+			checkConstTable(constTable, f.value.table);
+		} else if (f.value.type == ValueType::Nil) {
+			Logger::logIssue<Issue::Table::NilValue>(f.valueLocation());
+		}
+
+		switch (f.type) {
+			case AST::Field::Type::Brackets:
+				switch (f.key.type.value()) {
+					case ValueType::Boolean:
+						keys.addBoolean(f.key.boolean, f.location);
+						break;
+					case ValueType::Integer:
+						keys.addInteger(f.key.integer, f.location);
+						break;
+					case ValueType::Real:
+						keys.addReal(f.key.real, f.location);
+						break;
+					default:
+						keys.addString(constTable.string(f, f.key.string), f.location);
+						break;
+				}
+				break;
+			case AST::Field::Type::Literal:
+				keys.addName(f.name, f.location);
+				break;
+			case AST::Field::Type::NoIndex:
+				keys.addPositional(f.location);
+				break;
+		}
+	}
+}
+
+void BasicBlock::process(BBContext &ctx, const AST::ConstTable &constTable)
+{
+	checkConstTable(constTable, constTable.root());
+
+	auto table = ctx.getTemporary();
+	ctx.emplaceTriplet(IR::Op::TableCtor, table, ctx.constant(&constTable));
+	ctx.stack.push_back(table);
+}
+
 void BasicBlock::process(BBContext &ctx, const AST::UnOp &unOp)
 {
 	static const std::array <IR::Op, AST::UnOp::Type::_size> UnaryOpType {
@@ -440,76 +554,75 @@ void BasicBlock::process(BBContext &ctx, const AST::UnOp &unOp)
 	};
 
 	ctx.requiredResults.push_back(1);
-	process(ctx, unOp.operand());
+	ctx.dispatch(unOp.operand());
 	ctx.requiredResults.pop_back();
 
 	auto operand = ctx.stack.back();
 	ctx.stack.pop_back();
 
-	ctx.emplaceTriplet(UnaryOpType[static_cast<unsigned>(unOp.unOpType())], RValue{operand});
-	ctx.stack.push_back(ctx.lastTriplet());
+	ctx.stack.push_back(ctx.emplaceTriplet(UnaryOpType[static_cast<unsigned>(unOp.unOpType())], operand));
 }
 
 void BasicBlock::process(BBContext &ctx, const AST::Value &valueNode)
 {
-	ctx.stack.push_back(valueNode.toValueVariant());
+	ctx.stack.push_back(ctx.constant(valueNode.toValueVariant()));
 }
 
-void BasicBlock::splitBlock(BBContext &ctx, const AST::LValue *tmpDst, const AST::BinOp &binOp)
+void BasicBlock::splitBlock(BBContext &ctx, RValue tmp, const AST::BinOp &binOp)
 {
 	assert(anyOf(binOp.binOpType(), AST::BinOp::Type::And, AST::BinOp::Type::Or));
 
-	ctx.current->m_subBlocks[0] = std::make_unique<BasicBlock>(ctx.current->label() + "_T");
-	ctx.current->m_subBlocks[1] = std::make_unique<BasicBlock>(ctx.current->label() + "_F");
-
-	BasicBlock *trueBlock = ctx.current->m_subBlocks[0].get();
-	BasicBlock *falseBlock = ctx.current->m_subBlocks[1].get();
-
-	falseBlock->setAttribute(BasicBlock::Attribute::SubBlock);
-	falseBlock->setExitType(ctx.current->exitType());
-	falseBlock->returnExprList = ctx.current->returnExprList;
-	falseBlock->condition = ctx.current->condition;
-	falseBlock->nextBlock = ctx.current->nextBlock;
-	falseBlock->predecessors.push_back(ctx.current);
-	falseBlock->predecessors.push_back(trueBlock);
-
-	falseBlock->phase = trueBlock->phase = ctx.current->phase;
-	falseBlock->scope = trueBlock->scope = ctx.current->scope;
-
-	trueBlock->setAttribute(BasicBlock::Attribute::SubBlock);
-	trueBlock->nextBlock[0] = falseBlock;
-	trueBlock->predecessors.push_back(ctx.current);
-
-	for (auto nextBlock : ctx.current->nextBlock) {
-		if (nextBlock) {
-			nextBlock->removePredecessor(ctx.current);
-			nextBlock->predecessors.push_back(falseBlock);
+	const BlockId current = ctx.current;
+	const BlockId trueId = ctx.blocks.size();
+	const BlockId falseId = trueId + 1;
+	ctx.blocks.emplace_back(UID{Serial::EmptyUid});
+	ctx.blocks.emplace_back(UID{Serial::EmptyUid});
+
+	BasicBlock &block = ctx.blocks[current];
+	BasicBlock &trueBlock = ctx.blocks[trueId];
+	BasicBlock &falseBlock = ctx.blocks[falseId];
+	block.m_subBlocks = {trueId, falseId};
+	trueBlock.m_splitFrom = falseBlock.m_splitFrom = current;
+
+	falseBlock.setAttribute(BasicBlock::Attribute::SubBlock);
+	falseBlock.setExitType(block.exitType());
+	falseBlock.returnExprList = block.returnExprList;
+	falseBlock.condition = block.condition;
+	falseBlock.nextBlock = block.nextBlock;
+	falseBlock.predecessors.push_back(current);
+	falseBlock.predecessors.push_back(trueId);
+
+	falseBlock.scope = trueBlock.scope = block.scope;
+
+	trueBlock.setAttribute(BasicBlock::Attribute::SubBlock);
+	trueBlock.nextBlock[0] = falseId;
+	trueBlock.predecessors.push_back(current);
+
+	for (auto nextBlock : block.nextBlock) {
+		if (nextBlock != NoBlock) {
+			ctx.blocks[nextBlock].removePredecessor(current);
+			ctx.blocks[nextBlock].predecessors.push_back(falseId);
 		}
 	}
 
-	ctx.current->nextBlock[0] = trueBlock;
-	ctx.current->nextBlock[1] = falseBlock;
-
-	auto conditionalExpr = tmpDst->clone();
-	if (binOp.binOpType() == AST::BinOp::Type::Or)
-		conditionalExpr = std::make_unique<AST::UnOp>(AST::UnOp::Type::Not, std::move(conditionalExpr));
-
-	auto chunk = std::make_unique<AST::Chunk>();
-	auto assignment = std::make_unique<AST::Assignment>(tmpDst->clone<AST::LValue>(), binOp.right().clone());
-	auto assignmentPtr = assignment.get();
-	chunk->append(std::move(assignment));
+	block.nextBlock[0] = trueId;
+	block.nextBlock[1] = falseId;
 
-	auto condNode = std::make_unique<AST::If>(std::move(conditionalExpr), std::move(chunk));
-
-	ctx.current->setExitType(ExitType::Conditional);
-	ctx.current->returnExprList = nullptr;
-	ctx.current->condition = condNode->conditions()[0].get();
-	ctx.current->m_condNode = std::move(condNode);
+	/* the true block evaluates the right operand into tmp, which the block jumps on */
+	block.setExitType(ExitType::Conditional);
+	block.returnExprList = nullptr;
+	block.condition = nullptr;
+	block.m_splitValue = tmp;
+	block.m_splitNegated = binOp.binOpType() == AST::BinOp::Type::Or;
 	ctx.popBlock();
 
-	ctx.pushBlock(trueBlock);
-	process(ctx, *assignmentPtr);
+	ctx.pushBlock(trueId);
+	ctx.requiredResults.push_back(1);
+	ctx.dispatch(binOp.right());
+	ctx.requiredResults.pop_back();
+	ctx.emplaceTriplet(IR::Op::Assign, tmp, ctx.stack.back());
+	ctx.stack.pop_back();
 	ctx.popBlock();
 
-	ctx.pushBlock(falseBlock);
+	ctx.pushBlock(falseId);
 }
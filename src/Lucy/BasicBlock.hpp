@@ -1,7 +1,6 @@
 #pragma once
 
 #include <array>
-#include <memory>
 #include <string>
 #include <vector>
 
@@ -11,11 +10,17 @@
 #include "IR.hpp"
 #include "RValue.hpp"
 #include "Serial.hpp"
+#include "SmallVector.hpp"
 
 class ControlFlowGraph;
 class Scope;
 
+/* index of a block in the block array of its ControlFlowGraph */
+using BlockId = uint32_t;
+
 struct BasicBlock {
+	static constexpr BlockId NoBlock = UINT32_MAX;
+
 	EnumClass(ExitType, uint8_t,
 		Conditional,
 		Fallthrough,
@@ -26,22 +31,21 @@ struct BasicBlock {
 	EnumClass(Attribute, uint8_t,
 		BackEdge,
 		LoopFooter,
+		Pruned,
 		SubBlock
 	);
 
-	BasicBlock(UID id);
-	BasicBlock(const std::string &label);
-	BasicBlock(std::string &&label);
+	BasicBlock(UID serial);
 	BasicBlock(const BasicBlock &) = delete;
+	BasicBlock(BasicBlock &&other) noexcept;
 	BasicBlock & operator = (const BasicBlock &) = delete;
-	BasicBlock & operator = (BasicBlock &&other);
+	BasicBlock & operator = (BasicBlock &&other) noexcept;
 	~BasicBlock();
 
-	void irDump(unsigned indent = 0) const;
+	static void irDump(const std::vector <BasicBlock> &blocks, BlockId id, const IR::Code &code, unsigned indent = 0);
 
-	const std::string & label() const { return m_label; }
-	void setLabel(const std::string &label) { m_label = label; }
-	void setLabel(std::string &&label) { m_label = std::move(label); }
+	/* "BB_<serial>", blocks split off by generateIR() add "_T" or "_F" to the label of the block they were split from */
+	static std::string label(const std::vector <BasicBlock> &blocks, BlockId id);
 
 	ExitType exitType() const { return m_exitType; }
 	void setExitType(ExitType et) { m_exitType = et; }
@@ -51,21 +55,21 @@ struct BasicBlock {
 
 	bool canPrune() const;
 	bool isEmpty() const;
-	void generateIR();
-	void removePredecessor(BasicBlock *block);
+	/* generates the IR of a block, blocks split off it are appended to blocks */
+	static void generateIR(std::vector <BasicBlock> &blocks, BlockId id, IR::Code &code);
+	void removePredecessor(BlockId block);
 
-	const BasicBlock * loopFooter() const { return m_loopFooterEdge; }
-	void setLoopFooter(BasicBlock *dst);
+	BlockId loopFooter() const { return m_loopFooterEdge; }
+	static void setLoopFooter(std::vector <BasicBlock> &blocks, BlockId src, BlockId dst);
 
 	std::vector <const AST::Node *> insn;
-	std::vector <std::unique_ptr <IR::Triplet> > irCode;
+	/* triplets of the block in the code of its function */
+	IR::Range irCode;
 
 	const AST::Node *returnExprList = nullptr;
 	const AST::Node *condition = nullptr;
-	std::array <BasicBlock *, 2> nextBlock = {nullptr, nullptr};
-	std::vector <BasicBlock *> predecessors;
-
-	unsigned phase = 0;
+	std::array <BlockId, 2> nextBlock = {NoBlock, NoBlock};
+	SmallVector <BlockId, 2> predecessors;
 
 	Scope *scope = nullptr;
 
@@ -76,23 +80,26 @@ private:
 
 	static void process(BBContext &ctx, const AST::Assignment &assignment);
 	static void process(BBContext &ctx, const AST::BinOp &binOp);
+	static void process(BBContext &ctx, const AST::ConstTable &constTable);
 	static void process(BBContext &ctx, const AST::Ellipsis &ellipsis);
 	static void process(BBContext &ctx, const AST::ExprList &exprList);
 	static void process(BBContext &ctx, const AST::Function &fnNode);
 	static void process(BBContext &ctx, const AST::FunctionCall &fnCallNode);
 	static void process(BBContext &ctx, const AST::LValue &lval);
 	static void process(BBContext &ctx, const AST::NestedExpr &nestedExpr);
-	static void process(BBContext &ctx, const AST::Node &node);
 	static void process(BBContext &ctx, const AST::TableCtor &tableCtor);
 	static void process(BBContext &ctx, const AST::UnOp &binOp);
 	static void process(BBContext &ctx, const AST::Value &valueNode);
 
-	static void splitBlock(BBContext &ctx, const AST::LValue *tmpDst, const AST::BinOp &binOp);
+	static void splitBlock(BBContext &ctx, RValue tmp, const AST::BinOp &binOp);
 
-	std::string m_label;
+	UID m_serial;
 	ExitType m_exitType = ExitType::Fallthrough;
 	Bitfield <Attribute::_size> m_attrib;
-	std::unique_ptr <const AST::If> m_condNode;
-	std::array <std::unique_ptr <BasicBlock>, 2> m_subBlocks;
-	BasicBlock *m_loopFooterEdge = nullptr;
+	/* register the block jumps on if it was split, negated for "or" */
+	RValue m_splitValue;
+	bool m_splitNegated = false;
+	std::array <BlockId, 2> m_subBlocks = {NoBlock, NoBlock};
+	BlockId m_splitFrom = NoBlock;
+	BlockId m_loopFooterEdge = NoBlock;
 };
@@ -0,0 +1,175 @@
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "ByteScan.hpp"
+
+namespace ByteScan {
+
+namespace {
+
+struct Needles {
+	char a;
+	char b;
+	char c;
+};
+
+struct Dispatch {
+	const char * (*findFirstOf)(const char *, const char *, Needles);
+	size_t (*count)(const char *, const char *, char);
+};
+
+const char * findFirstOfScalar(const char *p, const char *end, Needles n)
+{
+	for (; p != end; ++p) {
+		if (*p == n.a || *p == n.b || *p == n.c)
+			return p;
+	}
+
+	return end;
+}
+
+size_t countScalar(const char *begin, const char *end, char c)
+{
+	return std::count(begin, end, c);
+}
+
+#ifdef __SSE2__
+const char * findFirstOfSSE2(const char *p, const char *end, Needles n)
+{
+	const __m128i a = _mm_set1_epi8(n.a);
+	const __m128i b = _mm_set1_epi8(n.b);
+	const __m128i c = _mm_set1_epi8(n.c);
+
+	for (; end - p >= 16; p += 16) {
+		const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		const __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(data, a), _mm_cmpeq_epi8(data, b)), _mm_cmpeq_epi8(data, c));
+		const unsigned mask = _mm_movemask_epi8(match);
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+
+	return findFirstOfScalar(p, end, n);
+}
+
+size_t countSSE2(const char *p, const char *end, char c)
+{
+	const __m128i needle = _mm_set1_epi8(c);
+	size_t result = 0;
+
+	for (; end - p >= 16; p += 16) {
+		const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		result += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(data, needle)));
+	}
+
+	return result + countScalar(p, end, c);
+}
+
+__attribute__((target("avx2")))
+const char * findFirstOfAVX2(const char *p, const char *end, Needles n)
+{
+	const __m256i a = _mm256_set1_epi8(n.a);
+	const __m256i b = _mm256_set1_epi8(n.b);
+	const __m256i c = _mm256_set1_epi8(n.c);
+
+	for (; end - p >= 32; p += 32) {
+		const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		const __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(data, a), _mm256_cmpeq_epi8(data, b)), _mm256_cmpeq_epi8(data, c));
+		const unsigned mask = _mm256_movemask_epi8(match);
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+
+	return findFirstOfSSE2(p, end, n);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t countAVX2(const char *p, const char *end, char c)
+{
+	const __m256i needle = _mm256_set1_epi8(c);
+	size_t result = 0;
+
+	for (; end - p >= 32; p += 32) {
+		const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		result += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, needle)));
+	}
+
+	return result + countSSE2(p, end, c);
+}
+#endif
+
+Dispatch dispatchFor(Implementation impl)
+{
+	switch (impl.value()) {
+#ifdef __SSE2__
+		case Implementation::SSE2:
+			return {findFirstOfSSE2, countSSE2};
+		case Implementation::AVX2:
+			return {findFirstOfAVX2, countAVX2};
+#endif
+		default:
+			return {findFirstOfScalar, countScalar};
+	}
+}
+
+Implementation bestImplementation()
+{
+#ifdef __SSE2__
+	//may run before constructors of the CPU detection itself
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+		return Implementation::AVX2;
+	return Implementation::SSE2;
+#else
+	return Implementation::Scalar;
+#endif
+}
+
+Implementation selected = bestImplementation();
+Dispatch dispatch = dispatchFor(selected);
+
+} //namespace
+
+const char * findFirstOf(const char *begin, const char *end, char a)
+{
+	return dispatch.findFirstOf(begin, end, Needles{a, a, a});
+}
+
+const char * findFirstOf(const char *begin, const char *end, char a, char b)
+{
+	return dispatch.findFirstOf(begin, end, Needles{a, b, b});
+}
+
+const char * findFirstOf(const char *begin, const char *end, char a, char b, char c)
+{
+	return dispatch.findFirstOf(begin, end, Needles{a, b, c});
+}
+
+size_t count(const char *begin, const char *end, char c)
+{
+	return dispatch.count(begin, end, c);
+}
+
+Implementation implementation()
+{
+	return selected;
+}
+
+bool isSupported(Implementation impl)
+{
+	return impl.value() <= bestImplementation().value();
+}
+
+bool setImplementation(Implementation impl)
+{
+	if (!isSupported(impl))
+		return false;
+
+	selected = impl;
+	dispatch = dispatchFor(impl);
+	return true;
+}
+
+} //namespace ByteScan
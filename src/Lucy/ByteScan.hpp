@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+#include "EnumHelpers.hpp"
+
+/*
+ * Searching of byte buffers. SSE2/AVX2 implementations are selected at runtime
+ * according to the instruction sets supported by the CPU, the scalar one is
+ * used everywhere else.
+ */
+namespace ByteScan {
+
+EnumClass(Implementation, unsigned,
+	Scalar,
+	SSE2,
+	AVX2
+);
+
+/* Return pointer to the first byte in [begin, end) equal to any of the given ones, or end. */
+const char * findFirstOf(const char *begin, const char *end, char a);
+const char * findFirstOf(const char *begin, const char *end, char a, char b);
+const char * findFirstOf(const char *begin, const char *end, char a, char b, char c);
+
+size_t count(const char *begin, const char *end, char c);
+
+Implementation implementation();
+bool isSupported(Implementation impl);
+bool setImplementation(Implementation impl);
+
+} //namespace ByteScan
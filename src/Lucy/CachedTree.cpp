@@ -0,0 +1,602 @@
+#include <cstring>
+#include <ostream>
+
+#include "AnalysisSession.hpp"
+#include "CachedTree.hpp"
+
+namespace AST {
+
+namespace {
+	constexpr char Padding[CachedTree::Alignment] = {};
+
+	size_t alignUp(size_t bytes)
+	{
+		return (bytes + CachedTree::Alignment - 1) & ~(CachedTree::Alignment - 1);
+	}
+}
+
+CachedTree::CachedTree(const Chunk &root)
+{
+	add(root);
+	m_symbolIndex = SymbolMap <Symbol>{};
+}
+
+template <typename Tree, typename Fn>
+void CachedTree::forEachColumn(Tree &tree, Fn &&fn)
+{
+	fn(tree.m_types);
+	fn(tree.m_locations);
+	fn(tree.m_data);
+	fn(tree.m_lists);
+	fn(tree.m_params);
+	fn(tree.m_lvalues);
+	fn(tree.m_calls);
+	fn(tree.m_assignments);
+	fn(tree.m_values);
+	fn(tree.m_fields);
+	fn(tree.m_operators);
+	fn(tree.m_returns);
+	fn(tree.m_nested);
+	fn(tree.m_names);
+	fn(tree.m_functions);
+	fn(tree.m_branches);
+	fn(tree.m_loops);
+	fn(tree.m_fors);
+	fn(tree.m_forEachs);
+	fn(tree.m_constTables);
+	fn(tree.m_children);
+	fn(tree.m_paramNames);
+	fn(tree.m_nameParts);
+	fn(tree.m_constTableParts);
+	fn(tree.m_constFields);
+}
+
+void CachedTree::write(std::ostream &os) const
+{
+	forEachColumn(*this, [&os](const auto &column)
+	{
+		const uint64_t count = column.size();
+		const size_t bytes = count * sizeof(column[0]);
+		os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+		os.write(reinterpret_cast<const char *>(column.data()), bytes);
+		os.write(Padding, alignUp(bytes) - bytes);
+	});
+
+	const uint64_t symbolCount = m_symbolIds.size();
+	os.write(reinterpret_cast<const char *>(&symbolCount), sizeof(symbolCount));
+	for (SymbolId symbol : m_symbolIds) {
+		const std::string &spelling = symbol.str();
+		const uint32_t length = spelling.size();
+		os.write(reinterpret_cast<const char *>(&length), sizeof(length));
+		os.write(spelling.data(), length);
+	}
+}
+
+std::unique_ptr <CachedTree> CachedTree::load(const char *data, size_t size, FileId file)
+{
+	assert(reinterpret_cast<uintptr_t>(data) % Alignment == 0);
+
+	std::unique_ptr <CachedTree> tree{new CachedTree};
+	tree->m_file = file;
+
+	const char *p = data, *end = data + size;
+	auto read = [&p, end](auto &value)
+	{
+		if (static_cast<size_t>(end - p) < sizeof(value))
+			return false;
+		memcpy(&value, p, sizeof(value));
+		p += sizeof(value);
+		return true;
+	};
+
+	bool valid = true;
+	forEachColumn(*tree, [&p, end, &read, &valid](auto &column)
+	{
+		using T = typename std::decay_t<decltype(column)>::value_type;
+
+		uint64_t count;
+		if (!valid || !read(count) || count > static_cast<size_t>(end - p) / sizeof(T) || alignUp(count * sizeof(T)) > static_cast<size_t>(end - p)) {
+			valid = false;
+			return;
+		}
+
+		column.view(reinterpret_cast<const T *>(p), count);
+		p += alignUp(count * sizeof(T));
+	});
+
+	uint64_t symbolCount;
+	if (!valid || tree->m_types.size() == 0 || !read(symbolCount) || symbolCount > static_cast<size_t>(end - p) / sizeof(uint32_t))
+		return nullptr;
+
+	tree->m_symbolIds.reserve(symbolCount);
+	for (uint64_t i = 0; i != symbolCount; ++i) {
+		uint32_t length;
+		if (!read(length) || length > static_cast<size_t>(end - p))
+			return nullptr;
+		tree->m_symbolIds.emplace_back(std::string_view{p, length});
+		p += length;
+	}
+
+	if (p != end)
+		return nullptr;
+	return tree;
+}
+
+CachedTree::Symbol CachedTree::addSymbol(SymbolId symbol)
+{
+	if (const Symbol *found = m_symbolIndex.find(symbol))
+		return *found;
+
+	const Symbol result = m_symbolIds.size();
+	m_symbolIds.push_back(symbol);
+	m_symbolIndex[symbol] = result;
+	return result;
+}
+
+Location CachedTree::treeLocation(const Location &location)
+{
+	if (location.file == NoFile)
+		return location;
+
+	if (m_file == NoFile)
+		m_file = location.file;
+	assert(location.file == m_file);
+
+	return Location{TreeFile, location.begin, location.end};
+}
+
+Location CachedTree::sessionLocation(const Location &location) const
+{
+	return Location{location.file == NoFile ? NoFile : m_file, location.begin, location.end};
+}
+
+CachedTree::NodeId CachedTree::add(const Node &node)
+{
+	const NodeId id = m_types.size();
+	m_types.push(node.type());
+	m_locations.push(treeLocation(node.location()));
+	m_data.push(0);
+
+	/* children are added before the data of their parent is stored, so they get the following ids */
+	uint32_t data = 0;
+
+	switch (node.type().value()) {
+		case Node::Type::Chunk:
+			data = m_lists.push(addChildren(static_cast<const Chunk &>(node).children()));
+			break;
+		case Node::Type::ExprList:
+			data = m_lists.push(addChildren(static_cast<const ExprList &>(node).exprs()));
+			break;
+		case Node::Type::VarList:
+			data = m_lists.push(addChildren(static_cast<const VarList &>(node).vars()));
+			break;
+		case Node::Type::TableCtor:
+			data = m_lists.push(addChildren(static_cast<const TableCtor &>(node).fields()));
+			break;
+		case Node::Type::ConstTable: {
+			const auto &table = static_cast<const ConstTable &>(node);
+			const ConstTableData result{
+				Range{static_cast<uint32_t>(m_constTableParts.size()), table.m_tables.size},
+				Range{static_cast<uint32_t>(m_constFields.size()), table.m_fields.size}
+			};
+
+			/* ids and ranges are stored relative to the first table and field of the literal */
+			for (ConstTable::TableId id = table.m_tables.first; id != table.m_tables.end(); ++id) {
+				ConstTable::Table part = table.table(id);
+				part.fields.first -= table.m_fields.first;
+				part.location = treeLocation(part.location);
+				m_constTableParts.push(part);
+			}
+			for (uint32_t idx = table.m_fields.first; idx != table.m_fields.end(); ++idx) {
+				const ConstTable::Entry &field = table.field(idx);
+				ConstField flat{field.type, addSymbol(field.name), field.key, field.value, treeLocation(field.location), field.valueOffset};
+				if (flat.value.type == ValueType::Table)
+					flat.value.table -= table.m_tables.first;
+				m_constFields.push(flat);
+			}
+
+			data = m_constTables.push(result);
+			break;
+		}
+		case Node::Type::NestedExpr:
+			data = m_nested.push(add(static_cast<const NestedExpr &>(node).expr()));
+			break;
+		case Node::Type::ParamList: {
+			const auto &params = static_cast<const ParamList &>(node);
+			data = m_params.push(Params{addParams(params), params.hasEllipsis()});
+			break;
+		}
+		case Node::Type::Ellipsis:
+		case Node::Type::Break:
+			break;
+		case Node::Type::LValue: {
+			const auto &lvalue = static_cast<const LValue &>(node);
+			const LValue::Type type = lvalue.lvalueType();
+			const NodeId table = type != LValue::Type::Name ? add(lvalue.tableExpr()) : NoNode;
+			const NodeId key = type == LValue::Type::Bracket ? add(lvalue.keyExpr()) : NoNode;
+			data = m_lvalues.push(LValueData{type, table, key, addSymbol(lvalue.name())});
+			break;
+		}
+		case Node::Type::FunctionCall:
+		case Node::Type::MethodCall: {
+			const auto &call = static_cast<const FunctionCall &>(node);
+			const NodeId function = add(call.functionExpr());
+			const NodeId args = add(call.args());
+			const Symbol method = addSymbol(node.type() == Node::Type::MethodCall ? static_cast<const MethodCall &>(node).methodName() : SymbolId{});
+			data = m_calls.push(Call{function, args, method});
+			break;
+		}
+		case Node::Type::Assignment: {
+			const auto &assignment = static_cast<const Assignment &>(node);
+			const NodeId vars = add(assignment.varList());
+			const NodeId exprs = add(assignment.exprList());
+			data = m_assignments.push(AssignmentData{vars, exprs, assignment.isLocal()});
+			break;
+		}
+		case Node::Type::Value: {
+			const auto &value = static_cast<const Value &>(node);
+			ValueData result{value.valueType(), {}};
+
+			switch (value.valueType().value()) {
+				case ValueType::Boolean:
+					result.boolean = static_cast<const BooleanValue &>(value).value();
+					break;
+				case ValueType::Integer:
+					result.integer = static_cast<const IntValue &>(value).value();
+					break;
+				case ValueType::Real:
+					result.real = static_cast<const RealValue &>(value).value();
+					break;
+				case ValueType::String: {
+					const auto &string = static_cast<const StringValue &>(value);
+					const Location &loc = string.location();
+					assert(string.delimiter() != 0);
+					result.string = Range{loc.begin + string.delimiter(), loc.end - loc.begin - 2 * string.delimiter()};
+					break;
+				}
+				default:
+					break;
+			}
+
+			data = m_values.push(result);
+			break;
+		}
+		case Node::Type::Field: {
+			const auto &field = static_cast<const Field &>(node);
+			const NodeId key = field.fieldType() == Field::Type::Brackets ? add(field.keyExpr()) : NoNode;
+			const NodeId value = add(field.valueExpr());
+			data = m_fields.push(FieldData{field.fieldType(), addSymbol(field.fieldName()), key, value});
+			break;
+		}
+		case Node::Type::BinOp: {
+			const auto &binOp = static_cast<const BinOp &>(node);
+			const NodeId left = add(binOp.left());
+			const NodeId right = add(binOp.right());
+			data = m_operators.push(Operator{binOp.binOpType().value(), left, right});
+			break;
+		}
+		case Node::Type::UnOp: {
+			const auto &unOp = static_cast<const UnOp &>(node);
+			data = m_operators.push(Operator{unOp.unOpType().value(), add(unOp.operand()), NoNode});
+			break;
+		}
+		case Node::Type::Return: {
+			const auto &ret = static_cast<const Return &>(node);
+			data = m_returns.push(ret.empty() ? NoNode : add(ret.exprList()));
+			break;
+		}
+		case Node::Type::FunctionName: {
+			const auto &name = static_cast<const FunctionName &>(node);
+			const Range parts{static_cast<uint32_t>(m_nameParts.size()), static_cast<uint32_t>(name.nameParts().size())};
+			for (SymbolId part : name.nameParts())
+				m_nameParts.push(addSymbol(part));
+			data = m_names.push(Name{parts, addSymbol(name.method())});
+			break;
+		}
+		case Node::Type::Function: {
+			const auto &function = static_cast<const Function &>(node);
+			const NodeId name = function.isAnonymous() ? NoNode : add(function.name());
+			const NodeId params = add(function.paramList());
+			const NodeId chunk = add(function.chunk());
+			data = m_functions.push(FunctionData{name, params, chunk, function.isLocal()});
+			break;
+		}
+		case Node::Type::If: {
+			const auto &ifNode = static_cast<const If &>(node);
+			const Range conditions = addChildren(ifNode.conditions());
+			const Range chunks = addChildren(ifNode.chunks());
+			const NodeId elseChunk = ifNode.hasElse() ? add(ifNode.elseNode()) : NoNode;
+			data = m_branches.push(Branches{conditions, chunks, elseChunk});
+			break;
+		}
+		case Node::Type::While: {
+			const auto &loop = static_cast<const While &>(node);
+			const NodeId condition = add(loop.condition());
+			data = m_loops.push(Loop{condition, add(loop.chunk())});
+			break;
+		}
+		case Node::Type::Repeat: {
+			const auto &loop = static_cast<const Repeat &>(node);
+			const NodeId condition = add(loop.condition());
+			data = m_loops.push(Loop{condition, add(loop.chunk())});
+			break;
+		}
+		case Node::Type::For: {
+			const auto &loop = static_cast<const For &>(node);
+			const NodeId start = add(loop.startExpr());
+			const NodeId limit = add(loop.limitExpr());
+			const NodeId step = loop.hasStepExpression() ? add(loop.stepExpr()) : NoNode;
+			data = m_fors.push(ForData{addSymbol(loop.iterator()), start, limit, step, add(loop.chunk())});
+			break;
+		}
+		case Node::Type::ForEach: {
+			const auto &loop = static_cast<const ForEach &>(node);
+			const NodeId variables = add(loop.variables());
+			const NodeId exprs = add(loop.exprList());
+			data = m_forEachs.push(ForEachData{variables, exprs, add(loop.chunk())});
+			break;
+		}
+		default:
+			FATAL(node.location() << " : Unhandled node type: " << node.type() << '\n');
+	}
+
+	m_data.set(id, data);
+	return id;
+}
+
+CachedTree::Range CachedTree::addParams(const ParamList &params)
+{
+	const Range result{static_cast<uint32_t>(m_paramNames.size()), static_cast<uint32_t>(params.names().size())};
+	for (const auto &[name, location] : params.names())
+		m_paramNames.push(Param{addSymbol(name), treeLocation(location)});
+	return result;
+}
+
+template <typename T>
+CachedTree::Range CachedTree::addChildren(const std::vector <NodePtr <T> > &nodes)
+{
+	/* the range is reserved first, grandchildren are stored after it */
+	const Range result{static_cast<uint32_t>(m_children.size()), static_cast<uint32_t>(nodes.size())};
+	m_children.resize(m_children.size() + nodes.size());
+
+	for (uint32_t i = 0; i != result.size; ++i) {
+		const NodeId child = add(*nodes[i]);
+		m_children.set(result.first + i, child);
+	}
+
+	return result;
+}
+
+std::unique_ptr <Chunk> CachedTree::expand() const
+{
+	return expandAs<Chunk>(root());
+}
+
+std::unique_ptr <Node> CachedTree::expandNode(NodeId node) const
+{
+	std::unique_ptr <Node> result;
+	const Location loc = location(node);
+
+	switch (m_types[node].value()) {
+		case Node::Type::Chunk:
+			result = expandList<Chunk, Node>(node);
+			break;
+		case Node::Type::ExprList:
+			result = expandList<ExprList, Node>(node);
+			break;
+		case Node::Type::VarList:
+			result = expandList<VarList, LValue>(node);
+			break;
+		case Node::Type::TableCtor:
+			result = expandList<TableCtor, Field>(node);
+			break;
+		case Node::Type::ConstTable: {
+			const ConstTableData &data = constTable(node);
+			auto storage = std::make_shared<ConstTableStorage>();
+
+			storage->tables.reserve(data.tables.size);
+			for (uint32_t i = data.tables.first; i != data.tables.end(); ++i) {
+				ConstTable::Table part = m_constTableParts[i];
+				part.location = sessionLocation(part.location);
+				storage->tables.push_back(part);
+			}
+
+			storage->fields.reserve(data.fields.size);
+			for (uint32_t i = data.fields.first; i != data.fields.end(); ++i) {
+				const ConstField &field = m_constFields[i];
+				storage->fields.push_back(ConstTable::Entry{field.type, symbol(field.name), field.key, field.value, sessionLocation(field.location),
+					field.valueOffset});
+			}
+
+			const ConstTable::Range tables{0, data.tables.size}, fields{0, data.fields.size};
+			result.reset(new ConstTable{loc, std::move(storage), tables, fields});
+			break;
+		}
+		case Node::Type::NestedExpr:
+			result = std::make_unique<NestedExpr>(expandNode(nestedExpr(node)), loc);
+			break;
+		case Node::Type::ParamList:
+			result = expandParams(node);
+			break;
+		case Node::Type::Ellipsis:
+			result = std::make_unique<Ellipsis>(loc);
+			break;
+		case Node::Type::Break:
+			result = std::make_unique<Break>(loc);
+			break;
+		case Node::Type::LValue: {
+			const LValueData &lvalue = this->lvalue(node);
+			switch (lvalue.type) {
+				case LValue::Type::Bracket:
+					result = std::make_unique<LValue>(expandNode(lvalue.table), expandNode(lvalue.key), loc);
+					break;
+				case LValue::Type::Dot:
+					result = std::make_unique<LValue>(expandNode(lvalue.table), symbol(lvalue.name), loc);
+					break;
+				case LValue::Type::Name:
+					result = std::make_unique<LValue>(symbol(lvalue.name), loc);
+					break;
+			}
+			break;
+		}
+		case Node::Type::FunctionCall: {
+			const Call &call = this->call(node);
+			result = std::make_unique<FunctionCall>(expandNode(call.function), expandAs<ExprList>(call.args), loc);
+			break;
+		}
+		case Node::Type::MethodCall: {
+			const Call &call = this->call(node);
+			result = std::make_unique<MethodCall>(expandNode(call.function), expandAs<ExprList>(call.args), symbol(call.method), loc);
+			break;
+		}
+		case Node::Type::Assignment: {
+			const AssignmentData &assignment = this->assignment(node);
+			auto tmp = std::make_unique<Assignment>(expandAs<VarList>(assignment.vars), expandAs<ExprList>(assignment.exprs), loc);
+			tmp->setLocal(assignment.local);
+			result = std::move(tmp);
+			break;
+		}
+		case Node::Type::Value: {
+			const ValueData &value = this->value(node);
+			switch (value.type.value()) {
+				case ValueType::Nil:
+					result = std::make_unique<NilValue>(loc);
+					break;
+				case ValueType::Boolean:
+					result = std::make_unique<BooleanValue>(value.boolean, loc);
+					break;
+				case ValueType::Integer:
+					result = std::make_unique<IntValue>(value.integer, loc);
+					break;
+				case ValueType::Real:
+					result = std::make_unique<RealValue>(value.real, loc);
+					break;
+				case ValueType::String: {
+					const char *text = AnalysisSession::current().sourceFile(m_file).text();
+					result = std::make_unique<StringValue>(std::string_view{text + value.string.first, value.string.size}, loc);
+					break;
+				}
+				default:
+					FATAL(loc << " : Unhandled value type: " << value.type << '\n');
+			}
+			break;
+		}
+		case Node::Type::Field: {
+			const FieldData &field = this->field(node);
+			switch (field.type) {
+				case Field::Type::Brackets:
+					result = std::make_unique<Field>(expandNode(field.key), expandNode(field.value), loc);
+					break;
+				case Field::Type::Literal:
+					result = std::make_unique<Field>(symbol(field.name), expandNode(field.value), loc);
+					break;
+				case Field::Type::NoIndex:
+					result = std::make_unique<Field>(expandNode(field.value), loc);
+					break;
+			}
+			break;
+		}
+		case Node::Type::BinOp: {
+			const Operator &binOp = op(node);
+			result = std::make_unique<BinOp>(BinOp::Type{binOp.op}, expandNode(binOp.left), expandNode(binOp.right), loc);
+			break;
+		}
+		case Node::Type::UnOp: {
+			const Operator &unOp = op(node);
+			result = std::make_unique<UnOp>(UnOp::Type{unOp.op}, expandNode(unOp.left), loc);
+			break;
+		}
+		case Node::Type::Return: {
+			const NodeId exprs = returnExprs(node);
+			result = std::make_unique<Return>(exprs != NoNode ? expandAs<ExprList>(exprs) : nullptr, loc);
+			break;
+		}
+		case Node::Type::FunctionName: {
+			const Name &name = this->name(node);
+			auto tmp = std::make_unique<FunctionName>(symbol(m_nameParts[name.parts.first]), loc);
+			for (uint32_t i = name.parts.first + 1; i != name.parts.end(); ++i)
+				tmp->appendNamePart(symbol(m_nameParts[i]), loc);
+			if (!symbol(name.method).empty())
+				tmp->appendMethodName(symbol(name.method), loc);
+			result = std::move(tmp);
+			break;
+		}
+		case Node::Type::Function: {
+			const FunctionData &function = this->function(node);
+			auto tmp = std::make_unique<Function>(expandParams(function.params), expandAs<Chunk>(function.chunk), loc);
+			if (function.name != NoNode)
+				tmp->setName(expandAs<FunctionName>(function.name));
+			if (function.local)
+				tmp->setLocal();
+			result = std::move(tmp);
+			break;
+		}
+		case Node::Type::If: {
+			const Branches &branches = this->branches(node);
+			const uint32_t first = branches.conditions.first, firstChunk = branches.chunks.first;
+			auto tmp = std::make_unique<If>(expandNode(m_children[first]), expandAs<Chunk>(m_children[firstChunk]), loc);
+			for (uint32_t i = 1; i != branches.conditions.size; ++i)
+				tmp->addElseIf(expandNode(m_children[first + i]), expandAs<Chunk>(m_children[firstChunk + i]));
+			if (branches.elseChunk != NoNode)
+				tmp->setElse(expandAs<Chunk>(branches.elseChunk));
+			result = std::move(tmp);
+			break;
+		}
+		case Node::Type::While: {
+			const Loop &loop = this->loop(node);
+			result = std::make_unique<While>(expandNode(loop.condition), expandAs<Chunk>(loop.chunk), loc);
+			break;
+		}
+		case Node::Type::Repeat: {
+			const Loop &loop = this->loop(node);
+			result = std::make_unique<Repeat>(expandNode(loop.condition), expandAs<Chunk>(loop.chunk), loc);
+			break;
+		}
+		case Node::Type::For: {
+			const ForData &loop = forLoop(node);
+			result = std::make_unique<For>(symbol(loop.iterator), expandNode(loop.start), expandNode(loop.limit),
+				loop.step != NoNode ? expandNode(loop.step) : nullptr, expandAs<Chunk>(loop.chunk), loc);
+			break;
+		}
+		case Node::Type::ForEach: {
+			const ForEachData &loop = forEach(node);
+			result = std::make_unique<ForEach>(expandParams(loop.variables), expandAs<ExprList>(loop.exprs), expandAs<Chunk>(loop.chunk), loc);
+			break;
+		}
+		default:
+			FATAL(loc << " : Unhandled node type: " << m_types[node] << '\n');
+	}
+
+	/* appending children extends the location of lists, restore the parsed one */
+	result->m_location = loc;
+	return result;
+}
+
+template <typename List, typename Child>
+std::unique_ptr <List> CachedTree::expandList(NodeId node) const
+{
+	auto result = std::make_unique<List>(location(node));
+
+	const Range children = list(node);
+	for (uint32_t i = children.first; i != children.end(); ++i)
+		result->append(expandAs<Child>(m_children[i]));
+
+	return result;
+}
+
+std::unique_ptr <ParamList> CachedTree::expandParams(NodeId node) const
+{
+	const Params &params = this->params(node);
+	const Location loc = location(node);
+	auto result = std::make_unique<ParamList>(loc);
+
+	for (uint32_t i = params.names.first; i != params.names.end(); ++i)
+		result->append(symbol(m_paramNames[i].name), sessionLocation(m_paramNames[i].location));
+	if (params.ellipsis)
+		result->setEllipsis();
+
+	result->m_location = loc;
+	return result;
+}
+
+} //namespace AST
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "AST.hpp"
+
+namespace AST {
+
+/*
+ * On-disk form of a parsed AST, the format of ASTCache entries and nothing
+ * else: the parser builds Node trees and the analyses walk those, a tree is
+ * flattened only to be stored and is expanded right after it is loaded.
+ *
+ * Nodes are numbered by 32-bit NodeIds in pre-order (a parent precedes its
+ * children) and stored as struct-of-arrays. The kind and location of every
+ * node live in parallel arrays, data specific to a kind lives in an array per
+ * node shape. Lists of children are index ranges into a single side buffer of
+ * NodeIds, so the whole tree is a handful of contiguous allocations with no
+ * pointers in it.
+ *
+ * Built from a parsed Chunk in a single pass, expand() restores an equal Node
+ * tree. The arrays do not depend on the session the tree was built in: symbols
+ * are indices into a table of the tree and locations only tell whether a node
+ * comes from the source file, so write() can store the arrays as they are and
+ * load() can use them in place, right from a mapped file. Strings are not
+ * copied, they are ranges of the text of the source file, which has to be the
+ * text the tree was parsed from.
+ */
+class CachedTree {
+public:
+	explicit CachedTree(const Chunk &root);
+	CachedTree(const CachedTree &) = delete;
+	CachedTree(CachedTree &&) = default;
+	void operator = (const CachedTree &) = delete;
+	CachedTree & operator = (CachedTree &&) = default;
+
+	std::unique_ptr <Chunk> expand() const;
+
+	/*
+	 * Binary form of the tree: every array as its element count and raw bytes
+	 * padded to Alignment, then the spellings of the symbols. It is only read
+	 * back by the same build of Lucy (the layout of the structs is not fixed).
+	 */
+	static constexpr size_t Alignment = 8;
+	void write(std::ostream &os) const;
+
+	/*
+	 * Tree of the source file `file` of the current session, using the arrays
+	 * of data in place. data has to be aligned to Alignment and has to outlive
+	 * the tree. nullptr if data is truncated.
+	 */
+	static std::unique_ptr <CachedTree> load(const char *data, size_t size, FileId file);
+
+private:
+	using NodeId = uint32_t;
+	static constexpr NodeId NoNode = UINT32_MAX;
+
+	/* index into the symbol table of the tree */
+	using Symbol = uint32_t;
+
+	struct Range {
+		uint32_t first;
+		uint32_t size;
+
+		uint32_t end() const { return first + size; }
+	};
+
+	struct Param {
+		Symbol name;
+		Location location;
+	};
+
+	/* ParamList */
+	struct Params {
+		Range names;
+		bool ellipsis;
+	};
+
+	struct LValueData {
+		LValue::Type type;
+		NodeId table;
+		NodeId key;
+		Symbol name;
+	};
+
+	/* FunctionCall, MethodCall (empty method for plain calls) */
+	struct Call {
+		NodeId function;
+		NodeId args;
+		Symbol method;
+	};
+
+	struct AssignmentData {
+		NodeId vars;
+		NodeId exprs;
+		bool local;
+	};
+
+	/* Value, strings are ranges of the source text inside their delimiters */
+	struct ValueData {
+		ValueType type;
+		union {
+			bool boolean;
+			long integer;
+			double real;
+			Range string;
+		};
+	};
+
+	struct FieldData {
+		Field::Type type;
+		Symbol name;
+		NodeId key;
+		NodeId value;
+	};
+
+	/* BinOp, UnOp (no right operand) */
+	struct Operator {
+		unsigned op;
+		NodeId left;
+		NodeId right;
+	};
+
+	struct Name {
+		Range parts;
+		Symbol method;
+	};
+
+	struct FunctionData {
+		NodeId name;
+		NodeId params;
+		NodeId chunk;
+		bool local;
+	};
+
+	/* If, conditions and chunks are parallel ranges */
+	struct Branches {
+		Range conditions;
+		Range chunks;
+		NodeId elseChunk;
+	};
+
+	/* While, Repeat */
+	struct Loop {
+		NodeId condition;
+		NodeId chunk;
+	};
+
+	struct ForData {
+		Symbol iterator;
+		NodeId start;
+		NodeId limit;
+		NodeId step;
+		NodeId chunk;
+	};
+
+	struct ForEachData {
+		NodeId variables;
+		NodeId exprs;
+		NodeId chunk;
+	};
+
+	/* ConstTable, its tables and fields are copied to columns of their own */
+	struct ConstTableData {
+		Range tables;
+		Range fields;
+	};
+
+	/* ConstTable::Entry with the name of a Literal field as a symbol of the tree */
+	struct ConstField {
+		Field::Type type;
+		Symbol name;
+		ConstTable::Item key;
+		ConstTable::Item value;
+		Location location;
+		uint32_t valueOffset;
+	};
+
+	NodeId root() const { return 0; }
+
+	Node::Type type(NodeId node) const { return m_types[node]; }
+	Location location(NodeId node) const { return sessionLocation(m_locations[node]); }
+
+	/* kind specific data, valid for the node kinds listed at the struct */
+	Range list(NodeId node) const { return m_lists[m_data[node]]; }
+	const Params & params(NodeId node) const { return m_params[m_data[node]]; }
+	const LValueData & lvalue(NodeId node) const { return m_lvalues[m_data[node]]; }
+	const Call & call(NodeId node) const { return m_calls[m_data[node]]; }
+	const AssignmentData & assignment(NodeId node) const { return m_assignments[m_data[node]]; }
+	const ValueData & value(NodeId node) const { return m_values[m_data[node]]; }
+	const FieldData & field(NodeId node) const { return m_fields[m_data[node]]; }
+	const Operator & op(NodeId node) const { return m_operators[m_data[node]]; }
+	NodeId returnExprs(NodeId node) const { return m_returns[m_data[node]]; }
+	NodeId nestedExpr(NodeId node) const { return m_nested[m_data[node]]; }
+	const Name & name(NodeId node) const { return m_names[m_data[node]]; }
+	const FunctionData & function(NodeId node) const { return m_functions[m_data[node]]; }
+	const Branches & branches(NodeId node) const { return m_branches[m_data[node]]; }
+	const Loop & loop(NodeId node) const { return m_loops[m_data[node]]; }
+	const ForData & forLoop(NodeId node) const { return m_fors[m_data[node]]; }
+	const ForEachData & forEach(NodeId node) const { return m_forEachs[m_data[node]]; }
+	const ConstTableData & constTable(NodeId node) const { return m_constTables[m_data[node]]; }
+
+	SymbolId symbol(Symbol symbol) const { return m_symbolIds[symbol]; }
+
+	/* file of the locations of nodes parsed from the source, the others are NoFile */
+	static constexpr FileId TreeFile = 1;
+
+	/*
+	 * Array of one kind of data, owned by the tree when it is built from a
+	 * Chunk, a view of memory owned by the caller when it is loaded.
+	 */
+	template <typename T>
+	class Column {
+	public:
+		static_assert(std::is_trivially_copyable_v<T>, "columns are stored as raw bytes");
+		using value_type = T;
+
+		const T & operator [] (size_t idx) const { return m_data[idx]; }
+		const T * data() const { return m_data; }
+		size_t size() const { return m_size; }
+
+		uint32_t push(const T &value)
+		{
+			m_owned.push_back(value);
+			sync();
+			return m_size - 1;
+		}
+
+		void append(const T *values, size_t count)
+		{
+			m_owned.insert(m_owned.end(), values, values + count);
+			sync();
+		}
+
+		void resize(size_t size)
+		{
+			m_owned.resize(size);
+			sync();
+		}
+
+		void set(size_t idx, const T &value)
+		{
+			assert(m_data == m_owned.data());
+			m_owned[idx] = value;
+		}
+
+		void view(const T *data, size_t size)
+		{
+			m_owned.clear();
+			m_data = data;
+			m_size = size;
+		}
+
+	private:
+		void sync()
+		{
+			m_data = m_owned.data();
+			m_size = m_owned.size();
+		}
+
+		std::vector <T> m_owned;
+		const T *m_data = nullptr;
+		size_t m_size = 0;
+	};
+
+	CachedTree() = default;
+
+	/* calls fn for every column, in the order they are stored in the binary form */
+	template <typename Tree, typename Fn>
+	static void forEachColumn(Tree &tree, Fn &&fn);
+
+	NodeId add(const Node &node);
+	NodeId addOptional(const Node *node) { return node ? add(*node) : NoNode; }
+	Range addParams(const ParamList &params);
+	Symbol addSymbol(SymbolId symbol);
+	template <typename T>
+	Range addChildren(const std::vector <NodePtr <T> > &nodes);
+	Location treeLocation(const Location &location);
+	Location sessionLocation(const Location &location) const;
+
+	std::unique_ptr <Node> expandNode(NodeId node) const;
+	std::unique_ptr <ParamList> expandParams(NodeId node) const;
+	template <typename List, typename Child>
+	std::unique_ptr <List> expandList(NodeId node) const;
+
+	template <typename T>
+	std::unique_ptr <T> expandAs(NodeId node) const
+	{
+		return std::unique_ptr <T>{static_cast<T *>(expandNode(node).release())};
+	}
+
+	Column <Node::Type> m_types;
+	Column <Location> m_locations;
+	Column <uint32_t> m_data;
+
+	Column <Range> m_lists;
+	Column <Params> m_params;
+	Column <LValueData> m_lvalues;
+	Column <Call> m_calls;
+	Column <AssignmentData> m_assignments;
+	Column <ValueData> m_values;
+	Column <FieldData> m_fields;
+	Column <Operator> m_operators;
+	Column <NodeId> m_returns;
+	Column <NodeId> m_nested;
+	Column <Name> m_names;
+	Column <FunctionData> m_functions;
+	Column <Branches> m_branches;
+	Column <Loop> m_loops;
+	Column <ForData> m_fors;
+	Column <ForEachData> m_forEachs;
+	Column <ConstTableData> m_constTables;
+
+	Column <NodeId> m_children;
+	Column <Param> m_paramNames;
+	Column <Symbol> m_nameParts;
+	Column <ConstTable::Table> m_constTableParts;
+	Column <ConstField> m_constFields;
+
+	/* ids in the current session of the symbols of the tree, interned on load */
+	std::vector <SymbolId> m_symbolIds;
+	SymbolMap <Symbol> m_symbolIndex;
+	FileId m_file = NoFile;
+};
+
+} //namespace AST
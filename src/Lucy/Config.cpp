@@ -1,5 +1,8 @@
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <string_view>
 #include <vector>
 
@@ -7,6 +10,21 @@
 #include "Issue.hpp"
 #include "Logger.hpp"
 
+namespace {
+	/* decimal number in [min, UINT_MAX], anything else is fatal */
+	unsigned parseUnsigned(std::string_view option, std::string_view arg, unsigned min = 0)
+	{
+		const std::string value{arg};
+		char *parseEnd;
+		errno = 0;
+		const unsigned long result = strtoul(value.c_str(), &parseEnd, 10);
+		if (value.empty() || errno == ERANGE || *parseEnd != '\0' || result < min || result > std::numeric_limits<unsigned>::max())
+			FATAL("Invalid value passed to " << option << ": " << value << '\n');
+
+		return result;
+	}
+}
+
 void Config::parse(unsigned argc, const char **argv)
 {
 	std::vector <std::string_view> vec;
@@ -74,6 +92,22 @@ void Config::parse(const std::vector <std::string_view> &argv)
 			} else {
 				LOG(Logger::Pedantic, "Unknown flag: " << argv[idx] << '\n');
 			}
+		} else if (current == "--cache-dir") {
+			ensureArg();
+			this->astCacheDir = argv[idx];
+		} else if (current == "--cache-size") {
+			ensureArg();
+			this->astCacheSize = parseUnsigned(current, argv[idx]);
+		} else if (current == "--data-files") {
+			ensureArg();
+			if (argv[idx] == "auto")
+				this->dataFiles = DataFiles::Auto;
+			else if (argv[idx] == "always")
+				this->dataFiles = DataFiles::Always;
+			else if (argv[idx] == "never")
+				this->dataFiles = DataFiles::Never;
+			else
+				FATAL("Unknown data files mode: " << argv[idx] << '\n');
 		} else if (current == "--dump-ast") {
 			boolOpts.set(Option::DumpAST);
 		} else if (current == "--dump-issues") {
@@ -81,17 +115,70 @@ void Config::parse(const std::vector <std::string_view> &argv)
 			this->issuesOutput = argv[idx];
 		} else if (current == "--dump-ir") {
 			boolOpts.set(Option::DumpIR);
+		} else if (current == "--dump-ssa") {
+			boolOpts.set(Option::DumpSSA);
+		} else if (current == "--dump-tokens") {
+			boolOpts.set(Option::DumpTokens);
+		} else if (current == "--edit-from") {
+			ensureArg();
+			this->editFrom = argv[idx];
+		} else if (current == "--files0-from") {
+			ensureArg();
+			this->fileListInput = argv[idx];
 		} else if (current == "--graphviz") {
 			ensureArg();
 			this->graphvizOutput = argv[idx];
 		} else if (current == "-h" || current == "--help") {
 			usage();
+		} else if (current == "-j" || current == "--jobs") {
+			ensureArg();
+			this->jobs = parseUnsigned(current, argv[idx]);
+		} else if (current == "--lazy-functions") {
+			boolOpts.set(Option::LazyFunctions);
+		} else if (current == "--lexer") {
+			ensureArg();
+			if (argv[idx] == "flex")
+				boolOpts.unset(Option::NativeLexer);
+			else if (argv[idx] == "native")
+				boolOpts.set(Option::NativeLexer);
+			else
+				FATAL("Unknown lexer: " << argv[idx] << '\n');
+		} else if (current == "--lines") {
+			ensureArg();
+
+			const std::string lines{argv[idx]};
+			const char *p = lines.c_str();
+			for (;;) {
+				char *parseEnd;
+				errno = 0;
+				const unsigned long first = strtoul(p, &parseEnd, 10);
+				unsigned long last = first;
+				if (parseEnd != p && *parseEnd == '-') {
+					p = parseEnd + 1;
+					last = strtoul(p, &parseEnd, 10);
+				}
+
+				if (parseEnd == p || errno == ERANGE || first == 0 || first > last || last > std::numeric_limits<unsigned>::max()
+					|| (*parseEnd != '\0' && *parseEnd != ','))
+					FATAL("Invalid line ranges passed: " << lines << '\n');
+
+				this->lineFilter.push_back(LineRange{unsigned(first), unsigned(last)});
+				if (*parseEnd == '\0')
+					break;
+				p = parseEnd + 1;
+			}
 		} else if (current == "--output" || current == "-o") {
 			if (boolOpts.get(Option::WriteToStdout))
 				FATAL("--output and --stdout are mutually exclusive\n");
 
 			ensureArg();
 			this->logOutput = argv[idx];
+		} else if (current == "--parse-jobs") {
+			ensureArg();
+			this->parseJobs = parseUnsigned(current, argv[idx], 1);
+		} else if (current == "--stdin-name") {
+			ensureArg();
+			this->stdinName = argv[idx];
 		} else if (current == "--stdout") {
 			if (!this->logOutput.empty())
 				FATAL("--output and --stdout are mutually exclusive\n");
@@ -101,7 +188,7 @@ void Config::parse(const std::vector <std::string_view> &argv)
 			if (current[0] == '-')
 				LOG(Logger::Pedantic, "Skipping unrecognized option: " << current << '\n');
 			else
-				this->inputFile = current;
+				this->inputFiles.emplace_back(current);
 		}
 
 		++idx;
@@ -114,14 +201,37 @@ void Config::parse(const std::vector <std::string_view> &argv)
 R"___(Lucy (a.k.a. Analua), a static analyzer for Lua code.
 
 Usage:
-  $ ./Lucy [options] [file]
+  $ ./Lucy [options] [file|directory...]
 
-If input file is not specified, read standard input.
+If no input is specified, read standard input. Directories are searched
+recursively for *.lua files. Multiple files are analyzed in parallel, messages
+are still reported in the order of input files.
 
 Options:
+  --cache-dir <dir>      keep parsed syntax trees in <dir>, unchanged files are
+                         not parsed again by later runs
+  --cache-size <MiB>     size limit of the --cache-dir directory, least recently
+                         used trees are removed at exit (default: 256)
+  --data-files <auto|always|never>
+                         check files holding only literal data (tables and
+                         values assigned to global names or returned) in one
+                         pass without building syntax trees, "auto" falls
+                         back to the full analysis for other files, "always"
+                         reports them as syntax errors (default: auto)
+  --files0-from <file>   read NUL-separated input file names from <file>,
+                         "-" reads them from standard input
   --graphviz <file>      write CFG description in dot language
   -h, --help             usage information (this text)
+  -j, --jobs <n>         number of files analyzed in parallel (default: number
+                         of available CPU cores)
+  --lazy-functions       parse function bodies only when they are analyzed
+  --lexer <flex|native>  lexer used for tokenizing input (default: flex)
+  --lines <ranges>       analyze only top-level functions overlapping the given
+                         lines, <ranges> is a comma-separated list of <n> or
+                         <first>-<last>
   --output <file>        write to file instead of stderr
+  --parse-jobs <n>       number of threads parsing parts of one large file
+                         (default: 1)
   --stdout               write to stdout instead of stderr
 
 Debugging and development options:
@@ -129,6 +239,19 @@ Debugging and development options:
   --dump-issues <file>   write all found issues to specified file (used for
                          automatic testing)
   --dump-ir              write intermediate representation code to stdout
+  --dump-ssa             write static single assignment form of the
+                         intermediate representation to stdout
+  --dump-tokens          write tokens of input to stdout instead of analyzing it
+  --edit-from <file>     parse <file> first and turn it into every input file by
+                         one incremental edit, fail if the edit needs a full
+                         parse (used for automatic testing)
+  --stdin-name <name>    read standard input into memory and analyze it as file
+                         <name> through the library interface for in-memory
+                         buffers, other input options do not apply (used for
+                         automatic testing)
+
+Options writing to stdout process input files one at a time, --graphviz
+accepts a single input file only.
 
 If command line is not available, you can pass options in LUCY_OPTIONS
 environment variable. Example:
@@ -1,20 +1,42 @@
 #pragma once
 
+#include <string>
 #include <string_view>
 #include <vector>
 
 #include "Bitfield.hpp"
 #include "EnumHelpers.hpp"
+#include "Location.hpp"
 
 struct Config {
+	std::string astCacheDir;
+	unsigned astCacheSize = 256; //MiB
+	std::string editFrom;
+	std::string fileListInput;
 	std::string graphvizOutput;
-	std::string inputFile;
+	std::vector <std::string> inputFiles;
 	std::string issuesOutput;
+	std::vector <LineRange> lineFilter;
 	std::string logOutput;
+	std::string stdinName;
+	unsigned jobs = 0;
+	unsigned parseJobs = 1;
+
+	EnumClass(DataFiles, unsigned,
+		Auto,
+		Always,
+		Never
+	);
+
+	DataFiles dataFiles = DataFiles::Auto;
 
 	EnumClass(Option, unsigned,
 		DumpAST,
 		DumpIR,
+		DumpSSA,
+		DumpTokens,
+		LazyFunctions,
+		NativeLexer,
 		WriteToStdout
 	);
 
@@ -1,21 +1,28 @@
 #include <fstream>
-#include <functional>
 #include <map>
 #include <queue>
 #include <unordered_map>
-#include <unordered_set>
 
 #include "AST.hpp"
 #include "BasicBlock.hpp"
 #include "ControlFlowGraph.hpp"
 #include "Fold.hpp"
 #include "Function.hpp"
+#include "SSA.hpp"
 #include "Scope.hpp"
 #include "Serial.hpp"
+#include "Visitor.hpp"
 
-struct ControlFlowGraph::CFGContext {
-	std::vector <std::pair <BasicBlock *, const AST::Break &> > breakBlocks;
-	std::vector <BasicBlock *> returnBlocks;
+/* walks the expressions of statements, collects functions and variable accesses of the current scope */
+struct ControlFlowGraph::CFGContext : AST::Visitor<CFGContext> {
+	CFGContext(ControlFlowGraph &cfg, Scope &scope)
+		: cfg{cfg}, currentScope{&scope}
+	{
+	}
+
+	ControlFlowGraph &cfg;
+	std::vector <std::pair <BlockId, const AST::Break &> > breakBlocks;
+	std::vector <BlockId> returnBlocks;
 	Scope *currentScope;
 
 	void popScope()
@@ -27,29 +34,104 @@ struct ControlFlowGraph::CFGContext {
 	{
 		currentScope = currentScope->push();
 	}
+
+	void declare(const AST::LValue &lval, const VarAccess *declaration)
+	{
+		if (declaration && lval.lvalueType() == AST::LValue::Type::Name)
+			cfg.m_declarations.emplace(&lval, declaration);
+	}
+
+	void visit(const AST::Assignment &assignment);
+	void visit(const AST::Function &fnNode);
+	void visit(const AST::LValue &lval);
+
+	template <typename T, std::enable_if_t<AST::isOneOf<T, AST::BinOp, AST::ConstTable, AST::Ellipsis, AST::ExprList, AST::Field, AST::FunctionCall, AST::MethodCall,
+		AST::NestedExpr, AST::TableCtor, AST::UnOp, AST::Value, AST::VarList>, int> = 0>
+	void visit(const T &node)
+	{
+		visitChildren(node);
+	}
+
+	/* statements are split into blocks by ChunkBuilder */
+	template <typename T, std::enable_if_t<AST::isOneOf<T, AST::Break, AST::Chunk, AST::For, AST::ForEach, AST::FunctionName, AST::If,
+		AST::ParamList, AST::Repeat, AST::Return, AST::While>, int> = 0>
+	void visit(const T &node)
+	{
+		unexpected(node);
+	}
+};
+
+/* appends the statements of a chunk to a chain of blocks from entry to current */
+class ControlFlowGraph::ChunkBuilder : public AST::Visitor<ChunkBuilder> {
+public:
+	ChunkBuilder(ControlFlowGraph &cfg, CFGContext &ctx)
+		: m_cfg{cfg}, m_ctx{ctx}
+	{
+		entry = current = makeBB();
+	}
+
+	bool enter(const AST::Node &insn)
+	{
+		if (block(current).exitType() == BasicBlock::ExitType::Fallthrough)
+			return true;
+
+		LOG(Logger::Error, insn.location() << " : dangling statements after block exit\n");
+		stop();
+		return false;
+	}
+
+	void visit(const AST::Assignment &assignmentNode);
+	void visit(const AST::Break &breakNode);
+	void visit(const AST::Chunk &subChunk);
+	void visit(const AST::For &forNode);
+	void visit(const AST::ForEach &forEachNode);
+	void visit(const AST::Function &fnNode);
+	void visit(const AST::FunctionCall &fnCallNode);
+	void visit(const AST::If &ifNode);
+	void visit(const AST::Repeat &repeatNode);
+	void visit(const AST::Return &returnNode);
+	void visit(const AST::While &whileNode);
+
+	/* expressions are walked by CFGContext as parts of statements */
+	template <typename T, std::enable_if_t<AST::isOneOf<T, AST::BinOp, AST::ConstTable, AST::Ellipsis, AST::ExprList, AST::Field, AST::FunctionName, AST::LValue,
+		AST::MethodCall, AST::NestedExpr, AST::ParamList, AST::TableCtor, AST::UnOp, AST::Value, AST::VarList>, int> = 0>
+	void visit(const T &node)
+	{
+		unexpected(node);
+	}
+
+	BlockId entry;
+	BlockId current;
+
+private:
+	/* blocks are addressed by id, references to them do not survive makeBB() */
+	BasicBlock & block(BlockId id) { return m_cfg.m_blocks[id]; }
+	BlockId makeBB();
+	void redirectBreaks(BlockId dst);
+
+	ControlFlowGraph &m_cfg;
+	CFGContext &m_ctx;
 };
 
 ControlFlowGraph::ControlFlowGraph(const AST::Chunk &chunk, Scope &scope)
 {
-	CFGContext ctx;
-	ctx.currentScope = &scope;
+	CFGContext ctx{*this, scope};
 	std::tie(m_entry, m_exit) = process(ctx, chunk);
 
 	for (const auto &brk : ctx.breakBlocks)
 		LOG(Logger::Error, brk.second.location() << " : no loop to break from\n");
 
-	if (!m_exit->isEmpty()) {
-		m_blocks.emplace_back(std::make_unique<BasicBlock>(m_blockSerial.next()));
-		auto commonExit = m_blocks.back().get();
-		commonExit->phase = m_walkPhase;
-		commonExit->scope = m_exit->scope;
+	if (!m_blocks[m_exit].isEmpty()) {
+		const BlockId commonExit = m_blocks.size();
+		m_blocks.emplace_back(m_blockSerial.next());
+		m_blocks[commonExit].scope = m_blocks[m_exit].scope;
 
-		m_exit->nextBlock[0] = commonExit;
+		m_blocks[m_exit].nextBlock[0] = commonExit;
 		m_exit = commonExit;
 	}
 
 	for (auto ret : ctx.returnBlocks)
-		ret->nextBlock[0] = m_exit;
+		m_blocks[ret].nextBlock[0] = m_exit;
 
 	calcPredecessors();
 	generateIR();
@@ -79,10 +161,15 @@ void ControlFlowGraph::irDump(unsigned indent, const char *label) const
 		label = "global scope";
 
 	Logger::indent(std::cout, indent) << '[' << label << "]\n";
-	for (unsigned i = 0; i != m_blocks.size(); ++i) {
-		m_blocks[i]->irDump(indent + 1);
-		if (i + 1 != m_blocks.size())
+	/* blocks split off others are dumped with them */
+	bool first = true;
+	for (BlockId id = 0; id != m_blocks.size(); ++id) {
+		if (m_blocks[id].attribute(BasicBlock::Attribute::SubBlock) || m_blocks[id].attribute(BasicBlock::Attribute::Pruned))
+			continue;
+		if (!first)
 			std::cout << '\n';
+		first = false;
+		BasicBlock::irDump(m_blocks, id, m_code, indent + 1);
 	}
 
 	if (!m_functions.empty())
@@ -97,27 +184,30 @@ void ControlFlowGraph::irDump(unsigned indent, const char *label) const
 	Logger::indent(std::cout, indent) << "[/" << label << "]\n";
 }
 
-std::pair <BasicBlock *, BasicBlock *> ControlFlowGraph::process(CFGContext &ctx, const AST::Chunk &chunk)
+void ControlFlowGraph::ssaDump(unsigned indent, const char *label) const
 {
-	auto makeBB = [this, &ctx]
-	{
-		m_blocks.emplace_back(std::make_unique<BasicBlock>(m_blockSerial.next()));
-		auto newBlock = m_blocks.back().get();
-		newBlock->phase = m_walkPhase;
-		newBlock->scope = ctx.currentScope;
-		return newBlock;
-	};
+	if (!label)
+		label = "global scope";
 
-	auto redirectBreaks = [this, &ctx](BasicBlock *dst)
-	{
-		for (const auto &brk : ctx.breakBlocks)
-			brk.first->nextBlock[0] = dst;
-		ctx.breakBlocks.clear();
-	};
+	Logger::indent(std::cout, indent) << '[' << label << "]\n";
+	SSA::Context{*this}.dump(std::cout, indent + 1);
+
+	if (!m_functions.empty())
+		std::cout << '\n';
+
+	for (unsigned i = 0; i != m_functions.size(); ++i) {
+		m_functions[i]->ssaDump(indent + 1);
+		if (i + 1 != m_functions.size())
+			std::cout << '\n';
+	}
+
+	Logger::indent(std::cout, indent) << "[/" << label << "]\n";
+}
 
+std::pair <BlockId, BlockId> ControlFlowGraph::process(CFGContext &ctx, const AST::Chunk &chunk, const AST::Node *condition)
+{
 	ctx.pushScope();
-	auto entry = makeBB();
-	auto current = entry;
+	ChunkBuilder builder{*this, ctx};
 
 	if (chunk.isEmpty()) {
 		if (ctx.currentScope->parent() == ctx.currentScope->functionScope())
@@ -126,403 +216,425 @@ std::pair <BasicBlock *, BasicBlock *> ControlFlowGraph::process(CFGContext &ctx
 			Logger::logIssue<Issue::EmptyChunk>(chunk.location());
 	}
 
-	for (const auto &insn : chunk.children()) {
-		if (current->exitType() != BasicBlock::ExitType::Fallthrough) {
-			LOG(Logger::Error, insn->location() << " : dangling statements after block exit\n");
-			break;
-		}
+	builder.visitChildren(chunk);
+	if (condition)
+		ctx.dispatch(*condition);
 
-		switch (insn->type().value()) {
-			case AST::Node::Type::Break: {
-				auto breakNode = static_cast<const AST::Break *>(insn.get());
-				current->setExitType(BasicBlock::ExitType::Break);
-				ctx.breakBlocks.emplace_back(current, *breakNode);
-				break;
-			}
-			case AST::Node::Type::Function: {
-				auto fnNode = static_cast<const AST::Function *>(insn.get());
-				process(ctx, *fnNode);
-				if (!fnNode->isAnonymous()) {
-					const auto &assignFn = rewrite(ctx, *fnNode);
-					current->insn.push_back(&assignFn);
-				} else {
-					current->insn.push_back(insn.get());
-				}
-				break;
-			}
-			case AST::Node::Type::Assignment: {
-				auto assignmentNode = static_cast<const AST::Assignment *>(insn.get());
-				process(ctx, *assignmentNode);
-				current->insn.push_back(insn.get());
-				break;
-			}
-			case AST::Node::Type::FunctionCall: {
-				auto prev = current;
-				current = makeBB();
-				prev->nextBlock[0] = current;
-
-				auto fnCallNode = static_cast<const AST::FunctionCall *>(insn.get());
-				process(ctx, *fnCallNode);
-				current->insn.push_back(insn.get());
-				break;
-			}
-			case AST::Node::Type::Chunk: {
-				auto subChunk = static_cast<const AST::Chunk *>(insn.get());
-				auto [entry, exit] = process(ctx, *subChunk);
-				current->nextBlock[0] = entry;
-				current = makeBB();
-				exit->nextBlock[0] = current;
-				break;
-			}
-			case AST::Node::Type::Return: {
-				auto returnNode = static_cast<const AST::Return *>(insn.get());
-				current->setExitType(BasicBlock::ExitType::Return);
-				ctx.returnBlocks.push_back(current);
-
-				if (!returnNode->empty()) {
-					current->returnExprList = &returnNode->exprList();
-					process(ctx, returnNode->exprList());
-				} else {
-					current->returnExprList = nullptr;
-				}
+	ctx.popScope();
+	return {builder.entry, builder.current};
+}
 
-				if (auto fn = ctx.currentScope->function(); fn)
-					fn->setResultCount(*returnNode);
+BlockId ControlFlowGraph::ChunkBuilder::makeBB()
+{
+	const BlockId newBlock = m_cfg.m_blocks.size();
+	m_cfg.m_blocks.emplace_back(m_cfg.m_blockSerial.next());
+	block(newBlock).scope = m_ctx.currentScope;
+	return newBlock;
+}
 
-				break;
-			}
-			case AST::Node::Type::If: {
-				auto ifNode = static_cast<const AST::If *>(insn.get());
-				const auto &cond = ifNode->conditions();
-				const auto &chunks = ifNode->chunks();
-				std::vector <BasicBlock *> exits;
-
-				BasicBlock *previous;
-				for (size_t i = 0; i < cond.size(); ++i) {
-					current->setExitType(BasicBlock::ExitType::Conditional);
-					current->condition = cond[i].get();
-
-					process(ctx, *cond[i]);
-					auto [entry, exit] = process(ctx, *chunks[i]);
-					exits.emplace_back(exit);
-
-					previous = current;
-					previous->nextBlock[0] = entry;
-
-					if (i + 1 < cond.size()) {
-						current = makeBB();
-						previous->nextBlock[1] = current;
-					}
-				}
+void ControlFlowGraph::ChunkBuilder::redirectBreaks(BlockId dst)
+{
+	for (const auto &brk : m_ctx.breakBlocks)
+		block(brk.first).nextBlock[0] = dst;
+	m_ctx.breakBlocks.clear();
+}
 
-				current = makeBB();
-				if (ifNode->hasElse()) {
-					auto [entry, exit] = process(ctx, ifNode->elseNode());
-					exits.emplace_back(exit);
-					previous->nextBlock[1] = entry;
-				} else {
-					previous->nextBlock[1] = current;
-				}
+void ControlFlowGraph::ChunkBuilder::visit(const AST::Assignment &assignmentNode)
+{
+	m_ctx.visit(assignmentNode);
+	block(current).insn.push_back(&assignmentNode);
+}
 
-				for (auto *exit : exits)
-					exit->nextBlock[0] = current;
-				break;
-			}
-			case AST::Node::Type::While: {
-				auto whileNode = static_cast<const AST::While *>(insn.get());
-				process(ctx, whileNode->condition());
-
-				auto previous = current;
-				current = makeBB();
-				current->setExitType(BasicBlock::ExitType::Conditional);
-				current->condition = &whileNode->condition();
-				previous->nextBlock[0] = current;
-				previous = current;
-
-				auto [entry, exit] = process(ctx, whileNode->chunk());
-				current = makeBB();
-
-				previous->nextBlock[0] = entry;
-				previous->nextBlock[1] = current;
-				exit->nextBlock[0] = previous;
-				exit->setLoopFooter(current);
-				redirectBreaks(current);
-				break;
-			}
-			case AST::Node::Type::Repeat: {
-				auto repeatNode = static_cast<const AST::Repeat *>(insn.get());
-				process(ctx, repeatNode->condition());
-
-				auto [entry, exit] = process(ctx, repeatNode->chunk());
-				current->nextBlock[0] = entry;
-
-				current = makeBB();
-				current->setExitType(BasicBlock::ExitType::Conditional);
-				current->condition = &repeatNode->condition();
-
-				auto helperBlock = makeBB();
-				current->nextBlock[1] = helperBlock;
-				helperBlock->nextBlock[0] = entry;
-				helperBlock->setAttribute(BasicBlock::Attribute::BackEdge);
-				exit->nextBlock[0] = current;
-
-				auto previous = current;
-				current = makeBB();
-				previous->nextBlock[0] = current;
-				helperBlock->setLoopFooter(current);
-				redirectBreaks(current);
-				break;
-			}
-			case AST::Node::Type::For: {
-				auto forNode = static_cast<const AST::For *>(insn.get());
-				auto assignmentNode = std::make_unique<AST::Assignment>(forNode->iterator(), forNode->startExpr().clone());
-				assignmentNode->setLocal(true);
-				current->insn.push_back(assignmentNode.get());
-				m_additionalNodes.emplace_back(std::move(assignmentNode));
-
-				auto previous = current;
-				current = makeBB();
-				previous->nextBlock[0] = current;
-
-				auto condition = forNode->cloneCondition();
-				current->setExitType(BasicBlock::ExitType::Conditional);
-				current->condition = condition.get();
-				m_additionalNodes.emplace_back(std::move(condition));
-
-				previous = current;
-				auto [entry, exit] = process(ctx, forNode->chunk());
-				previous->nextBlock[0] = entry;
-				exit->nextBlock[0] = previous;
-
-				auto step = forNode->cloneStepExpr();
-				exit->insn.push_back(step.get());
-				m_additionalNodes.emplace_back(std::move(step));
-
-				current = makeBB();
-				exit->setLoopFooter(current);
-				previous->nextBlock[1] = current;
-				redirectBreaks(current);
-				break;
-			}
-			case AST::Node::Type::ForEach: {
-				auto forEachNode = static_cast<const AST::ForEach *>(insn.get());
-				auto [entry, exit] = process(ctx, rewrite(ctx, *forEachNode));
-				current->nextBlock[0] = entry;
-				current = makeBB();
-				exit->nextBlock[0] = current;
-				redirectBreaks(current);
-				break;
-			}
-			default:
-				FATAL(insn->location() << " : Unhandled instruction type: " << insn->type() << '\n');
-		}
+void ControlFlowGraph::ChunkBuilder::visit(const AST::Break &breakNode)
+{
+	block(current).setExitType(BasicBlock::ExitType::Break);
+	m_ctx.breakBlocks.emplace_back(current, breakNode);
+}
+
+void ControlFlowGraph::ChunkBuilder::visit(const AST::Chunk &subChunk)
+{
+	auto [entry, exit] = m_cfg.process(m_ctx, subChunk);
+	block(current).nextBlock[0] = entry;
+	current = makeBB();
+	block(exit).nextBlock[0] = current;
+}
+
+void ControlFlowGraph::ChunkBuilder::visit(const AST::For &forNode)
+{
+	/* the iterator is a local of its own scope around the loop */
+	m_ctx.pushScope();
+
+	auto assignmentNode = std::make_unique<AST::Assignment>(forNode.iterator(), AST::borrow(forNode.startExpr()));
+	assignmentNode->setLocal(true);
+	m_ctx.visit(*assignmentNode);
+	block(current).insn.push_back(assignmentNode.get());
+	m_cfg.m_additionalNodes.emplace_back(std::move(assignmentNode));
+
+	auto previous = current;
+	current = makeBB();
+	block(previous).nextBlock[0] = current;
+
+	auto condition = forNode.desugarCondition();
+	m_ctx.dispatch(*condition);
+	block(current).setExitType(BasicBlock::ExitType::Conditional);
+	block(current).condition = condition.get();
+	m_cfg.m_additionalNodes.emplace_back(std::move(condition));
+
+	previous = current;
+	auto [entry, exit] = m_cfg.process(m_ctx, forNode.chunk());
+	block(previous).nextBlock[0] = entry;
+	block(exit).nextBlock[0] = previous;
+
+	auto step = forNode.desugarStep();
+	m_ctx.visit(*step);
+	block(exit).insn.push_back(step.get());
+	m_cfg.m_additionalNodes.emplace_back(std::move(step));
+
+	m_ctx.popScope();
+
+	current = makeBB();
+	BasicBlock::setLoopFooter(m_cfg.m_blocks, exit, current);
+	block(previous).nextBlock[1] = current;
+	redirectBreaks(current);
+}
+
+void ControlFlowGraph::ChunkBuilder::visit(const AST::ForEach &forEachNode)
+{
+	auto [entry, exit] = m_cfg.process(m_ctx, m_cfg.rewrite(m_ctx, forEachNode));
+	block(current).nextBlock[0] = entry;
+	current = makeBB();
+	block(exit).nextBlock[0] = current;
+	redirectBreaks(current);
+}
+
+void ControlFlowGraph::ChunkBuilder::visit(const AST::Function &fnNode)
+{
+	if (!fnNode.isAnonymous()) {
+		const auto &assignFn = m_cfg.rewrite(m_ctx, fnNode);
+		/*
+		 * only names are recorded, a global function is not reported as a
+		 * global store; a local one is in scope of its own body
+		 */
+		const AST::LValue &name = *assignFn.varList().vars().front();
+		if (assignFn.isLocal())
+			m_ctx.declare(name, m_ctx.currentScope->addLocalStore(name).declaration());
+		else if (name.lvalueType() == AST::LValue::Type::Name)
+			m_ctx.declare(name, m_ctx.currentScope->declaration(name));
+		m_ctx.visit(fnNode);
+		block(current).insn.push_back(&assignFn);
+	} else {
+		m_ctx.visit(fnNode);
+		block(current).insn.push_back(&fnNode);
 	}
+}
 
-	ctx.popScope();
-	return {entry, current};
+void ControlFlowGraph::ChunkBuilder::visit(const AST::FunctionCall &fnCallNode)
+{
+	auto prev = current;
+	current = makeBB();
+	block(prev).nextBlock[0] = current;
+
+	m_ctx.visit(fnCallNode);
+	block(current).insn.push_back(&fnCallNode);
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::Assignment &assignment)
+void ControlFlowGraph::ChunkBuilder::visit(const AST::If &ifNode)
 {
-	process(ctx, assignment.exprList());
+	const auto &cond = ifNode.conditions();
+	const auto &chunks = ifNode.chunks();
+	std::vector <BlockId> exits;
 
-	for (const auto &lval : assignment.varList().vars()) {
-		if (lval->lvalueType() != AST::LValue::Type::Name)
-			process(ctx, *lval);
+	BlockId previous = current;
+	for (size_t i = 0; i < cond.size(); ++i) {
+		block(current).setExitType(BasicBlock::ExitType::Conditional);
+		block(current).condition = cond[i].get();
+
+		m_ctx.dispatch(*cond[i]);
+		auto [entry, exit] = m_cfg.process(m_ctx, *chunks[i]);
+		exits.emplace_back(exit);
+
+		previous = current;
+		block(previous).nextBlock[0] = entry;
+
+		if (i + 1 < cond.size()) {
+			current = makeBB();
+			block(previous).nextBlock[1] = current;
+		}
 	}
 
-	if (assignment.isLocal()) {
-		for (const auto &lval : assignment.varList().vars())
-			ctx.currentScope->addLocalStore(*lval);
+	current = makeBB();
+	if (ifNode.hasElse()) {
+		auto [entry, exit] = m_cfg.process(m_ctx, ifNode.elseNode());
+		exits.emplace_back(exit);
+		block(previous).nextBlock[1] = entry;
 	} else {
-		for (const auto &lval : assignment.varList().vars())
-			ctx.currentScope->addVarAccess(*lval, VarAccess::Type::Write);
+		block(previous).nextBlock[1] = current;
 	}
+
+	for (auto exit : exits)
+		block(exit).nextBlock[0] = current;
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::ExprList &exprList)
+void ControlFlowGraph::ChunkBuilder::visit(const AST::Repeat &repeatNode)
 {
-	for (const auto &e : exprList.exprs())
-		process(ctx, *e);
+	auto [entry, exit] = m_cfg.process(m_ctx, repeatNode.chunk(), &repeatNode.condition());
+	block(current).nextBlock[0] = entry;
+
+	current = makeBB();
+	block(current).setExitType(BasicBlock::ExitType::Conditional);
+	block(current).condition = &repeatNode.condition();
+
+	auto helperBlock = makeBB();
+	block(current).nextBlock[1] = helperBlock;
+	block(helperBlock).nextBlock[0] = entry;
+	block(helperBlock).setAttribute(BasicBlock::Attribute::BackEdge);
+	block(exit).nextBlock[0] = current;
+
+	auto previous = current;
+	current = makeBB();
+	block(previous).nextBlock[0] = current;
+	BasicBlock::setLoopFooter(m_cfg.m_blocks, helperBlock, current);
+	redirectBreaks(current);
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::Field &field)
+void ControlFlowGraph::ChunkBuilder::visit(const AST::Return &returnNode)
 {
-	if (field.fieldType() == AST::Field::Type::Brackets)
-		process(ctx, field.keyExpr());
-	process(ctx, field.valueExpr());
+	block(current).setExitType(BasicBlock::ExitType::Return);
+	m_ctx.returnBlocks.push_back(current);
+
+	if (!returnNode.empty()) {
+		block(current).returnExprList = &returnNode.exprList();
+		m_ctx.visit(returnNode.exprList());
+	} else {
+		block(current).returnExprList = nullptr;
+	}
+
+	if (auto fn = m_ctx.currentScope->function(); fn)
+		fn->setResultCount(returnNode);
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::Function &fnNode)
+void ControlFlowGraph::ChunkBuilder::visit(const AST::While &whileNode)
 {
-	m_functions.emplace_back(std::make_unique<Function>(fnNode, *ctx.currentScope));
+	m_ctx.dispatch(whileNode.condition());
+
+	auto previous = current;
+	current = makeBB();
+	block(current).setExitType(BasicBlock::ExitType::Conditional);
+	block(current).condition = &whileNode.condition();
+	block(previous).nextBlock[0] = current;
+	previous = current;
+
+	auto [entry, exit] = m_cfg.process(m_ctx, whileNode.chunk());
+	current = makeBB();
+
+	block(previous).nextBlock[0] = entry;
+	block(previous).nextBlock[1] = current;
+	block(exit).nextBlock[0] = previous;
+	BasicBlock::setLoopFooter(m_cfg.m_blocks, exit, current);
+	redirectBreaks(current);
+}
+
+void ControlFlowGraph::CFGContext::visit(const AST::Assignment &assignment)
+{
+	visit(assignment.exprList());
+
+	for (const auto &lval : assignment.varList().vars()) {
+		if (lval->lvalueType() != AST::LValue::Type::Name)
+			visit(*lval);
+	}
+
+	if (assignment.isLocal()) {
+		for (const auto &lval : assignment.varList().vars())
+			declare(*lval, currentScope->addLocalStore(*lval).declaration());
+	} else {
+		for (const auto &lval : assignment.varList().vars())
+			declare(*lval, currentScope->addVarAccess(*lval, VarAccess::Type::Write).declaration());
+	}
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::FunctionCall &fnCallNode)
+void ControlFlowGraph::CFGContext::visit(const AST::Function &fnNode)
 {
-	process(ctx, fnCallNode.functionExpr());
-	process(ctx, fnCallNode.args());
+	cfg.m_functions.emplace_back(std::make_unique<Function>(fnNode, *currentScope));
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::LValue &lval)
+void ControlFlowGraph::CFGContext::visit(const AST::LValue &lval)
 {
 	switch (lval.lvalueType()) {
 		case AST::LValue::Type::Name:
-			ctx.currentScope->addVarAccess(lval, VarAccess::Type::Read);
+			declare(lval, currentScope->addVarAccess(lval, VarAccess::Type::Read).declaration());
 			break;
 		case AST::LValue::Type::Bracket:
-			process(ctx, lval.keyExpr());
+			dispatch(lval.keyExpr());
 			[[fallthrough]];
 		case AST::LValue::Type::Dot:
-			process(ctx, lval.tableExpr());
+			dispatch(lval.tableExpr());
 			break;
 	}
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::Node &node)
+const VarAccess * ControlFlowGraph::declaration(const AST::LValue &var) const
 {
-	if (node.isValue() || node.type() == AST::Node::Type::Ellipsis)
-		return;
+	auto it = m_declarations.find(&var);
+	return it != m_declarations.end() ? it->second : nullptr;
+}
 
-	switch (node.type().value()) {
-		case AST::Node::Type::Function:
-			process(ctx, static_cast<const AST::Function &>(node));
-			break;
-		case AST::Node::Type::FunctionCall:
-		case AST::Node::Type::MethodCall:
-			process(ctx, static_cast<const AST::FunctionCall &>(node));
-			break;
-		case AST::Node::Type::TableCtor:
-			process(ctx, static_cast<const AST::TableCtor &>(node));
-			break;
-		case AST::Node::Type::NestedExpr:
-			process(ctx, static_cast<const AST::NestedExpr &>(node).expr());
-			break;
-		case AST::Node::Type::LValue:
-			process(ctx, static_cast<const AST::LValue &>(node));
-			break;
-		case AST::Node::Type::BinOp: {
-			const AST::BinOp &boNode = static_cast<const AST::BinOp &>(node);
-			process(ctx, boNode.left());
-			process(ctx, boNode.right());
-			break;
-		}
-		case AST::Node::Type::UnOp: {
-			process(ctx, static_cast<const AST::UnOp &>(node).operand());
-			break;
-		}
-		default:
-			FATAL(node.location() << " : Unhandled node type: " << node.type() << '\n');
-	}
+const std::vector <BlockId> & ControlFlowGraph::preorder() const
+{
+	calcOrder();
+	return m_order.preorder;
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::TableCtor &table)
+const std::vector <BlockId> & ControlFlowGraph::postorder() const
 {
-	for (const auto &f : table.fields())
-		process(ctx, *f);
+	calcOrder();
+	return m_order.postorder;
 }
 
-void ControlFlowGraph::process(CFGContext &ctx, const AST::VarList &varList)
+const std::vector <BlockId> & ControlFlowGraph::reversePostorder() const
 {
-	for (const auto &v : varList.vars())
-		process(ctx, *v);
+	calcOrder();
+	return m_order.reversePostorder;
 }
 
-void ControlFlowGraph::calcPredecessors()
+uint32_t ControlFlowGraph::preorderNumber(BlockId id) const
 {
-	++m_walkPhase;
+	calcOrder();
+	return m_order.preorderNumber[id];
+}
 
-	std::function <void (BasicBlock *)> doCalcPredecessors = [this, &doCalcPredecessors](BasicBlock *block)
-	{
-		if (block->phase == m_walkPhase)
-			return;
-		block->phase = m_walkPhase;
-
-		for (BasicBlock *next : block->nextBlock) {
-			if (next) {
-				next->predecessors.push_back(block);
-				doCalcPredecessors(next);
-			}
-		}
-	};
+uint32_t ControlFlowGraph::postorderNumber(BlockId id) const
+{
+	calcOrder();
+	return m_order.postorderNumber[id];
+}
 
-	doCalcPredecessors(m_entry);
+uint32_t ControlFlowGraph::rpoNumber(BlockId id) const
+{
+	calcOrder();
+	const uint32_t post = m_order.postorderNumber[id];
+	return post == NoOrder ? NoOrder : m_order.postorder.size() - 1 - post;
 }
 
-void ControlFlowGraph::generateIR()
+void ControlFlowGraph::calcOrder() const
 {
-	++m_walkPhase;
+	if (m_order.valid)
+		return;
 
-	std::function <void (BasicBlock *)> doGenerateIR = [this, &doGenerateIR](BasicBlock *block)
+	m_order.preorder.clear();
+	m_order.postorder.clear();
+	m_order.preorderNumber.assign(m_blocks.size(), NoOrder);
+	m_order.postorderNumber.assign(m_blocks.size(), NoOrder);
+
+	/*
+	 * Iterative depth-first search, so deep graphs (long elseif chains) do
+	 * not exhaust the call stack. Every entry of the stack is a block and
+	 * the index of its next edge to follow, which visits blocks in the same
+	 * order as the recursive walk would.
+	 */
+	std::vector <std::pair <BlockId, unsigned> > stack;
+	auto enter = [this, &stack](BlockId id)
 	{
-		if (!block || block->phase == m_walkPhase)
-			return;
-		block->phase = m_walkPhase;
-
-		block->generateIR();
-		for (BasicBlock *next : block->nextBlock)
-			doGenerateIR(next);
+		m_order.preorderNumber[id] = m_order.preorder.size();
+		m_order.preorder.push_back(id);
+		stack.emplace_back(id, 0);
 	};
 
-	doGenerateIR(m_entry);
+	enter(m_entry);
+	while (!stack.empty()) {
+		auto &[id, edge] = stack.back();
+		if (edge == 2) {
+			m_order.postorderNumber[id] = m_order.postorder.size();
+			m_order.postorder.push_back(id);
+			stack.pop_back();
+			continue;
+		}
+
+		const BlockId next = m_blocks[id].nextBlock[edge++];
+		if (next != BasicBlock::NoBlock && m_order.preorderNumber[next] == NoOrder)
+			enter(next);
+	}
+
+	m_order.reversePostorder.assign(m_order.postorder.rbegin(), m_order.postorder.rend());
+	m_order.valid = true;
 }
 
-void ControlFlowGraph::prune()
+void ControlFlowGraph::invalidateOrder()
 {
-	++m_walkPhase;
+	m_order.valid = false;
+}
 
-	auto canPrune = [this](const BasicBlock *block)
+void ControlFlowGraph::calcPredecessors()
+{
+	for (BlockId id : preorder()) {
+		for (BlockId next : m_blocks[id].nextBlock) {
+			if (next != BasicBlock::NoBlock)
+				m_blocks[next].predecessors.push_back(id);
+		}
+	}
+}
+
+void ControlFlowGraph::generateIR()
+{
+	/*
+	 * Blocks split off others while generating their IR are filled right
+	 * away, so the walk goes over the blocks of the graph as it was before.
+	 */
+	const std::vector <BlockId> blocks = preorder();
+	for (BlockId id : blocks)
+		BasicBlock::generateIR(m_blocks, id, m_code);
+
+	invalidateOrder();
+}
+
+void ControlFlowGraph::prune()
+{
+	auto canPrune = [this](BlockId id)
 	{
-		return block && block != m_exit && block != m_entry && block->canPrune();
+		return id != BasicBlock::NoBlock && id != m_exit && id != m_entry && m_blocks[id].canPrune();
 	};
 
-	std::function <void (BasicBlock *)> doPrune = [this, &canPrune, &doPrune](BasicBlock *block)
-	{
-		if (!block || block->phase == m_walkPhase)
-			return;
-		block->phase = m_walkPhase;
+	/* bypassing prunable blocks does not change which of the others are reachable */
+	for (BlockId id : preorder()) {
+		if (canPrune(id))
+			continue;
 
 		for (unsigned int i = 0; i < 2; ++i) {
-			BasicBlock *next = block->nextBlock[i];
+			BlockId next = m_blocks[id].nextBlock[i];
 			while (canPrune(next)) {
-				assert(!next->nextBlock[1]);
+				BasicBlock &nextBlock = m_blocks[next];
+				assert(nextBlock.nextBlock[1] == BasicBlock::NoBlock);
 
-				BasicBlock *subNext = next->nextBlock[0];
+				BlockId subNext = nextBlock.nextBlock[0];
 
-				for (auto p : next->predecessors) {
+				for (auto p : nextBlock.predecessors) {
 					for (unsigned i = 0; i < 2; ++i) {
-						if (p->nextBlock[i] == next)
-							p->nextBlock[i] = subNext;
+						if (m_blocks[p].nextBlock[i] == next)
+							m_blocks[p].nextBlock[i] = subNext;
 					}
 				}
 
-				if (subNext) {
-					subNext->removePredecessor(next);
-					std::copy(next->predecessors.begin(), next->predecessors.end(), std::back_inserter(subNext->predecessors));
+				if (subNext != BasicBlock::NoBlock) {
+					m_blocks[subNext].removePredecessor(next);
+					for (auto p : nextBlock.predecessors)
+						m_blocks[subNext].predecessors.push_back(p);
 				}
-				next->nextBlock[0] = nullptr;
-				next->predecessors.clear();
+				nextBlock.nextBlock[0] = BasicBlock::NoBlock;
+				nextBlock.predecessors.clear();
 				next = subNext;
 			}
-
-			doPrune(block->nextBlock[i]);
 		}
-	};
+	}
 
-	doPrune(m_entry);
+	invalidateOrder();
 
-	size_t idx = 0;
-	while (idx < m_blocks.size()) {
-		if (canPrune(m_blocks[idx].get())) {
-			m_blocks[idx] = std::move(m_blocks.back());
-			m_blocks.pop_back();
-		} else {
-			++idx;
-		}
+	/* pruned blocks stay in place so ids remain valid, blocks split off others are never pruned */
+	for (BlockId id = 0; id != m_blocks.size(); ++id) {
+		if (!m_blocks[id].attribute(BasicBlock::Attribute::SubBlock) && canPrune(id))
+			m_blocks[id].setAttribute(BasicBlock::Attribute::Pruned);
 	}
 }
 
-const AST::Chunk & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::ForEach &forEach)
+const AST::Chunk & ControlFlowGraph::rewrite(CFGContext &, const AST::ForEach &forEach)
 {
 	const char IteratorFn[] = "__f";
 	const char InvariantState[] = "__s";
@@ -533,7 +645,7 @@ const AST::Chunk & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::ForEach
 	{
 		auto initAssignment = std::make_unique<AST::Assignment>(
 			std::make_unique<AST::VarList>(std::initializer_list<const char *>{IteratorFn, InvariantState, ControlVar}),
-			forEach.cloneExprList()
+			AST::borrow(forEach.exprList())
 		);
 		initAssignment->setLocal(true);
 		node->append(std::move(initAssignment));
@@ -548,7 +660,7 @@ const AST::Chunk & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::ForEach
 		auto loopExprList = std::make_unique<AST::ExprList>();
 		loopExprList->append(std::make_unique<AST::FunctionCall>(std::make_unique<AST::LValue>(IteratorFn), std::move(iteratorFnArgs)));
 
-		auto loopAssignment = std::make_unique<AST::Assignment>(forEach.cloneVariables(), std::move(loopExprList));
+		auto loopAssignment = std::make_unique<AST::Assignment>(AST::borrow(forEach.variables()), std::move(loopExprList));
 		loopAssignment->setLocal(true);
 		loopChunk->append(std::move(loopAssignment));
 		loopChunk->append(std::make_unique<AST::Assignment>(ControlVar, forEach.variables().names()[0].first));
@@ -568,7 +680,7 @@ const AST::Chunk & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::ForEach
 			std::move(endLoopChunk)
 		);
 		loopChunk->append(std::move(endLoopCondition));
-		loopChunk->append(forEach.cloneChunk());
+		loopChunk->append(AST::borrow(forEach.chunk()));
 	}
 
 	node->append(std::make_unique<AST::While>(std::make_unique<AST::BooleanValue>(true), std::move(loopChunk)));
@@ -577,23 +689,20 @@ const AST::Chunk & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::ForEach
 	return *result;
 }
 
-const AST::Assignment & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::Function &fnNode)
+const AST::Assignment & ControlFlowGraph::rewrite(CFGContext &, const AST::Function &fnNode)
 {
 	assert(!fnNode.isAnonymous());
 
 	const auto &fnName = fnNode.name();
 	const auto &nameParts = fnName.nameParts();
-	auto nameLval = std::make_unique<AST::LValue>(nameParts[0]);
+	auto nameLval = std::make_unique<AST::LValue>(nameParts[0], fnName.location());
 
 	for (unsigned i = 1; i != nameParts.size(); ++i)
 		nameLval = std::make_unique<AST::LValue>(std::move(nameLval), nameParts[i]);
 	if (fnName.isMethod())
 		nameLval = std::make_unique<AST::LValue>(std::move(nameLval), fnName.method());
 
-	auto anonymizedFn = fnNode.clone<AST::Function>();
-	anonymizedFn->clearName();
-
-	auto node = std::make_unique<AST::Assignment>(std::move(nameLval), std::move(anonymizedFn));
+	auto node = std::make_unique<AST::Assignment>(std::move(nameLval), AST::borrow(fnNode));
 	if (fnNode.isLocal())
 		node->setLocal(true);
 
@@ -602,9 +711,9 @@ const AST::Assignment & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::Fu
 	return *result;
 }
 
-const AST::FunctionCall & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::MethodCall &callNode)
+const AST::FunctionCall & ControlFlowGraph::rewrite(CFGContext &, const AST::MethodCall &callNode)
 {
-	auto node = callNode.cloneAsFunctionCall();
+	auto node = callNode.desugar();
 	auto result = node.get();
 	m_additionalNodes.emplace_back(std::move(node));
 	return *result;
@@ -613,24 +722,22 @@ const AST::FunctionCall & ControlFlowGraph::rewrite(CFGContext &ctx, const AST::
 void ControlFlowGraph::graphvizDump(std::ostream &os) const
 {
 	const std::string CFGPrefix = "CFG_" + std::to_string(reinterpret_cast<uintptr_t>(this)) + '_';
-	auto uniqueLabel = [&CFGPrefix](auto &&block) -> std::string
+	auto uniqueLabel = [this, &CFGPrefix](BlockId id) -> std::string
 	{
-		return CFGPrefix + block->label();
+		return CFGPrefix + BasicBlock::label(m_blocks, id);
 	};
 
-	std::unordered_set <const BasicBlock *> visited;
-
-	std::function <void (const BasicBlock *)> printGraph = [this, &os, &printGraph, &uniqueLabel, &visited](const BasicBlock *bb)
-	{
-		if (!bb || !visited.insert(bb).second)
-			return;
+	for (BlockId id : preorder()) {
+		const BasicBlock *bb = &m_blocks[id];
 
-		os << '\t' << uniqueLabel(bb) << " [shape=box";
+		os << '\t' << uniqueLabel(id) << " [shape=box";
 		if (!bb->isEmpty()) {
 			os << ",label=<<table border=\"0\" cellborder=\"0\" cellspacing=\"0\"><tr><td align=\"left\">//"
-				<< bb->label() << " [" << bb->exitType() << "]</td></tr><hr/>";
-			for (const auto &i : bb->irCode) {
-				os << "<tr><td align=\"left\">" << *i << "</td></tr>";
+				<< BasicBlock::label(m_blocks, id) << " [" << bb->exitType() << "]</td></tr><hr/>";
+			for (uint32_t idx = bb->irCode.first; idx != bb->irCode.end(); ++idx) {
+				os << "<tr><td align=\"left\">";
+				m_code.print(os, idx);
+				os << "</td></tr>";
 			}
 
 			switch (bb->exitType().value()) {
@@ -657,29 +764,26 @@ void ControlFlowGraph::graphvizDump(std::ostream &os) const
 
 		if (bb->exitType() == BasicBlock::ExitType::Conditional) {
 			auto [trueBlock, falseBlock] = std::make_tuple(bb->nextBlock[0], bb->nextBlock[1]);
-			os << '\t' << uniqueLabel(bb) << " -> " << uniqueLabel(trueBlock) << " [label=\"true\",labelangle=45];\n";
-			os << '\t' << uniqueLabel(bb) << " -> " << uniqueLabel(falseBlock) << " [label=\"false\",labeldistance=2.0];\n";
+			os << '\t' << uniqueLabel(id) << " -> " << uniqueLabel(trueBlock) << " [label=\"true\",labelangle=45];\n";
+			os << '\t' << uniqueLabel(id) << " -> " << uniqueLabel(falseBlock) << " [label=\"false\",labeldistance=2.0];\n";
 		} else {
-			assert(!bb->nextBlock[1]);
-			if (auto next = bb->nextBlock[0]; next) {
-				os << '\t' << uniqueLabel(bb) << " -> " << uniqueLabel(next);
+			assert(bb->nextBlock[1] == BasicBlock::NoBlock);
+			if (auto next = bb->nextBlock[0]; next != BasicBlock::NoBlock) {
+				os << '\t' << uniqueLabel(id) << " -> " << uniqueLabel(next);
 				if (bb->attribute(BasicBlock::Attribute::BackEdge)) {
-					assert(bb->loopFooter());
+					assert(bb->loopFooter() != BasicBlock::NoBlock);
 					os << " [color=blue];\n";
-					os << '\t' << uniqueLabel(bb) << " -> " << uniqueLabel(bb->loopFooter()) << " [style=dashed,color=blue]";
+					os << '\t' << uniqueLabel(id) << " -> " << uniqueLabel(bb->loopFooter()) << " [style=dashed,color=blue]";
 				}
 				os << ";\n";
 			}
 		}
 
 		os << '\n';
+	}
 
-		for (const auto &next : bb->nextBlock)
-			printGraph(next);
-	};
-
-	printGraph(m_entry);
-
-	for (const auto &f : m_functions)
-		f->cfg().graphvizDump(os);
+	for (const auto &f : m_functions) {
+		if (f->isAnalyzed())
+			f->cfg().graphvizDump(os);
+	}
 }
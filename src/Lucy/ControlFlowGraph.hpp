@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "AST_fwd.hpp"
@@ -8,6 +10,7 @@
 #include "Serial.hpp"
 
 class Function;
+class VarAccess;
 
 class ControlFlowGraph {
 public:
@@ -17,25 +20,44 @@ public:
 	void operator = (const ControlFlowGraph &) = delete;
 	~ControlFlowGraph();
 
-	const BasicBlock * entry() const { return m_entry; }
-	const BasicBlock * exit() const { return m_exit; }
+	const BasicBlock & block(BlockId id) const { return m_blocks[id]; }
+	uint32_t blockCount() const { return m_blocks.size(); }
+	const IR::Code & code() const { return m_code; }
+	std::string label(BlockId id) const { return BasicBlock::label(m_blocks, id); }
+	/* local store declaring the variable named by var, nullptr for globals and function parameters */
+	const VarAccess * declaration(const AST::LValue &var) const;
+	BlockId entry() const { return m_entry; }
+	BlockId exit() const { return m_exit; }
 	void graphvizDump(const char *filename) const;
 	void graphvizDump(const std::string &filename) const { graphvizDump(filename.c_str()); }
 	void irDump(unsigned indent = 0, const char *label = nullptr) const;
+	/* builds the SSA form of this graph and of the graphs of its functions to dump it */
+	void ssaDump(unsigned indent = 0, const char *label = nullptr) const;
+
+	/*
+	 * Depth-first orders of the blocks reachable from the entry, nextBlock[0]
+	 * is followed before nextBlock[1]. They are computed on first use and kept
+	 * until the graph changes.
+	 */
+	static constexpr uint32_t NoOrder = UINT32_MAX;
+	const std::vector <BlockId> & preorder() const;
+	const std::vector <BlockId> & postorder() const;
+	const std::vector <BlockId> & reversePostorder() const;
+	/* position of a block in the orders above, NoOrder if it is not reachable */
+	uint32_t preorderNumber(BlockId id) const;
+	uint32_t postorderNumber(BlockId id) const;
+	uint32_t rpoNumber(BlockId id) const;
 
 private:
 	class CFGContext;
+	class ChunkBuilder;
+
+	/* condition is walked in the scope of the chunk, as the one of repeat sees its locals */
+	std::pair <BlockId, BlockId> process(CFGContext &ctx, const AST::Chunk &chunk, const AST::Node *condition = nullptr);
 
-	std::pair <BasicBlock *, BasicBlock *> process(CFGContext &ctx, const AST::Chunk &chunk);
-	void process(CFGContext &ctx, const AST::Assignment &assignment);
-	void process(CFGContext &ctx, const AST::ExprList &exprList);
-	void process(CFGContext &ctx, const AST::Field &field);
-	void process(CFGContext &ctx, const AST::Function &fnNode);
-	void process(CFGContext &ctx, const AST::FunctionCall &fnCallNode);
-	void process(CFGContext &ctx, const AST::LValue &lval);
-	void process(CFGContext &ctx, const AST::Node &node);
-	void process(CFGContext &ctx, const AST::TableCtor &table);
-	void process(CFGContext &ctx, const AST::VarList &varList);
+	void calcOrder() const;
+	/* to be called by everything changing the edges of the graph */
+	void invalidateOrder();
 
 	void calcPredecessors();
 	void generateIR();
@@ -47,10 +69,22 @@ private:
 	const AST::FunctionCall & rewrite(CFGContext &ctx, const AST::MethodCall &callNode);
 
 	Serial m_blockSerial;
-	std::vector <std::unique_ptr <BasicBlock> > m_blocks;
+	IR::Code m_code;
+	/* blocks split off others are appended while the IR is generated, pruned blocks are only marked */
+	std::vector <BasicBlock> m_blocks;
 	std::vector <std::unique_ptr <const AST::Node> > m_additionalNodes;
-	BasicBlock *m_entry, *m_exit;
-	unsigned m_walkPhase = 0;
+	std::unordered_map <const AST::LValue *, const VarAccess *> m_declarations;
+	BlockId m_entry, m_exit;
+
+	struct Order {
+		bool valid = false;
+		std::vector <BlockId> preorder;
+		std::vector <BlockId> postorder;
+		std::vector <BlockId> reversePostorder;
+		std::vector <uint32_t> preorderNumber;
+		std::vector <uint32_t> postorderNumber;
+	};
+	mutable Order m_order;
 
 	std::vector <std::unique_ptr <Function> > m_functions;
 };
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <sstream>
+#include <variant>
+
+#include "AnalysisSession.hpp"
+#include "DataValidator.hpp"
+#include "Driver.hpp"
+#include "Logger.hpp"
+#include "Scope.hpp"
+
+DataValidator::Result DataValidator::validate()
+{
+	/*
+	 * Issues are collected in a helper session and reported only once the
+	 * input turns out to be valid data, otherwise the parser reports them.
+	 */
+	m_driver.prepareInput();
+
+	auto &parent = AnalysisSession::current();
+	AnalysisSession session{parent};
+	std::ostringstream log;
+	session.setOutput(log);
+	for (uint32_t i = 0; i != Issue::Type::_size; ++i)
+		session.disable(Issue::Type{i});
+
+	const int status = session.run([this]
+	{
+		next();
+		if (!chunk() && m_result == Result::Valid)
+			m_result = Result::Invalid;
+		return 0;
+	});
+
+	//the lexer gave up on the input, as it would in the parser
+	if (status != 0) {
+		Logger::log() << log.str();
+		Logger::abort();
+	}
+
+	/* the full analysis resolves names before it builds the IR, stores to globals come first */
+	if (m_result == Result::Valid) {
+		auto issues = session.takeIssues();
+		std::stable_partition(issues.begin(), issues.end(), [](const IssueVariant &issue)
+		{
+			return std::holds_alternative<Issue::GlobalStore::FunctionScope>(issue)
+				|| std::holds_alternative<Issue::GlobalStore::GlobalScope>(issue)
+				|| std::holds_alternative<Issue::GlobalStore::Underscore>(issue)
+				|| std::holds_alternative<Issue::GlobalStore::UpperCase>(issue);
+		});
+
+		for (const auto &issue : issues)
+			std::visit([](const auto &issue) { Logger::logIssue<std::decay_t<decltype(issue)>>(issue); }, issue);
+	}
+
+	/* syntax errors are reported by the parser as in the other modes, valid code that is no data by the validator */
+	if (m_result == Result::Invalid && m_driver.parse() == 0)
+		m_driver.logError(m_error);
+
+	return m_result;
+}
+
+bool DataValidator::chunk()
+{
+	//empty input is no data, the parser reports it
+	if (kind() == Kind::S_YYEOF) {
+		m_result = Result::NotData;
+		return false;
+	}
+
+	while (kind() == Kind::S_ID) {
+		if (!assignment())
+			return false;
+		if (kind() == Kind::S_SEMICOLON)
+			next();
+	}
+
+	if (kind() == Kind::S_RETURN) {
+		next();
+		if (kind() != Kind::S_YYEOF && kind() != Kind::S_SEMICOLON) {
+			if (!value(0))
+				return false;
+
+			while (kind() == Kind::S_COMMA) {
+				next();
+				if (!value(0))
+					return false;
+			}
+		}
+
+		if (kind() == Kind::S_SEMICOLON)
+			next();
+	}
+
+	if (kind() != Kind::S_YYEOF)
+		return unexpected();
+	return true;
+}
+
+bool DataValidator::assignment()
+{
+	const SymbolId name = m_token->value.as<SymbolId>();
+	const Location begin = m_token->location;
+
+	next();
+	while (kind() == Kind::S_DOT) {
+		next();
+		if (kind() != Kind::S_ID)
+			return unexpected();
+		next();
+	}
+
+	//as in Scope, the first store to a name is reported, a field store counts as a store to its table
+	bool &stored = m_globals[name];
+	if (!stored) {
+		stored = true;
+		Scope::logGlobalStore(name, Location{begin.file, begin.begin, m_lastEnd}, false);
+	}
+
+	if (kind() != Kind::S_ASSIGN)
+		return unexpected();
+	next();
+
+	return value(0);
+}
+
+bool DataValidator::value(unsigned depth)
+{
+	switch (kind()) {
+		case Kind::S_NIL:
+		case Kind::S_TRUE:
+		case Kind::S_FALSE:
+		case Kind::S_INT_VALUE:
+		case Kind::S_REAL_VALUE:
+		case Kind::S_STRING_VALUE:
+			next();
+			return true;
+		case Kind::S_MINUS: {
+			Number ignored;
+			return number(ignored);
+		}
+		case Kind::S_LBRACE:
+			return table(depth);
+		default:
+			return unexpected();
+	}
+}
+
+bool DataValidator::table(unsigned depth)
+{
+	if (m_tables.size() == depth)
+		m_tables.emplace_back();
+	m_tables[depth].clear();
+
+	next();
+	while (kind() != Kind::S_RBRACE) {
+		const Location begin = m_token->location;
+
+		enum class Key {
+			None,
+			Name,
+			String,
+			Number,
+			Boolean,
+		} key = Key::None;
+		SymbolId name;
+		std::string_view string;
+		Number number;
+		bool boolean = false;
+
+		if (kind() == Kind::S_LBRACKET) {
+			next();
+			switch (kind()) {
+				case Kind::S_STRING_VALUE:
+					key = Key::String;
+					string = m_token->value.as<std::string_view>();
+					next();
+					break;
+				case Kind::S_TRUE:
+				case Kind::S_FALSE:
+					key = Key::Boolean;
+					boolean = kind() == Kind::S_TRUE;
+					next();
+					break;
+				case Kind::S_INT_VALUE:
+				case Kind::S_REAL_VALUE:
+				case Kind::S_MINUS:
+					key = Key::Number;
+					if (!this->number(number))
+						return false;
+					break;
+				default:
+					return unexpected();
+			}
+
+			if (kind() != Kind::S_RBRACKET)
+				return unexpected();
+			next();
+			if (kind() != Kind::S_ASSIGN)
+				return unexpected();
+			next();
+		} else if (kind() == Kind::S_ID) {
+			key = Key::Name;
+			name = m_token->value.as<SymbolId>();
+			next();
+			if (kind() != Kind::S_ASSIGN)
+				return unexpected();
+			next();
+		}
+
+		const Location valueLocation = m_token->location;
+		const bool nil = kind() == Kind::S_NIL;
+		if (!value(depth + 1))
+			return false;
+
+		if (nil)
+			Logger::logIssue<Issue::Table::NilValue>(valueLocation);
+
+		const Location field{begin.file, begin.begin, m_lastEnd};
+		TableKeys &keys = m_tables[depth];
+		switch (key) {
+			case Key::None:
+				keys.addPositional(field);
+				break;
+			case Key::Name:
+				keys.addName(name, field);
+				break;
+			case Key::String:
+				keys.addString(string, field);
+				break;
+			case Key::Number:
+				if (number.isReal)
+					keys.addReal(number.real, field);
+				else
+					keys.addInteger(number.integer, field);
+				break;
+			case Key::Boolean:
+				keys.addBoolean(boolean, field);
+				break;
+		}
+
+		if (kind() == Kind::S_COMMA || kind() == Kind::S_SEMICOLON)
+			next();
+		else if (kind() != Kind::S_RBRACE)
+			return unexpected();
+	}
+
+	next();
+	return true;
+}
+
+bool DataValidator::number(Number &result)
+{
+	//unary minus of a number literal is folded by the parser as well
+	bool negative = false;
+	while (kind() == Kind::S_MINUS) {
+		negative = !negative;
+		next();
+	}
+
+	if (kind() == Kind::S_INT_VALUE) {
+		result.isReal = false;
+		result.integer = m_token->value.as<long>();
+		if (negative)
+			result.integer = static_cast<long>(0ul - static_cast<unsigned long>(result.integer));
+	} else if (kind() == Kind::S_REAL_VALUE) {
+		result.isReal = true;
+		result.real = negative ? -m_token->value.as<double>() : m_token->value.as<double>();
+	} else {
+		return unexpected();
+	}
+
+	next();
+	return true;
+}
+
+void DataValidator::next()
+{
+	if (m_token)
+		m_lastEnd = m_token->location.end;
+	m_token.emplace(m_driver.nextToken());
+}
+
+bool DataValidator::unexpected()
+{
+	if (!m_strict) {
+		m_result = Result::NotData;
+		return false;
+	}
+
+	std::ostringstream ss;
+	ss << "Parse error: " << m_token->location << " : syntax error, unexpected " << m_token->name() << '\n';
+	m_error = ss.str();
+	m_result = Result::Invalid;
+	return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Parser.hpp"
+#include "Symbol.hpp"
+#include "TableKeys.hpp"
+
+class Driver;
+
+/*
+ * Validation of data-only input (literal values and table constructors
+ * assigned to global names or returned) in a single pass over its tokens,
+ * without building an AST. Memory used does not grow with the number of
+ * fields, only the keys of the tables open at once are kept. Found issues are
+ * the same as those of the full analysis of the input.
+ */
+class DataValidator {
+public:
+	enum class Result {
+		Valid,
+		Invalid,
+		NotData,
+	};
+
+	/* strict: tokens outside of the data-only subset are reported as syntax errors, the input is not NotData */
+	DataValidator(Driver &driver, bool strict) : m_driver{driver}, m_strict{strict} {}
+	DataValidator(const DataValidator &) = delete;
+	void operator = (const DataValidator &) = delete;
+
+	/* issues are reported for valid input only, other input is left to the parser */
+	Result validate();
+
+private:
+	using Kind = yy::Parser::symbol_kind;
+
+	bool chunk();
+	bool assignment();
+	bool value(unsigned depth);
+	bool table(unsigned depth);
+	struct Number {
+		bool isReal = false;
+		long integer = 0;
+		double real = 0;
+	};
+
+	bool number(Number &result);
+	Kind::symbol_kind_type kind() const { return m_token->kind(); }
+	void next();
+	bool unexpected();
+
+	Driver &m_driver;
+	bool m_strict;
+	Result m_result = Result::Valid;
+	/* first token outside of the data-only subset in strict mode, reported if the parser accepts the input */
+	std::string m_error;
+	std::optional <yy::Parser::symbol_type> m_token;
+	/* end of the last token before m_token */
+	uint32_t m_lastEnd = 0;
+	/* keys of the open tables by nesting depth, reused by the following ones */
+	std::vector <TableKeys> m_tables;
+	/* global names stored to so far */
+	SymbolMap <bool> m_globals;
+};
@@ -1,16 +1,42 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 
+#include "AnalysisSession.hpp"
 #include "AST.hpp"
+#include "ASTCache.hpp"
 #include "Driver.hpp"
 #include "Logger.hpp"
 
+namespace {
+	const std::string StdinFilename{"<stdin>"};
+
+	/* smaller parts are not worth a thread */
+	constexpr size_t MinPartSize = 64 << 10;
+}
+
 Driver::Driver()
-	: m_parser{*this}, m_scanner{*this},
-	  m_inputStream{&m_preprocessor}, m_errorStream{&std::cerr},
-	  m_filename{"<stdin>"}, m_position{&m_filename, 1, 1}
+	: m_parser{*this}, m_scanner{*this}, m_lexer{*this},
+	  m_inputStream{std::cin.rdbuf()}, m_errorStream{&std::cerr},
+	  m_symbols{AnalysisSession::current().symbols()},
+	  m_filename{&StdinFilename}
 {
 }
 
+Driver::~Driver()
+{
+	if (m_sourceFile == nullptr)
+		return;
+
+	/* chunks moved out of the driver outlive the input, their locations need the line index */
+	const bool chunksTaken = std::any_of(m_chunks.begin(), m_chunks.end(), [](const auto &chunk) { return !chunk; });
+	m_sourceFile->releaseText(chunksTaken);
+}
+
 void Driver::addChunk(std::unique_ptr <AST::Chunk> &&chunk)
 {
 	m_chunks.emplace_back(std::move(chunk));
@@ -26,9 +52,100 @@ const std::vector <std::unique_ptr <AST::Chunk> > & Driver::chunks() const
 	return m_chunks;
 }
 
+size_t Driver::countTokens()
+{
+	prepareInput();
+
+	size_t count = 0;
+	while (nextToken().kind() != yy::Parser::symbol_kind::S_YYEOF)
+		++count;
+
+	return count;
+}
+
+int Driver::dumpTokens(std::ostream &os)
+{
+	using Kind = yy::Parser::symbol_kind;
+
+	prepareInput();
+
+	for (;;) {
+		const auto token = nextToken();
+		os << token.location << ' ' << token.name();
+
+		switch (token.kind()) {
+			case Kind::S_INT_VALUE:
+				os << ' ' << token.value.as<long>();
+				break;
+			case Kind::S_REAL_VALUE:
+				os << ' ' << std::setprecision(17) << token.value.as<double>();
+				break;
+			case Kind::S_ID:
+				os << ' ' << std::quoted(token.value.as<SymbolId>().str());
+				break;
+			case Kind::S_STRING_VALUE:
+				os << ' ' << std::quoted(token.value.as<std::string_view>());
+				break;
+			default:
+				break;
+		}
+
+		os << '\n';
+		if (token.kind() == Kind::S_YYEOF)
+			return 0;
+	}
+}
+
+const std::shared_ptr <AST::ConstTableStorage> & Driver::constTables()
+{
+	if (!m_constTables)
+		m_constTables = std::make_shared<AST::ConstTableStorage>();
+	return m_constTables;
+}
+
 int Driver::parse()
 {
-	m_scanner.switch_streams(&m_inputStream);
+	prepareInput();
+
+	const size_t size = m_buffer.end() - m_buffer.begin();
+	uint64_t cacheKey = 0;
+	if (m_cache) {
+		cacheKey = m_cache->key(m_buffer.begin(), size);
+		if (auto chunk = m_cache->load(cacheKey, size, m_file)) {
+			addChunk(std::move(chunk));
+			return 0;
+		}
+	}
+
+	/* a lazily parsed tree is not complete, storing it would parse every skipped body */
+	const int result = m_parseJobs > 1 ? parseParts() : parseInput();
+	if (result == 0 && m_cache && !m_lazyFunctions && m_chunks.size() == 1)
+		m_cache->store(cacheKey, size, *m_chunks[0]);
+	return result;
+}
+
+int Driver::parseRange(FileId file, uint32_t begin, uint32_t end)
+{
+	prepareRange(file, begin, end);
+	return parseInput();
+}
+
+uint32_t Driver::nextTokenOffset(FileId file, uint32_t begin, uint32_t offset)
+{
+	const SourceFile &source = AnalysisSession::current().sourceFile(file);
+	prepareRange(file, begin, source.size());
+
+	for (;;) {
+		const auto token = nextToken();
+		if (token.location.begin >= offset)
+			return token.location.begin;
+		if (token.location.end > offset)
+			return NoToken;
+	}
+}
+
+int Driver::parseInput()
+{
 	if (m_parser.parse() != 0)
 		return 1;
 
@@ -47,40 +164,245 @@ int Driver::parse()
 	return 0;
 }
 
-yy::location Driver::location(const char *s)
+/*
+ * Parses the parts of the input found by Lexer::splitPoints() on threads of
+ * their own, each with a Driver and a helper session of its own, and joins
+ * their chunks. If any part fails, its messages are dropped and the whole
+ * input is parsed again on this thread, an error near a split point would be
+ * reported differently by the part.
+ */
+int Driver::parseParts()
 {
-	yy::position end = m_position + strlen(s);
-	auto result = yy::location{m_position, end};
-	m_position = end;
-	return result;
+	const char *text = m_buffer.begin();
+	const size_t size = m_buffer.end() - text;
+	const unsigned parts = std::min<size_t>(m_parseJobs, size / MinPartSize);
+
+	std::vector <uint32_t> bounds = Lexer::splitPoints(text, text + size, parts);
+	if (bounds.empty())
+		return parseInput();
+
+	bounds.insert(bounds.begin(), 0);
+	bounds.push_back(size);
+
+	//locations in messages of the parts are resolved concurrently, the line index has to exist before
+	m_sourceFile->position(0);
+
+	struct Part {
+		std::unique_ptr <AST::Chunk> chunk;
+		std::ostringstream errors;
+		std::ostringstream log;
+		int status = 1;
+	};
+
+	auto &parent = AnalysisSession::current();
+	std::vector <Part> results(bounds.size() - 1);
+	std::vector <std::thread> threads;
+	threads.reserve(results.size());
+
+	for (size_t idx = 0; idx != results.size(); ++idx) {
+		threads.emplace_back([this, &parent, &part = results[idx], begin = bounds[idx], end = bounds[idx + 1]]
+		{
+			AnalysisSession session{parent};
+			session.setOutput(part.log);
+
+			part.status = session.run([this, &part, begin, end]
+			{
+				Driver driver;
+				driver.setErrorStream(&part.errors);
+				driver.useNativeLexer(m_nativeLexer);
+				driver.setLazyFunctions(m_lazyFunctions);
+
+				const int status = driver.parseRange(m_file, begin, end);
+				if (status == 0)
+					part.chunk = std::move(driver.chunks()[0]);
+				return status;
+			});
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	const bool failed = std::any_of(results.begin(), results.end(), [](const Part &part) { return part.status != 0; });
+	if (failed)
+		return parseInput();
+
+	uint32_t begin = 0;
+	uint32_t end = 0;
+	bool empty = true;
+	for (auto &part : results) {
+		if (!part.chunk->isEmpty()) {
+			if (empty)
+				begin = part.chunk->location().begin;
+			end = part.chunk->location().end;
+			empty = false;
+		}
+	}
+
+	auto chunk = std::make_unique<AST::Chunk>(Location{m_file, begin, end});
+	for (auto &part : results)
+		chunk->splice(std::move(*part.chunk));
+
+	addChunk(std::move(chunk));
+	return 0;
+}
+
+Location Driver::location(const char *s)
+{
+	return location(strlen(s));
 }
 
-void Driver::nextLine()
+Location Driver::location(unsigned length)
 {
-	m_position.lines(1);
+	const Location result{m_file, m_offset, m_offset + length};
+	m_offset += length;
+	return result;
 }
 
-void Driver::step()
+void Driver::setInputBuffer(const std::string &filename, const char *data, size_t size)
 {
-	m_position += 1;
+	m_filename = AnalysisSession::current().internFilename(filename);
+	m_buffer.assign(data, size);
+	m_inputStream.rdbuf(&m_buffer);
 }
 
 void Driver::setInputFile(const char *filename)
 {
-	m_filename = filename;
-	m_inputFile.open(m_filename);
+	m_filename = AnalysisSession::current().internFilename(filename);
+
+	if (m_mappedFile.open(*m_filename)) {
+		m_buffer.assign(m_mappedFile.data(), m_mappedFile.size());
+		m_inputStream.rdbuf(&m_buffer);
+		return;
+	}
+
+	m_inputFile.open(*m_filename);
 	if (m_inputFile.fail())
-		FATAL("Unable to open file for reading: " << m_filename.c_str() << '\n');
+		FATAL("Unable to open file for reading: " << *m_filename << '\n');
 
-	m_position.initialize(&m_filename);
-	m_preprocessor.setInputFile(m_filename, &m_inputFile);
+	m_inputStream.rdbuf(m_inputFile.rdbuf());
 }
 
 void Driver::setInputStream(std::istream *input)
 {
-	m_filename.clear();
-	m_position.initialize();
-	m_preprocessor.setInputStream(input);
+	m_filename = nullptr;
+	m_inputStream.rdbuf(input->rdbuf());
+}
+
+yy::Parser::symbol_type Driver::nextToken()
+{
+	if (m_functionHeader == FunctionHeader::Complete) {
+		m_functionHeader = FunctionHeader::None;
+
+		/* the body is left unparsed when its end is found, otherwise it is parsed as usual */
+		const char *body = m_buffer.begin() + (m_offset - m_bufferOffset);
+		if (const char *bodyEnd = Lexer::skipBlock(body, m_buffer.end())) {
+			const uint32_t begin = m_offset;
+			restartLexer(begin + (bodyEnd - body));
+			return yy::Parser::make_SKIPPED_BODY(locationFrom(begin));
+		}
+	}
+
+	auto token = m_nativeLexer ? m_lexer.token() : m_scanner.token();
+	if (m_lazyFunctions)
+		trackFunctionHeader(token.kind());
+	return token;
+}
+
+void Driver::trackFunctionHeader(yy::Parser::symbol_kind_type kind)
+{
+	using Kind = yy::Parser::symbol_kind;
+
+	switch (kind) {
+		case Kind::S_FUNCTION:
+			m_functionHeader = FunctionHeader::Name;
+			break;
+		case Kind::S_ID:
+			break;
+		case Kind::S_DOT:
+		case Kind::S_COLON:
+			if (m_functionHeader != FunctionHeader::Name)
+				m_functionHeader = FunctionHeader::None;
+			break;
+		case Kind::S_LPAREN:
+			m_functionHeader = m_functionHeader == FunctionHeader::Name ? FunctionHeader::Params : FunctionHeader::None;
+			break;
+		case Kind::S_COMMA:
+		case Kind::S_ELLIPSIS:
+			if (m_functionHeader != FunctionHeader::Params)
+				m_functionHeader = FunctionHeader::None;
+			break;
+		case Kind::S_RPAREN:
+			m_functionHeader = m_functionHeader == FunctionHeader::Params ? FunctionHeader::Complete : FunctionHeader::None;
+			break;
+		default:
+			m_functionHeader = FunctionHeader::None;
+			break;
+	}
+}
+
+void Driver::prepareInput()
+{
+	//input already read and registered, lexed again from its start
+	if (m_sourceFile) {
+		m_buffer.assign(m_sourceFile->text(), m_sourceFile->size());
+		m_inputStream.clear();
+		startLexer(0);
+		return;
+	}
+
+	/*
+	 * Streams are read completely, also for flex. Names and constants of the AST
+	 * are views of the text, lazily skipped bodies, split points and the line
+	 * index are found in it, so it is kept for as long as the AST.
+	 */
+	if (m_inputStream.rdbuf() != &m_buffer) {
+		m_inputData.assign(std::istreambuf_iterator<char>{m_inputStream}, std::istreambuf_iterator<char>{});
+		m_buffer.assign(m_inputData.data(), m_inputData.size());
+		m_inputStream.rdbuf(&m_buffer);
+	}
+
+	const size_t size = m_buffer.end() - m_buffer.begin();
+	if (size > UINT32_MAX)
+		FATAL("Input is too large, locations are limited to 4 GiB\n");
+
+	auto &session = AnalysisSession::current();
+	m_file = session.addSourceFile(m_filename, m_buffer.begin(), size);
+	m_sourceFile = &session.sourceFile(m_file);
+	startLexer(0);
+}
+
+void Driver::prepareRange(FileId file, uint32_t begin, uint32_t end)
+{
+	const SourceFile &source = AnalysisSession::current().sourceFile(file);
+	assert(begin <= end && end <= source.size());
+
+	m_buffer.assign(source.text() + begin, end - begin);
+	m_inputStream.rdbuf(&m_buffer);
+	m_filename = source.filename();
+	m_file = file;
+	startLexer(begin);
+}
+
+/* continues lexing at offset, past text skipped without the lexer */
+void Driver::restartLexer(uint32_t offset)
+{
+	const char *p = m_buffer.begin() + (offset - m_bufferOffset);
+	m_buffer.assign(p, m_buffer.end() - p);
+	m_inputStream.clear();
+	startLexer(offset);
+}
+
+void Driver::startLexer(uint32_t offset)
+{
+	m_offset = offset;
+	m_bufferOffset = offset;
+	m_functionHeader = FunctionHeader::None;
+
+	if (m_nativeLexer)
+		m_lexer.reset(m_buffer.begin(), m_buffer.end());
+	else
+		m_scanner.switch_streams(&m_inputStream);
 }
 
 void Driver::logError(const std::string &msg)
@@ -2,46 +2,127 @@
 
 #include <fstream>
 #include <memory>
+#include <string_view>
 #include <vector>
 
 #include "AST_fwd.hpp"
-#include "Preprocessor.hpp"
+#include "Lexer.hpp"
+#include "Location.hpp"
+#include "MappedFile.hpp"
 #include "Scanner.hpp"
+#include "Symbol.hpp"
+
+class ASTCache;
 
 class Driver {
+	friend class DataValidator;
 	friend class yy::Parser;
 public:
 	Driver();
+	Driver(const Driver &) = delete;
+	void operator = (const Driver &) = delete;
+	~Driver();
 
 	void addChunk(std::unique_ptr <AST::Chunk> &&chunk);
 	std::vector <std::unique_ptr <AST::Chunk> > & chunks();
 	const std::vector <std::unique_ptr <AST::Chunk> > & chunks() const;
 
+	size_t countTokens();
+	int dumpTokens(std::ostream &os);
 	int parse();
 
-	yy::location location() const { return yy::location{m_position, m_position}; }
-	yy::location location(const char *s);
-	yy::position position() const { return m_position; }
+	/*
+	 * Parses bytes [begin, end) of the text of file, a source file registered
+	 * in the current session by someone else. Locations are offsets into the
+	 * whole text, the text is not released with the driver.
+	 */
+	int parseRange(FileId file, uint32_t begin, uint32_t end);
+
+	/* offset of the first token at or after offset when the text of file is lexed from begin */
+	static constexpr uint32_t NoToken = UINT32_MAX;
+	uint32_t nextTokenOffset(FileId file, uint32_t begin, uint32_t offset);
+
+	/* location(s) and location(length) return the location of the next token and move past it */
+	Location location() const { return Location{m_file, m_offset, m_offset}; }
+	Location location(const char *s);
+	Location location(unsigned length);
+	Location locationFrom(uint32_t begin) const { return Location{m_file, begin, m_offset}; }
+	uint32_t offset() const { return m_offset; }
+	/* text of [begin, end), lexed since the lexer was last started, as a view of the input */
+	std::string_view text(uint32_t begin, uint32_t end) const { return std::string_view{m_buffer.begin() + (begin - m_bufferOffset), end - begin}; }
+	SymbolTable & symbols() { return m_symbols; }
+	/* storage of the constant tables parsed by this driver */
+	const std::shared_ptr <AST::ConstTableStorage> & constTables();
 
 	void logError(const std::string &msg);
-	void nextLine();
-	void step();
+	/* parse() looks the input up in cache first and stores successfully parsed input in it */
+	void setCache(const ASTCache *cache) { m_cache = cache; }
+	void step(unsigned bytes = 1) { m_offset += bytes; }
 
 	void setErrorStream(std::ostream *os) { m_errorStream = os; }
+	void setInputBuffer(const std::string &filename, const char *data, size_t size);
 	void setInputFile(const char *filename);
 	void setInputFile(const std::string &filename) { setInputFile(filename.c_str()); }
 	void setInputStream(std::istream *input);
+	/* function bodies are only scanned for their end, AST::Function parses them on first use */
+	void setLazyFunctions(bool enable) { m_lazyFunctions = enable; }
+	/* parse() splits large input into parts parsed on up to jobs threads */
+	void setParseJobs(unsigned jobs) { m_parseJobs = jobs; }
+	void useNativeLexer(bool enable) { m_nativeLexer = enable; }
 
 private:
+	/* read-only view of a buffer owned by someone else */
+	class MemoryBuffer : public std::streambuf {
+	public:
+		void assign(const char *data, size_t size)
+		{
+			char *begin = const_cast<char *>(data);
+			setg(begin, begin, begin + size);
+		}
+
+		const char * begin() const { return eback(); }
+		const char * end() const { return egptr(); }
+	};
+
+	/* tokens of a function header seen so far, a body follows a complete one */
+	enum class FunctionHeader : uint8_t {
+		None,
+		Name,
+		Params,
+		Complete,
+	};
+
+	yy::Parser::symbol_type nextToken();
+	int parseInput();
+	int parseParts();
+	void prepareInput();
+	void prepareRange(FileId file, uint32_t begin, uint32_t end);
+	void restartLexer(uint32_t offset);
+	void startLexer(uint32_t offset);
+	void trackFunctionHeader(yy::Parser::symbol_kind_type kind);
 
-	Preprocessor m_preprocessor;
 	yy::Parser m_parser;
 	Scanner m_scanner;
+	Lexer m_lexer;
+	bool m_nativeLexer = false;
+	bool m_lazyFunctions = false;
+	unsigned m_parseJobs = 1;
+	FunctionHeader m_functionHeader = FunctionHeader::None;
 	std::istream m_inputStream;
+	MemoryBuffer m_buffer;
+	MappedFile m_mappedFile;
 	std::ifstream m_inputFile;
+	std::string m_inputData;
 	std::ostream *m_errorStream;
+	const ASTCache *m_cache = nullptr;
 
 	std::vector <std::unique_ptr <AST::Chunk> > m_chunks;
-	std::string m_filename;
-	yy::position m_position;
+	std::shared_ptr <AST::ConstTableStorage> m_constTables;
+	SymbolTable &m_symbols;
+	const std::string *m_filename;
+	SourceFile *m_sourceFile = nullptr;
+	FileId m_file = NoFile;
+	uint32_t m_offset = 0;
+	/* offset of the start of m_buffer */
+	uint32_t m_bufferOffset = 0;
 };
@@ -1,4 +1,5 @@
 #include <sstream>
+#include "AnalysisSession.hpp"
 #include "AST.hpp"
 #include "ControlFlowGraph.hpp"
 #include "Function.hpp"
@@ -10,20 +11,24 @@ Function::Function(const AST::Function &fnNode, Scope &scope)
 	if (!fnNode.isLocal() && !fnNode.isAnonymous() && !fnNode.isMethod() && !fnNode.isNested() && scope.functionScope() == nullptr)
 		Logger::logIssue<Issue::GlobalFunctionDefinition>(fnNode.name().location(), fnNode.fullName());
 
+	/* nested functions are analyzed with the enclosing one, their body is needed for its CFG anyway */
+	if (scope.functionScope() == nullptr && !AnalysisSession::current().isInLineFilter(fnNode.location()))
+		return;
+
 	if (fnNode.isMethod())
-		m_fnScope.addFunctionParam("self", yy::location{});
+		m_fnScope.addFunctionParam(SymbolId::Self, Location{});
 
 	for (const auto &param : fnNode.params().names()) {
 		if (!m_fnScope.addFunctionParam(param.first, param.second)) {
-			if (param.first != "self")
-				Logger::logIssue<Issue::Function::DuplicateParam>(param.second, param.first);
+			if (param.first != SymbolId::Self)
+				Logger::logIssue<Issue::Function::DuplicateParam>(param.second, param.first.str());
 			else
 				Logger::logIssue<Issue::Function::DuplicateParamSelf>(param.second);
 		}
 	}
 
 	if (fnNode.isVariadic()) {
-		if (!m_fnScope.addFunctionParam("arg", yy::location{})) {
+		if (!m_fnScope.addFunctionParam(SymbolId::Arg, Location{})) {
 			Logger::logIssue<Issue::Function::EllipsisShadowsParam>(fnNode.paramList().location());
 		}
 	}
@@ -31,8 +36,8 @@ Function::Function(const AST::Function &fnNode, Scope &scope)
 	m_cfg = std::make_unique<ControlFlowGraph>(fnNode.chunk(), m_fnScope);
 
 	if (m_resultCnt.value_or(0)) {
-		for (BasicBlock *pred : m_cfg->exit()->predecessors) {
-			if (pred->exitType() != BasicBlock::ExitType::Return) {
+		for (BlockId pred : m_cfg->block(m_cfg->exit()).predecessors) {
+			if (m_cfg->block(pred).exitType() != BasicBlock::ExitType::Return) {
 				Logger::logIssue<Issue::Function::FallthroughNoResult>(fnNode.paramList().location());
 				break;
 			}
@@ -46,14 +51,33 @@ bool Function::isVariadic() const
 }
 
 void Function::irDump(unsigned indent)
+{
+	if (!m_cfg) {
+		Logger::indent(std::cout, indent) << '[' << dumpLabel() << "] not analyzed\n";
+		return;
+	}
+
+	m_cfg->irDump(indent, dumpLabel().c_str());
+}
+
+void Function::ssaDump(unsigned indent)
+{
+	if (!m_cfg) {
+		Logger::indent(std::cout, indent) << '[' << dumpLabel() << "] not analyzed\n";
+		return;
+	}
+
+	m_cfg->ssaDump(indent, dumpLabel().c_str());
+}
+
+std::string Function::dumpLabel() const
 {
 	std::ostringstream ss;
 	ss << m_fnNode.fullName();
 	if (m_fnNode.isAnonymous())
 		ss << " 0x" << &m_fnNode;
 	ss << " (" << m_fnNode.location() << ')';
-
-	m_cfg->irDump(indent, ss.str().c_str());
+	return ss.str();
 }
 
 void Function::setResultCount(const AST::Return &returnNode)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
 #include "AST_fwd.hpp"
 #include "Scope.hpp"
@@ -13,14 +14,19 @@ public:
 
 	bool isVariadic() const;
 
+	/* functions outside of the line filter of the session have no CFG */
+	bool isAnalyzed() const { return m_cfg != nullptr; }
 	const ControlFlowGraph & cfg() const { return *m_cfg; }
 	void irDump(unsigned indent = 0);
+	void ssaDump(unsigned indent = 0);
 	Scope & scope() { return m_fnScope; }
 
 	std::optional <unsigned> resultCount() const { return m_resultCnt; }
 	void setResultCount(const AST::Return &returnNode);
 
 private:
+	std::string dumpLabel() const;
+
 	const AST::Function &m_fnNode;
 	Scope m_fnScope;
 	std::unique_ptr <ControlFlowGraph> m_cfg;
@@ -1,57 +1,265 @@
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include "AST.hpp"
 #include "Fold.hpp"
 #include "IR.hpp"
 #include "IROp.hpp"
 
-std::ostream & operator << (std::ostream &os, const IR::Triplet &t)
+namespace IR {
+
+namespace {
+	/* held and viewed strings with the same text are the same constant */
+	bool isString(const ValueVariant &value)
+	{
+		return std::holds_alternative<std::string>(value) || std::holds_alternative<std::string_view>(value);
+	}
+
+	std::string_view stringText(const ValueVariant &value)
+	{
+		if (const auto *s = std::get_if<std::string>(&value))
+			return *s;
+		return std::get<std::string_view>(value);
+	}
+
+	uint64_t operandBits(RValue rval)
+	{
+		return uint64_t{rval.type().value()} << 32 | rval.index();
+	}
+
+	/* splitmix64 finalizer, std::hash leaves integers, doubles and pointers as they are and slots are taken from the low bits */
+	size_t mix(uint64_t x)
+	{
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+		return x ^ (x >> 31);
+	}
+
+	size_t constantHash(const ValueVariant &value)
+	{
+		return std::visit([](auto &&arg) -> size_t {
+			using T = std::decay_t<decltype(arg)>;
+			if constexpr(std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+				return std::hash<std::string_view>{}(arg);
+			} else if constexpr(std::is_same_v<T, double>) {
+				/* by representation, -0.0 and 0.0 are printed differently */
+				uint64_t bits;
+				memcpy(&bits, &arg, sizeof(bits));
+				return mix(bits);
+			} else if constexpr(std::is_same_v<T, TableReference>) {
+				return mix(operandBits(arg.first) * 0x9e3779b97f4a7c15 ^ operandBits(arg.second));
+			} else {
+				return mix(std::hash<T>{}(arg));
+			}
+		}, value);
+	}
+
+	bool sameConstant(const ValueVariant &a, const ValueVariant &b)
+	{
+		if (isString(a) && isString(b))
+			return stringText(a) == stringText(b);
+		if (a.index() != b.index())
+			return false;
+
+		return std::visit([&b](auto &&arg) {
+			using T = std::decay_t<decltype(arg)>;
+			const T &other = std::get<T>(b);
+			if constexpr(std::is_same_v<T, double>)
+				return memcmp(&arg, &other, sizeof(double)) == 0;
+			else if constexpr(std::is_same_v<T, TableReference>)
+				return operandBits(arg.first) == operandBits(other.first) && operandBits(arg.second) == operandBits(other.second);
+			else
+				return arg == other;
+		}, a);
+	}
+}
+
+Code::Code()
+	: m_constants{nullptr}
 {
-	if (IR::isTemporary(t.operation)) {
+}
+
+RValue Code::constant(const ValueVariant &value)
+{
+	if (std::holds_alternative<std::nullptr_t>(value))
+		return RValue::nil();
+
+	if ((m_constants.size() + 1) * 4 > m_constantIndex.size() * 3)
+		growConstantIndex();
+
+	const size_t mask = m_constantIndex.size() - 1;
+	size_t slot = constantHash(value) & mask;
+	for (; m_constantIndex[slot] != 0; slot = (slot + 1) & mask) {
+		if (sameConstant(m_constants[m_constantIndex[slot]], value))
+			return RValue{RValue::Type::Immediate, m_constantIndex[slot]};
+	}
+
+	m_constants.push_back(value);
+	m_constantIndex[slot] = m_constants.size() - 1;
+	return RValue{RValue::Type::Immediate, m_constantIndex[slot]};
+}
+
+void Code::growConstantIndex()
+{
+	m_constantIndex.assign(std::max<size_t>(m_constantIndex.size() * 2, 16), 0);
+
+	const size_t mask = m_constantIndex.size() - 1;
+	for (uint32_t idx = 1; idx != m_constants.size(); ++idx) {
+		size_t slot = constantHash(m_constants[idx]) & mask;
+		while (m_constantIndex[slot] != 0)
+			slot = (slot + 1) & mask;
+		m_constantIndex[slot] = idx;
+	}
+}
+
+RValue Code::variable(const AST::LValue *lval)
+{
+	m_variables.push_back(lval);
+	return RValue{RValue::Type::LValue, static_cast<uint32_t>(m_variables.size() - 1)};
+}
+
+RValue Code::virtualRegister(uint32_t idx)
+{
+	m_registerCount = std::max(m_registerCount, idx + 1);
+	return RValue{RValue::Type::Register, idx};
+}
+
+RValue Code::emit(Op operation, RValue lhs, RValue rhs)
+{
+	m_triplets.emplace_back(operation, lhs, rhs);
+	return RValue{RValue::Type::Temporary, static_cast<uint32_t>(m_triplets.size() - 1)};
+}
+
+const ValueVariant & Code::constant(RValue rval) const
+{
+	assert(rval.type() == RValue::Type::Immediate);
+	return m_constants[rval.index()];
+}
+
+const AST::LValue * Code::variable(RValue rval) const
+{
+	assert(rval.type() == RValue::Type::LValue);
+	return m_variables[rval.index()];
+}
+
+void Code::print(std::ostream &os, RValue rval) const
+{
+	switch (rval.type().value()) {
+		case RValue::Type::Immediate:
+			std::visit([this, &os](auto &&arg) {
+				using T = std::decay_t<decltype(arg)>;
+				if constexpr(std::is_same_v<T, nullptr_t>)
+					os << "nil";
+				else if constexpr(std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>)
+					os << std::quoted(arg);
+				else if constexpr(std::is_same_v<T, const AST::Function *>)
+					os << "function " << arg;
+				else if constexpr(std::is_same_v<T, const AST::ConstTable *>)
+					os << "const_table " << arg;
+				else if constexpr(std::is_same_v<T, TableReference>) {
+					print(os, arg.first);
+					os << '[';
+					print(os, arg.second);
+					os << ']';
+				} else if constexpr(std::is_same_v<T, bool>)
+					os << std::boolalpha << arg << std::noboolalpha;
+				else
+					os << arg;
+			}, constant(rval));
+			break;
+		case RValue::Type::LValue: {
+			auto lval = variable(rval);
+			assert(lval->lvalueType() == AST::LValue::Type::Name);
+			os << lval->name();
+			break;
+		}
+		case RValue::Type::Temporary:
+			os << "tmp_" << &m_triplets[rval.index()];
+			break;
+		case RValue::Type::Register:
+			os << "tmp_" << rval.index();
+			break;
+	}
+}
+
+void Code::print(std::ostream &os, uint32_t idx) const
+{
+	const Triplet &t = m_triplets[idx];
+
+	if (isTemporary(t.operation)) {
 		os << "tmp_0x" << &t << " = ";
 
-		if (IR::isBinaryOp(t.operation)) {
-			os << t.operands[0]
-				<< ' ' << AST::BinOp::toString(AST::BinOp::Type{t.operation.value()}) << ' '
-				<< t.operands[1];
-		} else if (IR::isUnaryOp(t.operation)) {
+		if (isBinaryOp(t.operation)) {
+			print(os, t.operands[0]);
+			os << ' ' << AST::BinOp::toString(AST::BinOp::Type{t.operation.value()}) << ' ';
+			print(os, t.operands[1]);
+		} else if (isUnaryOp(t.operation)) {
 			switch (t.operation.value()) {
-				case IR::Op::UnaryNegate: os << '-'; break;
-				case IR::Op::UnaryNot: os << "not "; break;
-				case IR::Op::UnaryLength: os << '#'; break;
+				case Op::UnaryNegate: os << '-'; break;
+				case Op::UnaryNot: os << "not "; break;
+				case Op::UnaryLength: os << '#'; break;
 				default: assert(false);
 			}
 
-			os << '(' << t.operands[0] << ')';
-		} else { // IR::Op::TableIndex
-			assert(t.operation == IR::Op::TableIndex);
-			os << t.operands[0] << '[' << t.operands[1] << ']';
+			os << '(';
+			print(os, t.operands[0]);
+			os << ')';
+		} else { // Op::TableIndex
+			assert(t.operation == Op::TableIndex);
+			print(os, t.operands[0]);
+			os << '[';
+			print(os, t.operands[1]);
+			os << ']';
 		}
 
-		return os;
+		return;
 	}
 
-	if (anyOf(t.operation, IR::Op::Assign, IR::Op::TableAssign)) {
-		os << t.operands[0] << " = " << t.operands[1];
-
-		return os;
+	if (anyOf(t.operation, Op::Assign, Op::TableAssign)) {
+		print(os, t.operands[0]);
+		os << " = ";
+		print(os, t.operands[1]);
+		return;
 	}
 
 	switch (t.operation.value()) {
-		case IR::Op::TableCtor: os << t.operands[0] << " = {}"; break;
-		case IR::Op::Push: os << "push " << t.operands[0]; break;
-		case IR::Op::Pop: os << "pop " << t.operands[0]; break;
-		case IR::Op::CallUnknownResults: os << "call_varres " << t.operands[0] << ' ' << t.operands[1]; break;
-		case IR::Op::Return: os << "return " << t.operands[0]; break;
-		case IR::Op::Jump: os << "jump " << t.operands[0]; break;
-		case IR::Op::JumpCond: os << "jump_true " << t.operands[0] << ' ' << t.operands[1]; break;
-		case IR::Op::Call: {
-			const long argResultCnt = std::get<long>(std::get<ValueVariant>(t.operands[1].valueRef));
-			os << "call " << t.operands[0] << ' ' << ((argResultCnt >> 16) & 0xffff) << ' ' << (argResultCnt & 0xffff);
+		case Op::TableCtor:
+			print(os, t.operands[0]);
+			/* constant tables are given as the second operand */
+			if (t.operands[1].type() == RValue::Type::Immediate && std::holds_alternative<const AST::ConstTable *>(constant(t.operands[1]))) {
+				os << " = ";
+				print(os, t.operands[1]);
+			} else {
+				os << " = {}";
+			}
+			break;
+		case Op::Push: os << "push "; print(os, t.operands[0]); break;
+		case Op::Pop: os << "pop "; print(os, t.operands[0]); break;
+		case Op::CallUnknownResults:
+			os << "call_varres ";
+			print(os, t.operands[0]);
+			os << ' ';
+			print(os, t.operands[1]);
+			break;
+		case Op::Return: os << "return "; print(os, t.operands[0]); break;
+		case Op::Jump: os << "jump "; print(os, t.operands[0]); break;
+		case Op::JumpCond:
+			os << "jump_true ";
+			print(os, t.operands[0]);
+			os << ' ';
+			print(os, t.operands[1]);
+			break;
+		case Op::Call: {
+			const long argResultCnt = std::get<long>(constant(t.operands[1]));
+			os << "call ";
+			print(os, t.operands[0]);
+			os << ' ' << ((argResultCnt >> 16) & 0xffff) << ' ' << (argResultCnt & 0xffff);
 			break;
 		}
 		default:
 			assert(false);
 	}
-
-	return os;
 }
+
+} //namespace IR
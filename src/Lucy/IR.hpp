@@ -1,24 +1,72 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <iosfwd>
-#include "location.hh"
+#include <vector>
+
 #include "IROp.hpp"
 #include "RValue.hpp"
+#include "ValueVariant.hpp"
 
 namespace IR {
 
 struct Triplet {
-	template <typename T>
-	Triplet(Op operation, const T &operand) : operation{operation}, operands{operand} {}
-
-	template <typename T1, typename T2>
-	Triplet(Op operation, const T1 &lhs, const T2 &rhs) : operation{operation}, operands{lhs, rhs} {}
+	Triplet(Op operation, RValue lhs, RValue rhs) : operation{operation}, operands{lhs, rhs} {}
 
 	Op operation;
 	std::array <RValue, 2> operands;
 };
 
-} //namespace IR
+/* triplets [first, first + size) of the code of a function */
+struct Range {
+	uint32_t first = 0;
+	uint32_t size = 0;
+
+	uint32_t end() const { return first + size; }
+	bool empty() const { return size == 0; }
+};
+
+/*
+ * IR of one function. Its triplets are stored by value in one array, the
+ * constants and variables they use in pools next to it, so an operand is an
+ * 8 byte handle and an instruction costs no allocation of its own. Constants
+ * are interned by value (strings by their text, whether held or viewed), a
+ * repeated literal, name or call count refers to the same entry.
+ */
+class Code {
+public:
+	Code();
+	Code(const Code &) = delete;
+	void operator = (const Code &) = delete;
+	~Code() = default;
+
+	RValue constant(const ValueVariant &value);
+	RValue variable(const AST::LValue *lval);
+	/* register idx of the function, the code generator numbers them from 1 */
+	RValue virtualRegister(uint32_t idx);
+	uint32_t registerCount() const { return m_registerCount; }
+	/* appends a triplet, returns the temporary holding its result */
+	RValue emit(Op operation, RValue lhs, RValue rhs = RValue::nil());
 
-std::ostream & operator << (std::ostream &os, const IR::Triplet &t);
+	const Triplet & operator [] (uint32_t idx) const { return m_triplets[idx]; }
+	uint32_t size() const { return m_triplets.size(); }
+
+	const ValueVariant & constant(RValue rval) const;
+	const AST::LValue * variable(RValue rval) const;
+
+	void print(std::ostream &os, uint32_t idx) const;
+	void print(std::ostream &os, RValue rval) const;
+
+private:
+	void growConstantIndex();
+
+	std::vector <Triplet> m_triplets;
+	std::vector <ValueVariant> m_constants;
+	/* open addressing hash set of indices into m_constants, 0 (nil) marks unused slots */
+	std::vector <uint32_t> m_constantIndex;
+	std::vector <const AST::LValue *> m_variables;
+	uint32_t m_registerCount = 0;
+};
+
+} //namespace IR
@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <vector>
+
+#include "AnalysisSession.hpp"
+#include "AST.hpp"
+#include "Driver.hpp"
+#include "IncrementalParser.hpp"
+#include "Logger.hpp"
+#include "Visitor.hpp"
+
+namespace {
+	/*
+	 * Locations of some statements leave out keywords: do blocks lack both "do"
+	 * and "end", named functions start at the parameters and if statements end
+	 * with their first block (as do chunks ending with one). Regions are never
+	 * bounded by those.
+	 */
+	bool hasExactBegin(const AST::Node &statement)
+	{
+		return statement.type() != AST::Node::Type::Chunk && statement.type() != AST::Node::Type::Function;
+	}
+
+	bool hasExactEnd(const AST::Node &statement)
+	{
+		return statement.type() != AST::Node::Type::Chunk && statement.type() != AST::Node::Type::If;
+	}
+
+	/* whether all of node lies before offset, the else branches of an if lie past its end */
+	bool endsBefore(const AST::Node &node, uint32_t offset)
+	{
+		const Location &loc = node.location();
+		return loc.file != NoFile && loc.end < offset && node.type() != AST::Node::Type::Chunk && node.type() != AST::Node::Type::If;
+	}
+
+	/* return and break have to be the last statements of their blocks */
+	bool isLastStatement(const AST::Node &statement)
+	{
+		return statement.type() == AST::Node::Type::Return || statement.type() == AST::Node::Type::Break;
+	}
+
+	bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+	}
+}
+
+/* chunks (blocks of statements) enclosing an edit, outermost first */
+class IncrementalParser::EnclosingChunks : public AST::Visitor<EnclosingChunks> {
+public:
+	EnclosingChunks(AST::Chunk &root, const TextEdit &edit)
+		: m_edit{edit}
+	{
+		/* the root chunk spans the whole text, even leading and trailing comments */
+		chunks.push_back(&root);
+		visitChildren(root);
+	}
+
+	bool enter(const AST::Node &node) const
+	{
+		const Location &loc = node.location();
+		if (loc.file == NoFile)
+			return true;
+
+		return loc.begin <= m_edit.begin && !endsBefore(node, m_edit.end);
+	}
+
+	void visit(const AST::Chunk &chunk)
+	{
+		chunks.push_back(const_cast<AST::Chunk *>(&chunk));
+		visitChildren(chunk);
+	}
+
+	/* a body left unparsed is replaced along with its function, it is not parsed from the edited text */
+	void visit(const AST::Function &fnNode)
+	{
+		if (fnNode.isBodyParsed())
+			visitChildren(fnNode);
+	}
+
+	template <typename T>
+	void visit(const T &node)
+	{
+		visitChildren(node);
+	}
+
+	std::vector <AST::Chunk *> chunks;
+
+private:
+	const TextEdit &m_edit;
+};
+
+/*
+ * Moves locations at or after offset from by delta bytes. Locations ending
+ * right at from end where the statements ending a chunk now end instead, a
+ * region ending an if block or a chunk ends its enclosing nodes too.
+ */
+class IncrementalParser::LocationShifter : public AST::Visitor<LocationShifter> {
+public:
+	LocationShifter(uint32_t from, int64_t delta, uint32_t end)
+		: m_from{from}, m_delta{delta}, m_end{end}
+	{
+	}
+
+	bool enter(const AST::Node &node)
+	{
+		/* nodes lie within their parents, nothing in a subtree ending before the edit moves */
+		if (endsBefore(node, m_from))
+			return false;
+
+		shift(const_cast<AST::Node &>(node).m_location);
+		return true;
+	}
+
+	void visit(const AST::ConstTable &table)
+	{
+		/* the storage may be shared with other literals, only the tables of this one are shifted */
+		AST::ConstTableStorage &storage = *table.m_storage;
+		for (auto id = table.m_tables.first; id != table.m_tables.end(); ++id)
+			shift(storage.tables[id].location);
+		for (auto idx = table.m_fields.first; idx != table.m_fields.end(); ++idx)
+			shift(storage.fields[idx].location);
+	}
+
+	void visit(const AST::ParamList &params)
+	{
+		for (auto &name : const_cast<AST::ParamList &>(params).m_names)
+			shift(name.second);
+	}
+
+	/* a body left unparsed by a lazy parse is parsed from its location on first use */
+	void visit(const AST::Function &fnNode)
+	{
+		shift(const_cast<AST::Function &>(fnNode).m_body);
+		if (fnNode.isBodyParsed()) {
+			visitChildren(fnNode);
+		} else {
+			if (!fnNode.isAnonymous())
+				dispatch(fnNode.name());
+			dispatch(fnNode.paramList());
+		}
+	}
+
+	template <typename T>
+	void visit(const T &node)
+	{
+		visitChildren(node);
+	}
+
+private:
+	void shift(Location &loc) const
+	{
+		if (loc.file == NoFile)
+			return;
+		if (loc.begin >= m_from)
+			loc.begin += m_delta;
+		if (loc.end > m_from)
+			loc.end += m_delta;
+		else if (loc.end == m_from)
+			loc.end = m_end;
+	}
+
+	uint32_t m_from;
+	int64_t m_delta;
+	uint32_t m_end;
+};
+
+IncrementalParser::IncrementalParser(const std::string &filename)
+	: m_session{AnalysisSession::current()}, m_errorStream{&std::cerr}
+{
+	m_file = m_session.addSourceFile(m_session.internFilename(filename), m_text.data(), m_text.size());
+}
+
+IncrementalParser::~IncrementalParser()
+{
+	/* trees taken from chunk() may outlive the text */
+	m_session.sourceFile(m_file).releaseText(true);
+}
+
+int IncrementalParser::parse(std::string text)
+{
+	m_text = std::move(text);
+	updateSource();
+	m_incremental = false;
+	return parseAll();
+}
+
+int IncrementalParser::edit(const TextEdit &edit)
+{
+	assert(edit.begin <= edit.end && edit.end <= m_text.size());
+
+	Region region;
+	const bool local = m_chunk && findRegion(edit, region);
+
+	m_text.replace(edit.begin, edit.end - edit.begin, edit.replacement);
+	updateSource();
+
+	const int64_t delta = static_cast<int64_t>(edit.replacement.size()) - (edit.end - edit.begin);
+	m_incremental = local && reparse(region, delta);
+	if (m_incremental)
+		return 0;
+
+	return parseAll();
+}
+
+TextEdit IncrementalParser::diff(std::string_view from, std::string_view to)
+{
+	const size_t common = std::min(from.size(), to.size());
+	const size_t prefix = std::mismatch(from.begin(), from.begin() + common, to.begin()).first - from.begin();
+	const size_t suffix = std::mismatch(from.rbegin(), from.rbegin() + (common - prefix), to.rbegin()).first - from.rbegin();
+
+	return TextEdit{static_cast<uint32_t>(prefix), static_cast<uint32_t>(from.size() - suffix), to.substr(prefix, to.size() - suffix - prefix)};
+}
+
+bool IncrementalParser::findRegion(const TextEdit &edit, Region &region) const
+{
+	EnclosingChunks enclosing{*m_chunk, edit};
+
+	for (auto iter = enclosing.chunks.rbegin(); iter != enclosing.chunks.rend(); ++iter) {
+		if (findRegionIn(**iter, edit, region))
+			return true;
+	}
+
+	return false;
+}
+
+bool IncrementalParser::findRegionIn(AST::Chunk &chunk, const TextEdit &edit, Region &region) const
+{
+	const auto &children = chunk.children();
+	const bool root = &chunk == m_chunk.get();
+
+	/* statements touching the edit, text appended to a statement may still belong to it */
+	size_t first = 0;
+	while (first != children.size() && children[first]->location().end < edit.begin)
+		++first;
+	size_t last = first;
+	while (last != children.size() && children[last]->location().begin <= edit.end)
+		++last;
+
+	/*
+	 * The region has to start and end between tokens in both the old and the
+	 * new text: at the start of an untouched statement token, after the end of
+	 * an unchanged one or at the edges of the text.
+	 */
+	const AST::Node *firstTouched = first != last ? children[first].get() : nullptr;
+	const AST::Node *lastTouched = first != last ? children[last - 1].get() : nullptr;
+
+	if (firstTouched && hasExactBegin(*firstTouched) && (edit.begin > firstTouched->location().begin
+		|| (edit.begin == firstTouched->location().begin && (edit.begin == 0 || isSpace(m_text[edit.begin - 1])))))
+		region.begin = firstTouched->location().begin;
+	else if (first != 0 && hasExactEnd(*children[first - 1]))
+		region.begin = children[first - 1]->location().end;
+	else if (first == 0 && root)
+		region.begin = 0;
+	else
+		return false;
+
+	if (lastTouched && hasExactEnd(*lastTouched) && edit.end <= lastTouched->location().end)
+		region.end = lastTouched->location().end;
+	else if (last != children.size() && hasExactBegin(*children[last]))
+		region.end = children[last]->location().begin;
+	else if (last == children.size() && root)
+		region.end = m_text.size();
+	else
+		return false;
+
+	region.chunk = &chunk;
+	region.first = first;
+	region.last = last;
+	return true;
+}
+
+bool IncrementalParser::reparse(const Region &region, int64_t delta)
+{
+	const uint32_t end = region.end + delta;
+
+	Driver driver;
+	driver.setErrorStream(nullptr);
+	driver.useNativeLexer(m_nativeLexer);
+	driver.setLazyFunctions(m_lazyFunctions);
+
+	try {
+		if (driver.parseRange(m_file, region.begin, end) != 0)
+			return false;
+	} catch (const AnalysisSession::Aborted &) {
+		/* unrecognized input, reported by parsing the whole text */
+		return false;
+	}
+
+	/* a comment or a token the region ends with must not run into the following text */
+	if (driver.nextTokenOffset(m_file, region.begin, end) != driver.nextTokenOffset(m_file, end, end))
+		return false;
+
+	AST::Chunk &chunk = *region.chunk;
+	auto &children = chunk.m_children;
+	auto &statements = driver.chunks()[0]->m_children;
+	const Location parsed = driver.chunks()[0]->location();
+
+	const bool atEnd = region.last == children.size();
+	if (children.size() - (region.last - region.first) + statements.size() == 0)
+		return false;
+	/* the end of the chunk (its last semicolon) is only known from the parsed statements */
+	if (atEnd && statements.empty() && region.first != region.last)
+		return false;
+	if (!statements.empty() && ((!atEnd && isLastStatement(*statements.back()))
+		|| (region.first != 0 && isLastStatement(*children[region.first - 1]))))
+		return false;
+	/* a chunk starts with the first token of its first statement */
+	if (region.first == 0 && statements.empty() && !hasExactBegin(*children[region.last]))
+		return false;
+
+	const bool replaced = !statements.empty();
+	const uint32_t chunkEnd = chunk.location().end;
+	const uint32_t regionEnd = atEnd && replaced ? parsed.end : end;
+	if (delta != 0 || regionEnd != region.end)
+		LocationShifter{region.end, delta, regionEnd}.dispatch(*m_chunk);
+
+	children.erase(children.begin() + region.first, children.begin() + region.last);
+	children.insert(children.begin() + region.first, std::make_move_iterator(statements.begin()), std::make_move_iterator(statements.end()));
+
+	/* an empty root chunk has no location yet */
+	if (region.first == 0) {
+		chunk.m_location.file = m_file;
+		chunk.m_location.begin = replaced ? parsed.begin : children.front()->location().begin;
+	}
+	if (atEnd && replaced && chunkEnd <= region.end)
+		chunk.m_location.end = parsed.end;
+
+	return true;
+}
+
+int IncrementalParser::parseAll()
+{
+	m_chunk.reset();
+
+	Driver driver;
+	driver.setErrorStream(m_errorStream);
+	driver.useNativeLexer(m_nativeLexer);
+	driver.setLazyFunctions(m_lazyFunctions);
+
+	const int result = driver.parseRange(m_file, 0, m_text.size());
+	if (result == 0)
+		m_chunk = std::move(driver.chunks()[0]);
+
+	return result;
+}
+
+void IncrementalParser::updateSource()
+{
+	if (m_text.size() > UINT32_MAX)
+		FATAL("Input is too large, locations are limited to 4 GiB\n");
+
+	m_session.sourceFile(m_file).setText(m_text.data(), m_text.size());
+}
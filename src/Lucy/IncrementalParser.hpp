@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "AST_fwd.hpp"
+#include "Location.hpp"
+
+class AnalysisSession;
+
+/* replacement of bytes [begin, end) of a text */
+struct TextEdit {
+	uint32_t begin;
+	uint32_t end;
+	std::string_view replacement;
+};
+
+/*
+ * Text of a source file and its tree kept in sync across edits, for editors
+ * and other interactive use. An edit reparses only the statements it touches
+ * in the innermost block enclosing it and splices the new statements in place
+ * of the old ones, shifting the locations of the nodes following them. Edits
+ * which could change the tokens or the statements around that run fall back
+ * to parsing the whole text, as does any edit of a text which did not parse.
+ *
+ * The tree and the source file belong to the session current at construction,
+ * the parser has to be used in that session only.
+ */
+class IncrementalParser {
+public:
+	explicit IncrementalParser(const std::string &filename);
+	IncrementalParser(const IncrementalParser &) = delete;
+	void operator = (const IncrementalParser &) = delete;
+	~IncrementalParser();
+
+	/* replaces the whole text, 0 on success like Driver::parse() */
+	int parse(std::string text);
+	int edit(const TextEdit &edit);
+
+	/* the single edit turning from into to, the bytes between their common prefix and suffix */
+	static TextEdit diff(std::string_view from, std::string_view to);
+
+	const std::string & text() const { return m_text; }
+	/* tree of the current text, nullptr if it does not parse */
+	const AST::Chunk * chunk() const { return m_chunk.get(); }
+	FileId file() const { return m_file; }
+	/* whether the last edit was handled without parsing the whole text */
+	bool lastEditIncremental() const { return m_incremental; }
+
+	void setErrorStream(std::ostream *os) { m_errorStream = os; }
+	/* like Driver::setLazyFunctions(), skipped bodies can be parsed only while the parser holds the text */
+	void setLazyFunctions(bool enable) { m_lazyFunctions = enable; }
+	void useNativeLexer(bool enable) { m_nativeLexer = enable; }
+
+private:
+	class EnclosingChunks;
+	class LocationShifter;
+
+	/* statements [first, last) of chunk, spanning bytes [begin, end) of the text before an edit */
+	struct Region {
+		AST::Chunk *chunk;
+		size_t first;
+		size_t last;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	bool findRegion(const TextEdit &edit, Region &region) const;
+	bool findRegionIn(AST::Chunk &chunk, const TextEdit &edit, Region &region) const;
+	bool reparse(const Region &region, int64_t delta);
+	int parseAll();
+	void updateSource();
+
+	AnalysisSession &m_session;
+	std::string m_text;
+	std::unique_ptr <AST::Chunk> m_chunk;
+	FileId m_file;
+	std::ostream *m_errorStream;
+	bool m_lazyFunctions = false;
+	bool m_nativeLexer = false;
+	bool m_incremental = false;
+};
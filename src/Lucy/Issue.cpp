@@ -123,3 +123,21 @@ UpperCase::operator std::string() const
 }
 
 } //namespace Issue::GlobalStore
+
+namespace Issue::Table {
+
+DuplicateKey::operator std::string() const
+{
+	std::ostringstream ss;
+	ss << *this << " : duplicate key " << m_key << " in table constructor, the first one is at " << m_firstLocation;
+	return ss.str();
+}
+
+NilValue::operator std::string() const
+{
+	std::ostringstream ss;
+	ss << *this << " : nil value in table constructor, the field is not stored";
+	return ss.str();
+}
+
+} //namespace Issue::Table
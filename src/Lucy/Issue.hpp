@@ -1,8 +1,8 @@
 #pragma once
 
 #include <variant>
-#include "location.hh"
 #include "EnumHelpers.hpp"
+#include "Location.hpp"
 
 namespace Issue {
 
@@ -23,62 +23,59 @@ EnumClass(Type, uint32_t,
 	GlobalStore_FunctionScope,
 	GlobalStore_GlobalScope,
 	GlobalStore_Underscore,
-	GlobalStore_UpperCase
+	GlobalStore_UpperCase,
+
+	Table_DuplicateKey,
+	Table_NilValue
 );
 
 class BaseIssue {
 public:
 	Type type() const { return m_type; }
-	const yy::location & location() const { return m_location; }
+	const FileLocation & location() const { return m_location; }
 
 	bool operator < (const BaseIssue &other) const
 	{
 		if (m_type.value() != other.m_type.value())
 			return m_type.value() < other.m_type.value();
 
-		auto positionCmp = [](const yy::position &a, const yy::position &b) -> int
+		auto filename = [](const FileLocation &location) -> const std::string &
 		{
-			const std::string &filenameA = a.filename ? *a.filename : std::string{""};
-			const std::string &filenameB = b.filename ? *b.filename : std::string{""};
-
-			const int filenameCmp = filenameA.compare(filenameB);
-			if (filenameCmp != 0)
-				return filenameCmp;
-			if (a.line != b.line)
-				return a.line - b.line;
-			if (a.column != b.column)
-				return a.column - b.column;
-
-			return 0;
+			static const std::string none;
+			return location.file && location.file->filename() ? *location.file->filename() : none;
 		};
 
-		const int cmp = positionCmp(m_location.begin, other.m_location.begin);
-		if (cmp != 0)
-			return cmp < 0;
+		//offsets in a file are ordered like their lines and columns
+		const int filenameCmp = filename(m_location).compare(filename(other.m_location));
+		if (filenameCmp != 0)
+			return filenameCmp < 0;
+		if (m_location.begin != other.m_location.begin)
+			return m_location.begin < other.m_location.begin;
 
-		return positionCmp(m_location.end, other.m_location.end) < 0;
+		return m_location.end < other.m_location.end;
 	}
 
 protected:
-	BaseIssue(Type t, const yy::location &location) : m_type{t}, m_location{location} {}
+	/* resolved only when printed, the source file keeps its line index for it */
+	BaseIssue(Type t, const Location &location) : m_type{t}, m_location{location} {}
 
 	virtual explicit operator std::string() const = 0;
 
 private:
 	Type m_type;
-	yy::location m_location;
+	FileLocation m_location;
 };
 
 class EmptyChunk : public BaseIssue {
 public:
-	EmptyChunk(const yy::location &location) : BaseIssue{Type::EmptyChunk, location} {}
+	EmptyChunk(const Location &location) : BaseIssue{Type::EmptyChunk, location} {}
 
 	explicit operator std::string() const override;
 };
 
 class GlobalFunctionDefinition : public BaseIssue {
 public:
-	GlobalFunctionDefinition(const yy::location &location, const std::string &fnName)
+	GlobalFunctionDefinition(const Location &location, const std::string &fnName)
 		: BaseIssue{Type::GlobalFunctionDefinition, location}, m_fnName{fnName} {}
 
 	explicit operator std::string() const override;
@@ -89,14 +86,14 @@ private:
 
 class ShadowingDefinition : public BaseIssue {
 public:
-	ShadowingDefinition(const yy::location &location, const std::string &varName, const yy::location &varLocation)
+	ShadowingDefinition(const Location &location, const std::string &varName, const Location &varLocation)
 		: BaseIssue{Type::ShadowingDefinition, location}, m_varName{varName}, m_varLocation{varLocation} {}
 
 	explicit operator std::string() const override;
 
 private:
 	std::string m_varName;
-	yy::location m_varLocation;
+	FileLocation m_varLocation;
 };
 
 } //namespace Issue
@@ -105,7 +102,7 @@ namespace Issue::Function {
 
 class DuplicateParam : public BaseIssue {
 public:
-	DuplicateParam(const yy::location &location, const std::string &paramName)
+	DuplicateParam(const Location &location, const std::string &paramName)
 		: BaseIssue{Type::Function_DuplicateParam, location}, m_paramName{paramName} {}
 
 	explicit operator std::string() const override;
@@ -116,35 +113,35 @@ private:
 
 class DuplicateParamSelf : public BaseIssue {
 public:
-	DuplicateParamSelf(const yy::location &location) : BaseIssue{Type::Function_DuplicateParamSelf, location} {}
+	DuplicateParamSelf(const Location &location) : BaseIssue{Type::Function_DuplicateParamSelf, location} {}
 
 	explicit operator std::string() const override;
 };
 
 class EllipsisShadowsParam : public BaseIssue {
 public:
-	EllipsisShadowsParam(const yy::location &location) : BaseIssue{Type::Function_EllipsisShadowsParam, location} {}
+	EllipsisShadowsParam(const Location &location) : BaseIssue{Type::Function_EllipsisShadowsParam, location} {}
 
 	explicit operator std::string() const override;
 };
 
 class EmptyDefinition : public BaseIssue {
 public:
-	EmptyDefinition(const yy::location &location) : BaseIssue{Type::Function_EmptyDefinition, location} {}
+	EmptyDefinition(const Location &location) : BaseIssue{Type::Function_EmptyDefinition, location} {}
 
 	explicit operator std::string() const override;
 };
 
 class FallthroughNoResult : public BaseIssue {
 public:
-	FallthroughNoResult(const yy::location &location) : BaseIssue{Type::Function_FallthroughNoResult, location} {}
+	FallthroughNoResult(const Location &location) : BaseIssue{Type::Function_FallthroughNoResult, location} {}
 
 	explicit operator std::string() const override;
 };
 
 class UnusedParam : public BaseIssue {
 public:
-	UnusedParam(const yy::location &location, const std::string &paramName)
+	UnusedParam(const Location &location, const std::string &paramName)
 		: BaseIssue{Type::Function_UnusedParam, location}, m_paramName{paramName} {}
 
 	explicit operator std::string() const override;
@@ -155,14 +152,14 @@ private:
 
 class UnusedParamUnderscore : public BaseIssue {
 public:
-	UnusedParamUnderscore(const yy::location &location) : BaseIssue{Type::Function_UnusedParamUnderscore, location} {}
+	UnusedParamUnderscore(const Location &location) : BaseIssue{Type::Function_UnusedParamUnderscore, location} {}
 
 	explicit operator std::string() const override;
 };
 
 class VariableResultCount : public BaseIssue {
 public:
-	VariableResultCount(const yy::location &location, unsigned retValCnt, unsigned retValAltCnt)
+	VariableResultCount(const Location &location, unsigned retValCnt, unsigned retValAltCnt)
 		: BaseIssue{Type::Function_VariableResultCount, location}, m_retValCnt{retValCnt}, m_retValAltCnt{retValAltCnt} {}
 
 	explicit operator std::string() const override;
@@ -178,7 +175,7 @@ namespace Issue::GlobalStore {
 
 class FunctionScope : public BaseIssue {
 public:
-	FunctionScope(const yy::location &location, const std::string &varName)
+	FunctionScope(const Location &location, const std::string &varName)
 		: BaseIssue{Type::GlobalStore_FunctionScope, location}, m_varName{varName} {}
 
 	explicit operator std::string() const override;
@@ -189,7 +186,7 @@ private:
 
 class GlobalScope : public BaseIssue {
 public:
-	GlobalScope(const yy::location &location, const std::string &varName)
+	GlobalScope(const Location &location, const std::string &varName)
 		: BaseIssue{Type::GlobalStore_GlobalScope, location}, m_varName{varName} {}
 
 	explicit operator std::string() const override;
@@ -200,14 +197,14 @@ private:
 
 class Underscore : public BaseIssue {
 public:
-	Underscore(const yy::location &location) : BaseIssue{Type::GlobalStore_Underscore, location} {}
+	Underscore(const Location &location) : BaseIssue{Type::GlobalStore_Underscore, location} {}
 
 	explicit operator std::string() const override;
 };
 
 class UpperCase : public BaseIssue {
 public:
-	UpperCase(const yy::location &location, const std::string &varName)
+	UpperCase(const Location &location, const std::string &varName)
 		: BaseIssue{Type::GlobalStore_UpperCase, location}, m_varName{varName} {}
 
 	explicit operator std::string() const override;
@@ -218,6 +215,29 @@ private:
 
 } //namespace Issue::GlobalStore
 
+namespace Issue::Table {
+
+class DuplicateKey : public BaseIssue {
+public:
+	DuplicateKey(const Location &location, const std::string &key, const Location &firstLocation)
+		: BaseIssue{Type::Table_DuplicateKey, location}, m_key{key}, m_firstLocation{firstLocation} {}
+
+	explicit operator std::string() const override;
+
+private:
+	std::string m_key;
+	FileLocation m_firstLocation;
+};
+
+class NilValue : public BaseIssue {
+public:
+	NilValue(const Location &location) : BaseIssue{Type::Table_NilValue, location} {}
+
+	explicit operator std::string() const override;
+};
+
+} //namespace Issue::Table
+
 using IssueVariant = std::variant <
 	Issue::EmptyChunk,
 	Issue::GlobalFunctionDefinition,
@@ -233,4 +253,6 @@ using IssueVariant = std::variant <
 	Issue::GlobalStore::FunctionScope,
 	Issue::GlobalStore::GlobalScope,
 	Issue::GlobalStore::Underscore,
-	Issue::GlobalStore::UpperCase>;
+	Issue::GlobalStore::UpperCase,
+	Issue::Table::DuplicateKey,
+	Issue::Table::NilValue>;
@@ -0,0 +1,625 @@
+#include <array>
+#include <charconv>
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+#include <string_view>
+
+#include "ByteScan.hpp"
+#include "Driver.hpp"
+#include "Lexer.hpp"
+#include "Logger.hpp"
+
+namespace {
+
+using Token = yy::Parser::token;
+
+enum CharClass : uint8_t {
+	IdStart = 1,
+	IdChar = 2,
+	Digit = 4,
+	HexDigit = 8,
+	Space = 16,
+};
+
+constexpr std::array <uint8_t, 256> makeCharTable()
+{
+	std::array <uint8_t, 256> table{};
+
+	for (unsigned c = 'a'; c <= 'z'; ++c)
+		table[c] = IdStart | IdChar;
+	for (unsigned c = 'A'; c <= 'Z'; ++c)
+		table[c] = IdStart | IdChar;
+	table['_'] = IdStart | IdChar;
+
+	for (unsigned c = '0'; c <= '9'; ++c)
+		table[c] = IdChar | Digit | HexDigit;
+	for (unsigned c = 'a'; c <= 'f'; ++c)
+		table[c] |= HexDigit;
+	for (unsigned c = 'A'; c <= 'F'; ++c)
+		table[c] |= HexDigit;
+
+	for (unsigned char c : {' ', '\t', '\r', '\n'})
+		table[c] = Space;
+
+	return table;
+}
+
+constexpr auto CharTable = makeCharTable();
+
+inline bool is(char c, uint8_t charClass)
+{
+	return CharTable[static_cast<unsigned char>(c)] & charClass;
+}
+
+struct Keyword {
+	std::string_view text;
+	Token::token_kind_type kind;
+};
+
+constexpr Keyword Keywords[] = {
+	{"and", Token::AND},
+	{"break", Token::BREAK},
+	{"do", Token::DO},
+	{"else", Token::ELSE},
+	{"elseif", Token::ELSEIF},
+	{"end", Token::END},
+	{"false", Token::FALSE},
+	{"for", Token::FOR},
+	{"function", Token::FUNCTION},
+	{"if", Token::IF},
+	{"in", Token::IN},
+	{"local", Token::LOCAL},
+	{"nil", Token::NIL},
+	{"not", Token::NOT},
+	{"or", Token::OR},
+	{"repeat", Token::REPEAT},
+	{"return", Token::RETURN},
+	{"then", Token::THEN},
+	{"true", Token::TRUE},
+	{"until", Token::UNTIL},
+	{"while", Token::WHILE},
+};
+
+constexpr size_t KeywordTableSize = 64;
+
+constexpr size_t keywordHash(std::string_view s)
+{
+	return (s.front() * 3 + s.back() * 13 + s.size()) % KeywordTableSize;
+}
+
+constexpr std::array <Keyword, KeywordTableSize> makeKeywordTable()
+{
+	std::array <Keyword, KeywordTableSize> table{};
+	for (const auto &keyword : Keywords)
+		table[keywordHash(keyword.text)] = keyword;
+	return table;
+}
+
+constexpr auto KeywordTable = makeKeywordTable();
+
+constexpr bool isPerfectHash()
+{
+	size_t used = 0;
+	for (const auto &keyword : KeywordTable)
+		used += !keyword.text.empty();
+	return used == std::size(Keywords);
+}
+
+static_assert(isPerfectHash(), "keyword hash has collisions");
+
+} //namespace
+
+void Lexer::reset(const char *begin, const char *end)
+{
+	m_p = begin;
+	m_end = end;
+}
+
+yy::Parser::symbol_type Lexer::token()
+{
+	while (m_p != m_end) {
+		const char *start = m_p;
+
+		switch (*m_p) {
+			case ' ':
+			case '\t':
+			case '\r':
+			case '\n':
+				while (m_p != m_end && is(*m_p, Space))
+					++m_p;
+				m_driver.step(m_p - start);
+				continue;
+			case '-':
+				if (m_end - m_p > 1 && m_p[1] == '-') {
+					shortComment();
+					continue;
+				}
+				++m_p;
+				return yy::Parser::make_MINUS(m_driver.location(1u));
+			case '"':
+			case '\'':
+				return quotedString();
+			case '[':
+				if (m_end - m_p > 1 && m_p[1] == '[')
+					return longString();
+				++m_p;
+				return yy::Parser::make_LBRACKET(m_driver.location(1u));
+			case '.':
+				if (m_end - m_p > 1 && is(m_p[1], Digit))
+					return number();
+				if (m_end - m_p > 2 && m_p[1] == '.' && m_p[2] == '.') {
+					m_p += 3;
+					return yy::Parser::make_ELLIPSIS(m_driver.location(3u));
+				}
+				if (m_end - m_p > 1 && m_p[1] == '.') {
+					m_p += 2;
+					return yy::Parser::make_CONCAT(m_driver.location(2u));
+				}
+				++m_p;
+				return yy::Parser::make_DOT(m_driver.location(1u));
+			case '=':
+				if (m_end - m_p > 1 && m_p[1] == '=') {
+					m_p += 2;
+					return yy::Parser::make_EQ(m_driver.location(2u));
+				}
+				++m_p;
+				return yy::Parser::make_ASSIGN(m_driver.location(1u));
+			case '~':
+				if (m_end - m_p > 1 && m_p[1] == '=') {
+					m_p += 2;
+					return yy::Parser::make_NE(m_driver.location(2u));
+				}
+				unrecognized();
+			case '<':
+				if (m_end - m_p > 1 && m_p[1] == '=') {
+					m_p += 2;
+					return yy::Parser::make_LE(m_driver.location(2u));
+				}
+				++m_p;
+				return yy::Parser::make_LT(m_driver.location(1u));
+			case '>':
+				if (m_end - m_p > 1 && m_p[1] == '=') {
+					m_p += 2;
+					return yy::Parser::make_GE(m_driver.location(2u));
+				}
+				++m_p;
+				return yy::Parser::make_GT(m_driver.location(1u));
+			case '+':
+				++m_p;
+				return yy::Parser::make_PLUS(m_driver.location(1u));
+			case '*':
+				++m_p;
+				return yy::Parser::make_MUL(m_driver.location(1u));
+			case '/':
+				++m_p;
+				return yy::Parser::make_DIV(m_driver.location(1u));
+			case '%':
+				++m_p;
+				return yy::Parser::make_MOD(m_driver.location(1u));
+			case '^':
+				++m_p;
+				return yy::Parser::make_POWER(m_driver.location(1u));
+			case '#':
+				++m_p;
+				return yy::Parser::make_HASH(m_driver.location(1u));
+			case '(':
+				++m_p;
+				return yy::Parser::make_LPAREN(m_driver.location(1u));
+			case ')':
+				++m_p;
+				return yy::Parser::make_RPAREN(m_driver.location(1u));
+			case ']':
+				++m_p;
+				return yy::Parser::make_RBRACKET(m_driver.location(1u));
+			case '{':
+				++m_p;
+				return yy::Parser::make_LBRACE(m_driver.location(1u));
+			case '}':
+				++m_p;
+				return yy::Parser::make_RBRACE(m_driver.location(1u));
+			case ',':
+				++m_p;
+				return yy::Parser::make_COMMA(m_driver.location(1u));
+			case ';':
+				++m_p;
+				return yy::Parser::make_SEMICOLON(m_driver.location(1u));
+			case ':':
+				++m_p;
+				return yy::Parser::make_COLON(m_driver.location(1u));
+			default:
+				if (is(*m_p, Digit))
+					return number();
+				if (is(*m_p, IdStart))
+					return identifier();
+				unrecognized();
+		}
+	}
+
+	return yy::Parser::make_END_OF_INPUT(m_driver.location());
+}
+
+yy::Parser::symbol_type Lexer::identifier()
+{
+	const char *start = m_p;
+	while (m_p != m_end && is(*m_p, IdChar))
+		++m_p;
+
+	const std::string_view text{start, static_cast<size_t>(m_p - start)};
+	const auto location = m_driver.location(text.size());
+
+	const auto &keyword = KeywordTable[keywordHash(text)];
+	if (keyword.text == text)
+		return yy::Parser::symbol_type{keyword.kind, location};
+
+	return yy::Parser::make_ID(m_driver.symbols().intern(text), location);
+}
+
+/*
+ * Same forms as accepted by the flex scanner: hexadecimal and decimal integers
+ * (saturating like strtol) and decimals with a dot but no exponent.
+ */
+yy::Parser::symbol_type Lexer::number()
+{
+	const char *start = m_p;
+
+	if (*m_p == '0' && m_end - m_p > 2 && (m_p[1] == 'x' || m_p[1] == 'X') && is(m_p[2], HexDigit)) {
+		m_p += 2;
+		while (m_p != m_end && is(*m_p, HexDigit))
+			++m_p;
+
+		long value;
+		if (std::from_chars(start + 2, m_p, value, 16).ec != std::errc{})
+			value = LONG_MAX;
+		return yy::Parser::make_INT_VALUE(value, m_driver.location(m_p - start));
+	}
+
+	while (m_p != m_end && is(*m_p, Digit))
+		++m_p;
+
+	if (m_p == m_end || *m_p != '.') {
+		long value;
+		if (std::from_chars(start, m_p, value).ec != std::errc{})
+			value = LONG_MAX;
+		return yy::Parser::make_INT_VALUE(value, m_driver.location(m_p - start));
+	}
+
+	++m_p;
+	while (m_p != m_end && is(*m_p, Digit))
+		++m_p;
+
+	double value;
+	if (std::from_chars(start, m_p, value).ec != std::errc{})
+		value = std::strtod(std::string{start, m_p}.c_str(), nullptr);
+	return yy::Parser::make_REAL_VALUE(value, m_driver.location(m_p - start));
+}
+
+yy::Parser::symbol_type Lexer::quotedString()
+{
+	const char delim = *m_p;
+	const char *p = m_p + 1;
+
+	//an escape needs a character other than newline, as '.' in flex patterns
+	while ((p = ByteScan::findFirstOf(p, m_end, '\\', delim)) != m_end && *p != delim) {
+		if (m_end - p < 2 || p[1] == '\n')
+			unrecognized();
+		p += 2;
+	}
+
+	if (p == m_end)
+		unrecognized();
+
+	const char *start = m_p;
+	m_p = p + 1;
+
+	return yy::Parser::make_STRING_VALUE(std::string_view{start + 1, static_cast<size_t>(p - start - 1)}, m_driver.location(m_p - start));
+}
+
+yy::Parser::symbol_type Lexer::longString()
+{
+	const uint32_t start = m_driver.offset();
+	m_p += 2;
+
+	const char *content = m_p;
+	while (m_p != m_end) {
+		const char *p = ByteScan::findFirstOf(m_p, m_end, ']');
+		m_p = p;
+
+		if (p == m_end)
+			break;
+
+		if (m_end - p < 2) {
+			++m_p;
+		} else if (p[1] == ']') {
+			m_p += 2;
+			m_driver.step(m_p - content + 2);
+			return yy::Parser::make_STRING_VALUE(std::string_view{content, static_cast<size_t>(p - content)}, m_driver.locationFrom(start));
+		} else {
+			m_p += 2;
+		}
+	}
+
+	m_driver.step(m_p - content + 2);
+
+	//unfinished long string is silently dropped
+	return yy::Parser::make_END_OF_INPUT(m_driver.location());
+}
+
+void Lexer::shortComment()
+{
+	const char *bracket = m_p + 2;
+	if (bracket != m_end && *bracket == '[') {
+		const char *p = bracket + 1;
+		while (p != m_end && *p == '=')
+			++p;
+
+		if (p != m_end && *p == '[') {
+			longComment(p - bracket - 1);
+			return;
+		}
+	}
+
+	const char *p = ByteScan::findFirstOf(m_p, m_end, '\n');
+	if (p != m_end)
+		++p;
+
+	m_driver.step(p - m_p);
+	m_p = p;
+}
+
+void Lexer::longComment(unsigned level)
+{
+	const uint32_t start = m_driver.offset();
+	const char *begin = m_p;
+	m_p += level + 4;
+
+	while (m_p != m_end) {
+		const char *p = ByteScan::findFirstOf(m_p, m_end, ']');
+		if (p == m_end)
+			break;
+
+		m_p = p + 1;
+		const char *close = m_p;
+		while (close != m_end && *close == '=')
+			++close;
+
+		if (close != m_end && *close == ']' && static_cast<unsigned>(close - m_p) == level) {
+			m_p = close + 1;
+			m_driver.step(m_p - begin);
+			return;
+		}
+	}
+
+	std::ostringstream ss;
+	ss << '[' << m_driver.locationFrom(start).resolve().begin << "] Unfinished long comment\n";
+	m_driver.logError(ss.str());
+	Logger::abort();
+}
+
+void Lexer::unrecognized()
+{
+	std::ostringstream ss;
+	ss << '[' << m_driver.location() << "] Unrecognized input token: '";
+	if (*m_p != '\0')
+		ss << *m_p;
+	ss << "'\n";
+	m_driver.logError(ss.str());
+	Logger::abort();
+}
+
+namespace {
+
+/*
+ * Walks the code in [p, end) without producing tokens, skipping whitespace,
+ * strings, numbers and comments the way Lexer::token() does. Identifiers are
+ * passed to visit(kind, begin, next) as their keyword kind or Token::ID,
+ * strings as Token::STRING_VALUE, numbers as Token::INT_VALUE and any other
+ * character as Token::YYUNDEF. Returns the position past the item visit()
+ * returned true for, end if there is none, nullptr if a string or a comment
+ * is not terminated.
+ */
+template <typename Visitor>
+const char * scanCode(const char *p, const char *end, Visitor &&visit)
+{
+	while (p != end) {
+		const char *start = p;
+		Token::token_kind_type kind = Token::YYUNDEF;
+
+		if (is(*p, Space)) {
+			++p;
+			continue;
+		} else if (is(*p, IdStart)) {
+			while (p != end && is(*p, IdChar))
+				++p;
+
+			const std::string_view text{start, static_cast<size_t>(p - start)};
+			const auto &keyword = KeywordTable[keywordHash(text)];
+			kind = keyword.text == text ? keyword.kind : Token::ID;
+		} else if (is(*p, Digit)) {
+			//numbers end where number() ends them, "1end" is a number followed by a keyword
+			if (*p == '0' && end - p > 2 && (p[1] == 'x' || p[1] == 'X') && is(p[2], HexDigit)) {
+				p += 2;
+				while (p != end && is(*p, HexDigit))
+					++p;
+			} else {
+				while (p != end && is(*p, Digit))
+					++p;
+				if (p != end && *p == '.') {
+					++p;
+					while (p != end && is(*p, Digit))
+						++p;
+				}
+			}
+			kind = Token::INT_VALUE;
+		} else if (*p == '"' || *p == '\'') {
+			const char delim = *p++;
+			while ((p = ByteScan::findFirstOf(p, end, '\\', delim)) != end && *p != delim) {
+				if (end - p < 2 || p[1] == '\n')
+					return nullptr;
+				p += 2;
+			}
+
+			if (p == end)
+				return nullptr;
+			++p;
+			kind = Token::STRING_VALUE;
+		} else if (*p == '[' && end - p > 1 && p[1] == '[') {
+			p += 2;
+			for (;;) {
+				p = ByteScan::findFirstOf(p, end, ']');
+				if (end - p < 2)
+					return nullptr;
+				if (p[1] == ']')
+					break;
+				++p;
+			}
+			p += 2;
+			kind = Token::STRING_VALUE;
+		} else if (*p == '-' && end - p > 1 && p[1] == '-') {
+			//long comments as in shortComment() and longComment()
+			const char *bracket = p + 2;
+			const char *open = bracket;
+			if (open != end && *open == '[') {
+				++open;
+				while (open != end && *open == '=')
+					++open;
+			}
+
+			if (bracket == end || *bracket != '[' || open == end || *open != '[') {
+				p = ByteScan::findFirstOf(p, end, '\n');
+				continue;
+			}
+
+			const size_t level = open - bracket - 1;
+			p = open + 1;
+			for (;;) {
+				p = ByteScan::findFirstOf(p, end, ']');
+				if (p == end)
+					return nullptr;
+
+				const char *close = ++p;
+				while (close != end && *close == '=')
+					++close;
+
+				if (close != end && *close == ']' && static_cast<size_t>(close - p) == level) {
+					p = close + 1;
+					break;
+				}
+			}
+			continue;
+		} else {
+			++p;
+		}
+
+		if (visit(kind, start, p))
+			return p;
+	}
+
+	return end;
+}
+
+} //namespace
+
+const char * Lexer::skipBlock(const char *begin, const char *end)
+{
+	unsigned depth = 1;
+	bool closed = false;
+
+	const char *p = scanCode(begin, end, [&depth, &closed](Token::token_kind_type kind, const char *, const char *)
+	{
+		switch (kind) {
+			case Token::FUNCTION:
+			case Token::DO:
+			case Token::IF:
+			case Token::REPEAT:
+				++depth;
+				return false;
+			case Token::END:
+			case Token::UNTIL:
+				if (--depth != 0)
+					return false;
+				closed = kind == Token::END;
+				return true;
+			default:
+				return false;
+		}
+	});
+
+	return closed ? p : nullptr;
+}
+
+std::vector <uint32_t> Lexer::splitPoints(const char *begin, const char *end, unsigned parts)
+{
+	std::vector <uint32_t> result;
+	if (parts < 2)
+		return result;
+
+	const size_t size = end - begin;
+	int blocks = 0;
+	int brackets = 0;
+	Token::token_kind_type previous = Token::YYUNDEF;
+	//a "function" at the top level, a statement if a name follows
+	const char *function = nullptr;
+
+	auto split = [&result, begin, size, parts](const char *p)
+	{
+		if (static_cast<size_t>(p - begin) >= size * (result.size() + 1) / parts)
+			result.push_back(p - begin);
+	};
+
+	scanCode(begin, end, [&](Token::token_kind_type kind, const char *start, const char *)
+	{
+		const bool topLevel = blocks == 0 && brackets == 0;
+
+		if (function && kind == Token::ID)
+			split(function);
+		function = nullptr;
+
+		switch (kind) {
+			case Token::FUNCTION:
+				//"local function" is split at "local" already
+				if (topLevel && previous != Token::LOCAL)
+					function = start;
+				++blocks;
+				break;
+			case Token::DO:
+			case Token::IF:
+			case Token::REPEAT:
+				++blocks;
+				break;
+			case Token::END:
+			case Token::UNTIL:
+				--blocks;
+				break;
+			case Token::LOCAL:
+				if (topLevel)
+					split(start);
+				break;
+			case Token::RETURN:
+			case Token::BREAK:
+				//nothing may follow the last statement of the file, a part of it would hide that
+				if (topLevel)
+					return true;
+				break;
+			case Token::YYUNDEF:
+				if (*start == '(' || *start == '[' || *start == '{')
+					++brackets;
+				else if (*start == ')' || *start == ']' || *start == '}')
+					--brackets;
+				break;
+			default:
+				break;
+		}
+
+		//unbalanced code is left to the parser of the whole file
+		if (blocks < 0 || brackets < 0) {
+			result.clear();
+			return true;
+		}
+
+		previous = kind;
+		return result.size() + 1 == parts;
+	});
+
+	return result;
+}
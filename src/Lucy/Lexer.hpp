@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Parser.hpp"
+
+class Driver;
+
+/*
+ * Hand-written alternative to the flex generated Scanner, producing the same
+ * tokens with the same locations. It works directly on a contiguous buffer:
+ * characters are classified by a lookup table, keywords are recognized by a
+ * perfect hash and locations advance by token length without rescanning it.
+ */
+class Lexer {
+public:
+	Lexer(Driver &driver) : m_driver{driver} {}
+	Lexer(const Lexer &) = delete;
+	void operator = (const Lexer &) = delete;
+	~Lexer() = default;
+
+	void reset(const char *begin, const char *end);
+	yy::Parser::symbol_type token();
+
+	/*
+	 * Pre-scan of the block starting at begin (a function body) for the end
+	 * keyword closing it, without producing tokens: "function", "do", "if" and
+	 * "repeat" open nested blocks, "end" and "until" close them, strings and
+	 * comments are skipped as token() skips them. Returns the position past the
+	 * closing "end", nullptr if there is none or a string or a comment before
+	 * it is not terminated. Unrecognized input is reported by the parse of the
+	 * block.
+	 */
+	static const char * skipBlock(const char *begin, const char *end);
+
+	/*
+	 * Pre-scan of a whole file for up to parts - 1 offsets splitting it into
+	 * parts of about the same size. Every part but the first starts with a
+	 * "local" or a named "function" statement outside of any block or
+	 * brackets, so the parts parse as chunks of their own. There are fewer
+	 * offsets if there are not enough such statements or the file ends early
+	 * with a top-level "return", none if its blocks are not balanced.
+	 */
+	static std::vector <uint32_t> splitPoints(const char *begin, const char *end, unsigned parts);
+
+private:
+	yy::Parser::symbol_type identifier();
+	yy::Parser::symbol_type number();
+	yy::Parser::symbol_type quotedString();
+	yy::Parser::symbol_type longString();
+	void shortComment();
+	void longComment(unsigned level);
+	[[noreturn]] void unrecognized();
+
+	Driver &m_driver;
+	const char *m_p = nullptr;
+	const char *m_end = nullptr;
+};
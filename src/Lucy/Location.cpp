@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cassert>
+
+#include "AnalysisSession.hpp"
+#include "ByteScan.hpp"
+#include "Location.hpp"
+
+std::ostream & operator << (std::ostream &os, const SourcePosition &pos)
+{
+	if (pos.filename)
+		os << *pos.filename << ':';
+	return os << pos.line << '.' << pos.column;
+}
+
+std::ostream & operator << (std::ostream &os, const SourceRange &range)
+{
+	const SourcePosition &begin = range.begin, &end = range.end;
+	const unsigned endColumn = end.column > 0 ? end.column - 1 : 0;
+
+	os << begin;
+	if (end.filename && (!begin.filename || *begin.filename != *end.filename))
+		os << '-' << *end.filename << ':' << end.line << '.' << endColumn;
+	else if (begin.line < end.line)
+		os << '-' << end.line << '.' << endColumn;
+	else if (begin.column < endColumn)
+		os << '-' << endColumn;
+
+	return os;
+}
+
+SourceRange Location::resolve() const
+{
+	if (file == NoFile)
+		return SourceRange{};
+
+	const SourceFile &source = AnalysisSession::current().sourceFile(file);
+	return SourceRange{source.position(begin), source.position(end)};
+}
+
+std::ostream & operator << (std::ostream &os, const Location &location)
+{
+	return os << location.resolve();
+}
+
+FileLocation::FileLocation(const Location &location)
+	: begin{location.begin}, end{location.end}
+{
+	if (location.file == NoFile)
+		return;
+
+	file = &AnalysisSession::current().sourceFile(location.file);
+	file->retainLineIndex();
+}
+
+SourceRange FileLocation::resolve() const
+{
+	if (!file)
+		return SourceRange{};
+
+	return SourceRange{file->position(begin), file->position(end)};
+}
+
+std::ostream & operator << (std::ostream &os, const FileLocation &location)
+{
+	return os << location.resolve();
+}
+
+SourceFile::SourceFile(const std::string *filename, const char *text, size_t size)
+	: m_filename{filename}, m_text{text}, m_size{size}
+{
+}
+
+SourcePosition SourceFile::position(uint32_t offset) const
+{
+	if (m_lineStarts.empty())
+		buildLineIndex();
+
+	const auto next = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), offset);
+	const unsigned line = next - m_lineStarts.begin();
+	return SourcePosition{m_filename, line, offset - next[-1] + 1};
+}
+
+void SourceFile::releaseText(bool keepIndex)
+{
+	if (keepIndex)
+		retainLineIndex();
+
+	m_text = nullptr;
+}
+
+void SourceFile::retainLineIndex() const
+{
+	if (m_lineStarts.empty())
+		buildLineIndex();
+}
+
+void SourceFile::setText(const char *text, size_t size)
+{
+	m_text = text;
+	m_size = size;
+	m_lineStarts.clear();
+}
+
+void SourceFile::buildLineIndex() const
+{
+	assert(m_text || m_size == 0);
+
+	const char *end = m_text + m_size;
+	m_lineStarts.reserve(ByteScan::count(m_text, end, '\n') + 1);
+	m_lineStarts.push_back(0);
+
+	for (const char *p = m_text; (p = ByteScan::findFirstOf(p, end, '\n')) != end; ++p)
+		m_lineStarts.push_back(p + 1 - m_text);
+}
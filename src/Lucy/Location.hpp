@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* index of a SourceFile in the current AnalysisSession, NoFile for synthetic nodes */
+using FileId = uint32_t;
+constexpr FileId NoFile = 0;
+
+/* line and column (both 1-based) in a named file, the form used for printing */
+struct SourcePosition {
+	const std::string *filename = nullptr;
+	unsigned line = 1;
+	unsigned column = 1;
+
+	friend bool operator == (const SourcePosition &a, const SourcePosition &b)
+	{
+		return a.filename == b.filename && a.line == b.line && a.column == b.column;
+	}
+	friend bool operator != (const SourcePosition &a, const SourcePosition &b) { return !(a == b); }
+};
+
+struct SourceRange {
+	SourcePosition begin;
+	SourcePosition end;
+};
+
+/* same format as locations generated by bison: "file:1.5-9", "file:1.5-2.3" */
+std::ostream & operator << (std::ostream &os, const SourcePosition &pos);
+std::ostream & operator << (std::ostream &os, const SourceRange &range);
+
+/*
+ * Location of a token or an AST node, a range [begin, end) of byte offsets in
+ * a source file of the current AnalysisSession. Lines and columns are computed
+ * only when the location is resolved (to be printed or stored in an issue).
+ */
+struct Location {
+	FileId file = NoFile;
+	uint32_t begin = 0;
+	uint32_t end = 0;
+
+	SourceRange resolve() const;
+
+	friend bool operator == (const Location &a, const Location &b)
+	{
+		return a.file == b.file && a.begin == b.begin && a.end == b.end;
+	}
+	friend bool operator != (const Location &a, const Location &b) { return !(a == b); }
+};
+
+std::ostream & operator << (std::ostream &os, const Location &location);
+
+/* lines [first, last] of a file, both 1-based */
+struct LineRange {
+	unsigned first;
+	unsigned last;
+};
+
+/*
+ * Text of a parsed file with an index of line starts, built on the first
+ * resolved location. The text is owned by the Driver and is released with it,
+ * locations resolved later need the index to be built before that.
+ */
+class SourceFile {
+public:
+	SourceFile(const std::string *filename, const char *text, size_t size);
+	SourceFile(const SourceFile &) = delete;
+	void operator = (const SourceFile &) = delete;
+
+	const std::string * filename() const { return m_filename; }
+	const char * text() const { return m_text; }
+	size_t size() const { return m_size; }
+	SourcePosition position(uint32_t offset) const;
+	void releaseText(bool keepIndex);
+	/* builds the index while the text is still there, for locations resolved after its release */
+	void retainLineIndex() const;
+	/* the text has been edited, the index is rebuilt for the new text (also for issues found before) */
+	void setText(const char *text, size_t size);
+
+private:
+	void buildLineIndex() const;
+
+	const std::string *m_filename;
+	const char *m_text;
+	size_t m_size;
+	mutable std::vector <uint32_t> m_lineStarts;
+};
+
+/*
+ * Location bound to its SourceFile instead of a FileId, so it can be resolved
+ * without the session that parsed the file. Issues keep their locations in
+ * this form and resolve them only when printed, also after the text has been
+ * released or their session has been merged into another one.
+ */
+struct FileLocation {
+	FileLocation() = default;
+	FileLocation(const Location &location);
+
+	const SourceFile *file = nullptr;
+	uint32_t begin = 0;
+	uint32_t end = 0;
+
+	SourceRange resolve() const;
+};
+
+std::ostream & operator << (std::ostream &os, const FileLocation &location);
@@ -1,5 +1,4 @@
-#include <fstream>
-
+#include "AnalysisSession.hpp"
 #include "Logger.hpp"
 
 Logger::Logger()
@@ -19,6 +18,9 @@ Logger::Logger()
 	setFlag(Issue::Type::GlobalStore_UpperCase);
 
 	setFlag(Issue::Type::ShadowingDefinition);
+
+	setFlag(Issue::Type::Table_DuplicateKey);
+	setFlag(Issue::Type::Table_NilValue);
 }
 
 bool Logger::isEnabled(Issue::Type issue)
@@ -28,18 +30,33 @@ bool Logger::isEnabled(Issue::Type issue)
 
 void Logger::setOutput(const std::string &filename)
 {
-	static std::ofstream output;
-
-	std::ofstream tmp{filename};
-	if (tmp.fail())
+	auto output = std::make_unique<std::ofstream>(filename);
+	if (output->fail())
 		FATAL("Unable to open file for writing: " << filename << '\n');
 
-	output = std::move(tmp);
-	instance().m_output = &output;
+	auto &logger = instance();
+	logger.m_outputFile = std::move(output);
+	logger.m_output = logger.m_outputFile.get();
+}
+
+[[noreturn]] void Logger::abort()
+{
+	log() << std::flush;
+
+	if (AnalysisSession::isActive())
+		throw AnalysisSession::Aborted{};
+
+	::exit(1);
+}
+
+void Logger::copySettings(const Logger &other)
+{
+	m_flags = other.m_flags;
+	m_output = other.m_output;
+	m_threshold = other.m_threshold;
 }
 
 Logger & Logger::instance()
 {
-	static Logger obj;
-	return obj;
+	return AnalysisSession::current().m_logger;
 }
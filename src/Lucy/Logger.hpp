@@ -1,13 +1,23 @@
 #pragma once
 
 #include <array>
+#include <fstream>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <vector>
 
 #include "Bitfield.hpp"
 #include "Issue.hpp"
 
+class AnalysisSession;
+
+/*
+ * Every AnalysisSession owns its own Logger, the static interface below
+ * always operates on the logger of the current session.
+ */
 class Logger {
+	friend class AnalysisSession;
 public:
 	enum : unsigned {
 		Fatal = 0,
@@ -30,6 +40,8 @@ public:
 	static void setOutput(std::ostream &os) { instance().m_output = &os; }
 	static void setThreshold(unsigned threshold) { instance().m_threshold = threshold; }
 
+	[[noreturn]] static void abort();
+
 	static std::ostream & indent(std::ostream &os, unsigned level)
 	{
 		for (unsigned i = 0; i != level; ++i)
@@ -48,8 +60,11 @@ private:
 	void setFlag(Issue::Type issue) { m_flags.set(issue.value()); }
 	void unsetFlag(Issue::Type issue) { m_flags.unset(issue.value()); }
 
+	void copySettings(const Logger &other);
+
 	Bitfield <Issue::Type::_size> m_flags;
 	std::ostream *m_output = &std::cerr;
+	std::unique_ptr <std::ofstream> m_outputFile;
 	unsigned m_threshold = std::numeric_limits<unsigned>::max();
 	std::vector <IssueVariant> m_issues;
 };
@@ -63,7 +78,7 @@ private:
 #define FATAL(msg) \
 	do { \
 		Logger::log() << '[' << __FILE__ << ':' << __LINE__ << "] " << msg; \
-		::exit(1); \
+		Logger::abort(); \
 	} while (false)
 
 template <typename IssueType, typename ...Ts>
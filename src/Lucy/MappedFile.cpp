@@ -0,0 +1,48 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MappedFile.hpp"
+
+bool MappedFile::open(const std::string &filename)
+{
+	close();
+
+	const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+
+	m_size = st.st_size;
+	if (m_size == 0) {
+		//empty files cannot be mapped, there is nothing to read anyway
+		::close(fd);
+		return true;
+	}
+
+	void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		m_size = 0;
+		return false;
+	}
+
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	m_data = static_cast<const char *>(data);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+		munmap(const_cast<char *>(m_data), m_size);
+
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Read-only memory mapping of a whole file. Files which cannot be mapped
+ * (pipes, special files) make open() fail, the caller is expected to fall back
+ * to ordinary stream input.
+ */
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	void operator = (const MappedFile &) = delete;
+	~MappedFile() { close(); }
+
+	bool open(const std::string &filename);
+	void close();
+
+	const char * data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const char *m_data = nullptr;
+	size_t m_size = 0;
+};
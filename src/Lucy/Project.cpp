@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include "AnalysisSession.hpp"
+#include "AST.hpp"
+#include "ASTCache.hpp"
+#include "Config.hpp"
+#include "ControlFlowGraph.hpp"
+#include "DataValidator.hpp"
+#include "Driver.hpp"
+#include "IncrementalParser.hpp"
+#include "Logger.hpp"
+#include "Project.hpp"
+#include "Scope.hpp"
+
+namespace {
+	std::string readFile(const std::string &filename)
+	{
+		std::ifstream input{filename, std::ios::binary};
+		if (input.fail())
+			FATAL("Unable to open file for reading: " << filename << '\n');
+
+		return std::string{std::istreambuf_iterator<char>{input}, std::istreambuf_iterator<char>{}};
+	}
+}
+
+Project::Project(const Config &conf)
+	: m_conf{conf}
+{
+	if (!m_conf.astCacheDir.empty())
+		m_cache = std::make_unique<ASTCache>(m_conf.astCacheDir, uint64_t{m_conf.astCacheSize} << 20);
+}
+
+Project::~Project() = default;
+
+void Project::addFileList(std::istream &input)
+{
+	std::string path;
+	while (std::getline(input, path, '\0')) {
+		if (!path.empty())
+			addPath(path);
+	}
+}
+
+void Project::addPath(const std::string &path)
+{
+	namespace fs = std::filesystem;
+
+	std::error_code ec;
+	if (!fs::is_directory(path, ec)) {
+		m_files.push_back(path);
+		return;
+	}
+
+	std::vector <std::string> found;
+	for (fs::recursive_directory_iterator iter{path, ec}, end; !ec && iter != end; iter.increment(ec)) {
+		if (iter->is_regular_file(ec) && iter->path().extension() == ".lua")
+			found.emplace_back(iter->path().string());
+	}
+
+	if (ec)
+		FATAL("Unable to read directory: " << path << " (" << ec.message() << ")\n");
+
+	std::sort(found.begin(), found.end());
+	std::move(found.begin(), found.end(), std::back_inserter(m_files));
+}
+
+int Project::run()
+{
+	const int result = analyzeAll();
+
+	if (m_cache)
+		m_cache->evict();
+
+	return result;
+}
+
+int Project::analyzeAll()
+{
+	if (m_files.empty()) {
+		if (!m_conf.editFrom.empty())
+			FATAL("--edit-from needs input files\n");
+		if (!m_conf.stdinName.empty())
+			return analyzeBuffer(m_conf.stdinName);
+
+		Driver driver;
+		driver.setErrorStream(&Logger::log());
+		return analyze(driver);
+	}
+
+	if (!m_conf.stdinName.empty())
+		FATAL("--stdin-name accepts no input files\n");
+	if (!m_conf.graphvizOutput.empty() && m_files.size() != 1)
+		FATAL("--graphviz accepts a single input file only\n");
+
+	unsigned jobs = m_conf.jobs ? m_conf.jobs : std::thread::hardware_concurrency();
+	if (m_conf.getOpt(Config::Option::DumpAST) || m_conf.getOpt(Config::Option::DumpIR) || m_conf.getOpt(Config::Option::DumpSSA)
+		|| m_conf.getOpt(Config::Option::DumpTokens))
+		jobs = 1;
+	jobs = std::clamp<size_t>(jobs, 1, m_files.size());
+
+	if (jobs != 1)
+		return runParallel(jobs);
+
+	/* the same sink as in runParallel(), driver errors and issues of a file go to the log together */
+	auto &parent = AnalysisSession::current();
+	int result = 0;
+	for (const auto &filename : m_files) {
+		AnalysisSession session;
+		std::ostringstream log;
+		session.inheritSettings(parent);
+		session.setOutput(log);
+		result |= analyzeFile(session, filename, &log);
+
+		Logger::log() << log.str() << std::flush;
+		parent.merge(session);
+	}
+
+	return result;
+}
+
+int Project::analyzeBuffer(const std::string &filename) const
+{
+	const std::string input{std::istreambuf_iterator<char>{std::cin}, std::istreambuf_iterator<char>{}};
+
+	auto &parent = AnalysisSession::current();
+	AnalysisSession session;
+	session.inheritSettings(parent);
+
+	AnalysisResult result = session.analyze(filename, input.data(), input.size());
+	parent.merge(session, std::move(result.issues));
+	return result.status;
+}
+
+int Project::analyzeFile(AnalysisSession &session, const std::string &filename, std::ostream *errorStream) const
+{
+	return session.run([this, &filename, errorStream]
+	{
+		if (!m_conf.editFrom.empty())
+			return analyzeEdited(filename, errorStream);
+
+		Driver driver;
+		driver.setErrorStream(errorStream);
+		driver.setInputFile(filename);
+		return analyze(driver);
+	});
+}
+
+int Project::analyze(Driver &driver) const
+{
+	driver.useNativeLexer(m_conf.getOpt(Config::Option::NativeLexer));
+	driver.setLazyFunctions(m_conf.getOpt(Config::Option::LazyFunctions));
+	driver.setParseJobs(m_conf.parseJobs);
+	driver.setCache(m_cache.get());
+
+	if (m_conf.getOpt(Config::Option::DumpTokens)) {
+		driver.dumpTokens(std::cout);
+		std::cout << std::flush;
+		return 0;
+	}
+
+	//dumps and graphs need the tree, data files have nothing else to analyze
+	const bool needTree = m_conf.getOpt(Config::Option::DumpAST) || m_conf.getOpt(Config::Option::DumpIR) || m_conf.getOpt(Config::Option::DumpSSA)
+		|| !m_conf.graphvizOutput.empty();
+	if (!needTree && m_conf.dataFiles != Config::DataFiles::Never) {
+		switch (DataValidator{driver, m_conf.dataFiles == Config::DataFiles::Always}.validate()) {
+			case DataValidator::Result::Valid:
+				return 0;
+			case DataValidator::Result::Invalid:
+				return 1;
+			case DataValidator::Result::NotData:
+				break;
+		}
+	}
+
+	if (driver.parse() != 0)
+		return 1;
+
+	assert(driver.chunks().size() == 1);
+	return analyze(*driver.chunks()[0]);
+}
+
+int Project::analyzeEdited(const std::string &filename, std::ostream *errorStream) const
+{
+	IncrementalParser parser{filename};
+	parser.setErrorStream(errorStream);
+	parser.setLazyFunctions(m_conf.getOpt(Config::Option::LazyFunctions));
+	parser.useNativeLexer(m_conf.getOpt(Config::Option::NativeLexer));
+
+	if (parser.parse(readFile(m_conf.editFrom)) != 0)
+		return 1;
+
+	const std::string text = readFile(filename);
+	if (parser.edit(IncrementalParser::diff(parser.text(), text)) != 0)
+		return 1;
+
+	/* the option tests the incremental path, falling back to a full parse defeats it */
+	if (!parser.lastEditIncremental()) {
+		if (errorStream)
+			*errorStream << filename << " : the edit from " << m_conf.editFrom << " needs a full parse\n";
+		return 1;
+	}
+
+	return analyze(*parser.chunk());
+}
+
+int Project::analyze(const AST::Chunk &chunk) const
+{
+	if (m_conf.getOpt(Config::Option::DumpAST)) {
+		chunk.print();
+		std::cout << std::flush;
+	}
+
+	Scope globalScope;
+	ControlFlowGraph cfg{chunk, globalScope};
+
+	if (m_conf.getOpt(Config::Option::DumpIR)) {
+		cfg.irDump();
+		std::cout << std::flush;
+	}
+
+	if (m_conf.getOpt(Config::Option::DumpSSA)) {
+		cfg.ssaDump();
+		std::cout << std::flush;
+	}
+
+	if (!m_conf.graphvizOutput.empty())
+		cfg.graphvizDump(m_conf.graphvizOutput);
+
+	return 0;
+}
+
+int Project::runParallel(unsigned jobs)
+{
+	/*
+	 * Every file is analyzed in its own session which collects the log, the
+	 * main thread then merges the sessions in the order of input files.
+	 */
+	struct FileResult {
+		std::unique_ptr <AnalysisSession> session;
+		std::string log;
+		int status = 0;
+		bool done = false;
+	};
+
+	auto &parent = AnalysisSession::current();
+	std::vector <FileResult> results(m_files.size());
+	std::atomic <size_t> nextFile{0};
+	std::mutex resultMutex;
+	std::condition_variable resultReady;
+
+	auto worker = [this, &parent, &results, &nextFile, &resultMutex, &resultReady]
+	{
+		for (size_t idx = nextFile++; idx < m_files.size(); idx = nextFile++) {
+			auto session = std::make_unique<AnalysisSession>();
+			std::ostringstream log;
+			session->inheritSettings(parent);
+			session->setOutput(log);
+
+			const int status = analyzeFile(*session, m_files[idx], &log);
+
+			{
+				std::lock_guard <std::mutex> lock{resultMutex};
+				results[idx].session = std::move(session);
+				results[idx].log = log.str();
+				results[idx].status = status;
+				results[idx].done = true;
+			}
+			resultReady.notify_one();
+		}
+	};
+
+	std::vector <std::thread> workers;
+	workers.reserve(jobs);
+	for (unsigned i = 0; i != jobs; ++i)
+		workers.emplace_back(worker);
+
+	int result = 0;
+	for (auto &fileResult : results) {
+		std::unique_lock <std::mutex> lock{resultMutex};
+		resultReady.wait(lock, [&fileResult] { return fileResult.done; });
+		auto session = std::move(fileResult.session);
+		const std::string log = std::move(fileResult.log);
+		result |= fileResult.status;
+		lock.unlock();
+
+		Logger::log() << log << std::flush;
+		parent.merge(*session);
+	}
+
+	for (auto &w : workers)
+		w.join();
+
+	return result;
+}
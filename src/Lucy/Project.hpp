@@ -0,0 +1,44 @@
+#pragma once
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AST_fwd.hpp"
+
+class AnalysisSession;
+class ASTCache;
+struct Config;
+class Driver;
+
+class Project {
+public:
+	Project(const Config &conf);
+	Project(const Project &) = delete;
+	void operator = (const Project &) = delete;
+	~Project();
+
+	void addFileList(std::istream &input);
+	void addPath(const std::string &path);
+
+	bool empty() const { return m_files.empty(); }
+	const std::vector <std::string> & files() const { return m_files; }
+
+	int run();
+
+private:
+	int analyze(Driver &driver) const;
+	int analyze(const AST::Chunk &chunk) const;
+	int analyzeAll();
+	/* analyzes standard input read into memory by AnalysisSession::analyze(), as embedders do */
+	int analyzeBuffer(const std::string &filename) const;
+	/* parses conf.editFrom and edits it into filename with an IncrementalParser */
+	int analyzeEdited(const std::string &filename, std::ostream *errorStream) const;
+	int analyzeFile(AnalysisSession &session, const std::string &filename, std::ostream *errorStream) const;
+	int runParallel(unsigned jobs);
+
+	const Config &m_conf;
+	std::vector <std::string> m_files;
+	std::unique_ptr <ASTCache> m_cache;
+};
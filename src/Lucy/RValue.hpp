@@ -1,35 +1,26 @@
 #pragma once
 
-#include <iosfwd>
-#include <string_view>
-#include <variant>
+#include <cstdint>
 
-#include "AST_fwd.hpp"
 #include "EnumHelpers.hpp"
-#include "ValueVariant.hpp"
-
-namespace IR {
-	class Triplet;
-}
 
+/*
+ * Operand of an IR triplet, a handle into the IR::Code of its function: an
+ * index of a constant, of a variable or of the triplet whose result it is,
+ * or the number of a virtual register. Constant 0 is nil.
+ */
 struct RValue {
-	EnumClass(Type, unsigned, Immediate, LValue, Temporary);
-
-	static const AST::LValue * getTemporary(unsigned idx);
-	static RValue nil() { return ValueVariant{nullptr}; }
+	EnumClass(Type, uint8_t, Immediate, LValue, Temporary, Register);
 
-	RValue() = default;
-	RValue(const ValueVariant &imm) : valueRef{imm} {}
-	RValue(const AST::LValue *lval) : valueRef{lval} {}
-	RValue(const IR::Triplet *temp) : valueRef{temp} {}
+	static constexpr RValue nil() { return RValue{}; }
 
-	Type type() const { return static_cast<Type>(valueRef.index()); }
+	constexpr RValue() = default;
+	constexpr RValue(Type type, uint32_t index) : m_type{type}, m_index{index} {}
 
-	const ValueVariant & getImmediate() const { return std::get<Type::Immediate>(valueRef); }
-	const AST::LValue * getLValue() const { return std::get<Type::LValue>(valueRef); }
-	const IR::Triplet * getTemporary() const { return std::get<Type::Temporary>(valueRef); }
+	Type type() const { return m_type; }
+	uint32_t index() const { return m_index; }
 
-	std::variant <ValueVariant, const AST::LValue *, const IR::Triplet *> valueRef;
+private:
+	Type m_type = Type::Immediate;
+	uint32_t m_index = 0;
 };
-
-std::ostream & operator << (std::ostream &os, const RValue &rval);
@@ -1,5 +1,420 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+#include "AST.hpp"
+#include "ControlFlowGraph.hpp"
+#include "Fold.hpp"
+#include "IR.hpp"
+#include "Logger.hpp"
 #include "SSA.hpp"
 
 namespace SSA {
 
+namespace {
+	bool isNil(RValue rval)
+	{
+		return rval.type() == RValue::Type::Immediate && rval.index() == 0;
+	}
+
+	/* the second operand of these is left unset (nil), it is no operand */
+	bool hasOneOperand(IR::Op op)
+	{
+		return IR::isUnaryOp(op) || anyOf(op, IR::Op::Push, IR::Op::Return, IR::Op::Jump);
+	}
+}
+
+Context::Context(const ControlFlowGraph &cfg)
+	: m_cfg{cfg}, m_code{cfg.code()}, m_values(1), m_replacedBy(1), m_tripletValues(m_code.size(), NoValue),
+	m_registerCount{m_code.registerCount()}, m_currentDef(cfg.blockCount()), m_unfilledPredecessors(cfg.blockCount()),
+	m_sealed(cfg.blockCount()), m_incompletePhis(cfg.blockCount()), m_phis(cfg.blockCount())
+{
+	for (BlockId block : cfg.reversePostorder())
+		forEachPredecessor(block, [this, block](BlockId) { ++m_unfilledPredecessors[block]; });
+
+	for (BlockId block : cfg.reversePostorder()) {
+		if (!m_sealed[block] && m_unfilledPredecessors[block] == 0)
+			seal(block);
+
+		fill(block);
+
+		for (BlockId next : cfg.block(block).nextBlock) {
+			if (next == BasicBlock::NoBlock)
+				continue;
+			assert(m_unfilledPredecessors[next] != 0);
+			if (--m_unfilledPredecessors[next] == 0 && !m_sealed[next])
+				seal(next);
+		}
+	}
+
+	finish();
+}
+
+template <typename F>
+void Context::forEachPredecessor(BlockId block, F &&f) const
+{
+	/* edges from unreachable blocks are never filled */
+	for (BlockId pred : m_cfg.block(block).predecessors) {
+		if (m_cfg.rpoNumber(pred) != ControlFlowGraph::NoOrder)
+			f(pred);
+	}
+}
+
+void Context::fill(BlockId block)
+{
+	const IR::Range range = m_cfg.block(block).irCode;
+	/* results of a call are popped right after it */
+	UID lastCall = NoValue;
+
+	for (uint32_t idx = range.first; idx != range.end(); ++idx) {
+		const IR::Triplet &t = m_code[idx];
+		const auto [lhs, rhs] = t.operands;
+
+		switch (t.operation.value()) {
+			case IR::Op::Assign:
+			case IR::Op::Pop:
+			case IR::Op::TableCtor: {
+				//a table constructor has an operand only for a constant table
+				UID source = NoValue;
+				if (t.operation == IR::Op::Pop)
+					source = lastCall;
+				else if (t.operation == IR::Op::Assign || !isNil(rhs))
+					source = use(rhs, block, idx);
+				const uint32_t target = anyOf(lhs.type(), RValue::Type::LValue, RValue::Type::Register) ? variable(lhs) : NoVariable;
+				m_tripletValues[idx] = newValue(Triplet{t.operation, idx, {NoValue, source}, target});
+				if (target != NoVariable)
+					writeVariable(target, block, m_tripletValues[idx]);
+				break;
+			}
+
+			default: {
+				const UID first = use(lhs, block, idx);
+				const UID second = hasOneOperand(t.operation) ? NoValue : use(rhs, block, idx);
+				m_tripletValues[idx] = newValue(Triplet{t.operation, idx, {first, second}});
+				if (anyOf(t.operation, IR::Op::Call, IR::Op::CallUnknownResults))
+					lastCall = m_tripletValues[idx];
+				break;
+			}
+		}
+	}
+}
+
+void Context::seal(BlockId block)
+{
+	for (UID phi : m_incompletePhis[block])
+		addPhiOperands(phi);
+	m_incompletePhis[block].clear();
+	m_sealed[block] = true;
+}
+
+UID Context::use(RValue rval, BlockId block, uint32_t idx)
+{
+	switch (rval.type().value()) {
+		case RValue::Type::Immediate: {
+			const ValueVariant &value = m_code.constant(rval);
+			if (const auto *ref = std::get_if<TableReference>(&value)) {
+				const UID table = use(ref->first, block, idx);
+				const UID key = use(ref->second, block, idx);
+				return newValue(Triplet{IR::Op::TableIndex, idx, {table, key}});
+			}
+
+			return newValue(Constant{rval});
+		}
+		case RValue::Type::LValue:
+		case RValue::Type::Register:
+			return readVariable(variable(rval), block);
+		case RValue::Type::Temporary:
+			return m_tripletValues[rval.index()];
+	}
+
+	return NoValue;
+}
+
+uint32_t Context::variable(RValue rval)
+{
+	if (rval.type() == RValue::Type::Register)
+		return rval.index();
+
+	const AST::LValue &lval = *m_code.variable(rval);
+	const uint32_t idx = m_registerCount + m_names.size();
+
+	if (const VarAccess *declaration = m_cfg.declaration(lval)) {
+		auto [it, inserted] = m_declarationIndex.emplace(declaration, idx);
+		if (!inserted)
+			return it->second;
+	} else {
+		if (const uint32_t *known = m_nameIndex.find(lval.name()))
+			return *known;
+		m_nameIndex[lval.name()] = idx;
+	}
+
+	m_names.push_back({lval.name(), m_spellings[lval.name()]++});
+	return idx;
+}
+
+void Context::writeVariable(uint32_t variable, BlockId block, UID value)
+{
+	m_currentDef[block][variable] = value;
+}
+
+UID Context::readVariable(uint32_t variable, BlockId block)
+{
+	std::vector <PendingPhi> pending;
+	const UID value = findDefinition(variable, block, pending);
+	return completePhis(variable, value, pending);
+}
+
+UID Context::findDefinition(uint32_t variable, BlockId block, std::vector <PendingPhi> &pending)
+{
+	/* blocks with a single predecessor take its definition, long chains of them are walked without recursion */
+	std::vector <BlockId> chain;
+	UID value = NoValue;
+
+	for (;;) {
+		if (auto def = m_currentDef[block].find(variable); def != m_currentDef[block].end()) {
+			value = resolve(def->second);
+			break;
+		}
+
+		if (!m_sealed[block]) {
+			value = newPhi(variable, block);
+			m_incompletePhis[block].push_back(value);
+			break;
+		}
+
+		std::vector <BlockId> predecessors;
+		forEachPredecessor(block, [&predecessors](BlockId pred) { predecessors.push_back(pred); });
+
+		if (predecessors.empty()) {
+			if (variable >= m_initial.size())
+				m_initial.resize(variable + 1, NoValue);
+			if (m_initial[variable] == NoValue)
+				m_initial[variable] = newValue(Initial{variable});
+			value = m_initial[variable];
+			break;
+		}
+
+		if (predecessors.size() == 1) {
+			chain.push_back(block);
+			block = predecessors[0];
+			continue;
+		}
+
+		/* the phi is defined before reading its operands, so loops end at it */
+		const UID phi = newPhi(variable, block);
+		writeVariable(variable, block, phi);
+		chain.push_back(block);
+		pending.push_back({phi, std::move(predecessors), std::move(chain)});
+		return phi;
+	}
+
+	writeVariable(variable, block, value);
+	for (BlockId b : chain)
+		writeVariable(variable, b, value);
+	return value;
+}
+
+UID Context::completePhis(uint32_t variable, UID value, std::vector <PendingPhi> &pending)
+{
+	/* operands found to be phis as well are completed first, on the stack instead of by recursion */
+	while (!pending.empty()) {
+		const size_t top = pending.size() - 1;
+		const size_t operandCount = std::get<Phi>(m_values[pending[top].phi]).operands.size();
+
+		if (operandCount != pending[top].predecessors.size()) {
+			const UID operand = findDefinition(variable, pending[top].predecessors[operandCount], pending);
+			if (pending.size() == top + 1)
+				std::get<Phi>(m_values[pending[top].phi]).operands.push_back(operand);
+			continue;
+		}
+
+		value = tryRemoveTrivialPhi(pending[top].phi);
+		for (BlockId b : pending[top].chain)
+			writeVariable(variable, b, value);
+		pending.pop_back();
+
+		if (!pending.empty())
+			std::get<Phi>(m_values[pending.back().phi]).operands.push_back(value);
+	}
+
+	return value;
+}
+
+UID Context::newValue(Entry &&entry)
+{
+	m_values.push_back(std::move(entry));
+	m_replacedBy.push_back(NoValue);
+	return m_values.size() - 1;
+}
+
+UID Context::newPhi(uint32_t variable, BlockId block)
+{
+	const UID phi = newValue(Phi{block, variable, {}});
+	m_phis[block].push_back(phi);
+	return phi;
+}
+
+UID Context::addPhiOperands(UID phi)
+{
+	const BlockId block = std::get<Phi>(m_values[phi]).block;
+
+	std::vector <PendingPhi> pending(1);
+	pending[0].phi = phi;
+	forEachPredecessor(block, [&pending](BlockId pred) { pending[0].predecessors.push_back(pred); });
+	return completePhis(std::get<Phi>(m_values[phi]).variable, phi, pending);
+}
+
+UID Context::tryRemoveTrivialPhi(UID phi)
+{
+	UID same = NoValue;
+	for (UID &op : std::get<Phi>(m_values[phi]).operands) {
+		op = resolve(op);
+		if (op == same || op == phi)
+			continue;
+		if (same != NoValue)
+			return phi;
+		same = op;
+	}
+
+	/* only references to itself, the phi is in a loop not entered from the entry */
+	if (same == NoValue)
+		return phi;
+
+	m_replacedBy[phi] = same;
+	return same;
+}
+
+UID Context::resolve(UID value)
+{
+	UID result = value;
+	while (m_replacedBy[result] != NoValue)
+		result = m_replacedBy[result];
+
+	while (value != result) {
+		const UID next = m_replacedBy[value];
+		m_replacedBy[value] = result;
+		value = next;
+	}
+
+	return result;
+}
+
+void Context::finish()
+{
+	/*
+	 * Removing a phi can make the phis using it trivial. Users are not
+	 * tracked, so the remaining phis are checked again until nothing changes.
+	 */
+	for (bool changed = true; changed; ) {
+		changed = false;
+		for (const auto &phis : m_phis) {
+			for (UID phi : phis) {
+				if (m_replacedBy[phi] == NoValue && tryRemoveTrivialPhi(phi) != phi)
+					changed = true;
+			}
+		}
+	}
+
+	for (auto &phis : m_phis) {
+		phis.erase(std::remove_if(phis.begin(), phis.end(), [this](UID phi) { return m_replacedBy[phi] != NoValue; }), phis.end());
+		for (UID phi : phis) {
+			for (UID &op : std::get<Phi>(m_values[phi]).operands)
+				op = resolve(op);
+		}
+	}
+
+	for (Entry &entry : m_values) {
+		if (auto *triplet = std::get_if<Triplet>(&entry)) {
+			for (UID &ref : triplet->ssaRef)
+				ref = resolve(ref);
+		}
+	}
+}
+
+void Context::printVariable(std::ostream &os, uint32_t variable) const
+{
+	if (variable < m_registerCount) {
+		os << "tmp_" << variable;
+	} else {
+		const Name &name = m_names[variable - m_registerCount];
+		os << name.name;
+		if (name.shadowed)
+			os << '#' << name.shadowed;
+	}
+}
+
+void Context::printValue(std::ostream &os, UID value) const
+{
+	if (value == NoValue) {
+		os << "nil";
+		return;
+	}
+
+	if (const auto *constant = std::get_if<Constant>(&m_values[value]))
+		m_code.print(os, constant->value);
+	else
+		os << 'v' << value;
+}
+
+void Context::dump(std::ostream &os, unsigned indent) const
+{
+	/* values of variables on entry first, then the blocks in the order they were filled */
+	bool first = true;
+	for (UID value : m_initial) {
+		if (value == NoValue)
+			continue;
+		Logger::indent(os, indent) << 'v' << value << " = entry ";
+		printVariable(os, std::get<Initial>(m_values[value]).variable);
+		os << '\n';
+		first = false;
+	}
+
+	for (BlockId block : m_cfg.reversePostorder()) {
+		if (!first)
+			os << '\n';
+		first = false;
+
+		const std::string label = m_cfg.label(block);
+		Logger::indent(os, indent) << '[' << label << "]\n";
+
+		for (UID phi : m_phis[block]) {
+			const Phi &p = std::get<Phi>(m_values[phi]);
+			Logger::indent(os, indent + 1) << 'v' << phi << " = phi ";
+			printVariable(os, p.variable);
+			for (UID op : p.operands) {
+				os << ' ';
+				printValue(os, op);
+			}
+			os << '\n';
+		}
+
+		const IR::Range range = m_cfg.block(block).irCode;
+		for (uint32_t idx = range.first; idx != range.end(); ++idx) {
+			const UID value = m_tripletValues[idx];
+			const Triplet &t = std::get<Triplet>(m_values[value]);
+			Logger::indent(os, indent + 1) << 'v' << value << " = " << t.operation;
+
+			for (unsigned i = 0; i != t.ssaRef.size(); ++i) {
+				if (t.ssaRef[i] == NoValue)
+					continue;
+				os << ' ';
+				/* argument and result counts of calls as IR::Code::print() gives them */
+				if (t.operation == IR::Op::Call && i == 1) {
+					const long argResultCnt = std::get<long>(m_code.constant(m_code[idx].operands[1]));
+					os << ((argResultCnt >> 16) & 0xffff) << ' ' << (argResultCnt & 0xffff);
+				} else {
+					printValue(os, t.ssaRef[i]);
+				}
+			}
+			if (t.variable != NoVariable) {
+				os << " -> ";
+				printVariable(os, t.variable);
+			}
+			os << '\n';
+		}
+
+		Logger::indent(os, indent) << "[/" << label << "]\n";
+	}
+}
+
 } //namespace SSA
@@ -1,31 +1,154 @@
 #pragma once
 
 #include <array>
-#include <map>
+#include <iosfwd>
+#include <unordered_map>
+#include <variant>
 #include <vector>
+
+#include "BasicBlock.hpp"
 #include "IROp.hpp"
+#include "RValue.hpp"
 #include "Serial.hpp"
-#include "ValueVariant.hpp"
+#include "Symbol.hpp"
+
+class ControlFlowGraph;
+class VarAccess;
 
-class BasicBlock;
+namespace IR {
+	class Code;
+}
 
 namespace SSA {
 
+/* values are numbered from 1, NoValue stands for missing operands */
+static constexpr UID NoValue = Serial::EmptyUid;
+
+/* immediate operand of the IR (nil included) other than a table reference */
+struct Constant {
+	RValue value;
+};
+
+/* value of a variable on entry of the function: a parameter, an upvalue or a global */
+struct Initial {
+	uint32_t variable;
+};
+
+/* variable of triplets not defining one */
+static constexpr uint32_t NoVariable = UINT32_MAX;
+
+/*
+ * Result (or effect) of triplet index of the IR. The first operand of
+ * assignments, pops and table constructors is the variable they define, so
+ * its ssaRef is NoValue; the second one of a pop is the call it takes a
+ * result of, of a table constructor the constant table if it has one. Table references are given as TableIndex values of their parts.
+ */
 struct Triplet {
 	IR::Op operation;
+	uint32_t index;
 	std::array <UID, 2> ssaRef;
+	uint32_t variable = NoVariable;
 };
 
-using Phi = std::vector <UID>;
+/* value of variable at the start of block, operands come from its predecessors in their order */
+struct Phi {
+	BlockId block;
+	uint32_t variable;
+	std::vector <UID> operands;
+};
 
-using Entry = std::variant <ValueVariant, std::string, Triplet, Phi>;
+using Entry = std::variant <Constant, Initial, Triplet, Phi>;
 
+/*
+ * SSA form of the IR of one ControlFlowGraph, built by the algorithm of Braun
+ * et al. ("Simple and Efficient Construction of Static Single Assignment
+ * Form"): blocks are filled in reverse postorder, reads of a variable look
+ * for its definition through the predecessors and place phis where they
+ * meet. A block is sealed once all of its predecessors are filled, with the
+ * reverse postorder only loop headers (the targets of the back edges set up
+ * by BasicBlock::setLoopFooter) are left, their phis are completed when the
+ * end of the loop is filled. Trivial phis are replaced by their single
+ * operand.
+ *
+ * Variables are the virtual registers and the names of the function. Locals
+ * are keyed by their declaration (ControlFlowGraph::declaration()), globals
+ * and parameters by SymbolId. Assignments are the only definitions, calls are
+ * not assumed to change globals or captured locals.
+ */
 class Context {
 public:
+	Context(const ControlFlowGraph &cfg);
+	Context(const Context &) = delete;
+	void operator = (const Context &) = delete;
+	~Context() = default;
+
+	const Entry & operator [] (UID value) const { return m_values[value]; }
+	size_t size() const { return m_values.size(); }
+
+	/* value of triplet idx of the IR, NoValue for triplets of unreachable blocks */
+	UID tripletValue(uint32_t idx) const { return m_tripletValues[idx]; }
+	const std::vector <UID> & phis(BlockId block) const { return m_phis[block]; }
+
+	void dump(std::ostream &os, unsigned indent = 0) const;
 
 private:
-	Serial m_opCnt;
-	std::map <std::pair <BasicBlock *, std::string>, UID> m_currentState;
+	void fill(BlockId block);
+	void seal(BlockId block);
+	template <typename F> void forEachPredecessor(BlockId block, F &&f) const;
+
+	UID use(RValue rval, BlockId block, uint32_t idx);
+	uint32_t variable(RValue rval);
+	void writeVariable(uint32_t variable, BlockId block, UID value);
+	UID readVariable(uint32_t variable, BlockId block);
+
+	/* phi of readVariable() whose operands are read from its predecessors */
+	struct PendingPhi {
+		UID phi;
+		std::vector <BlockId> predecessors;
+		/* blocks the phi was written to, they get the value replacing it */
+		std::vector <BlockId> chain;
+	};
+	UID findDefinition(uint32_t variable, BlockId block, std::vector <PendingPhi> &pending);
+	UID completePhis(uint32_t variable, UID value, std::vector <PendingPhi> &pending);
+
+	UID newValue(Entry &&entry);
+	UID newPhi(uint32_t variable, BlockId block);
+	UID addPhiOperands(UID phi);
+	UID tryRemoveTrivialPhi(UID phi);
+	UID resolve(UID value);
+	void finish();
+
+	void printValue(std::ostream &os, UID value) const;
+	void printVariable(std::ostream &os, uint32_t variable) const;
+
+	const ControlFlowGraph &m_cfg;
+	const IR::Code &m_code;
+
+	std::vector <Entry> m_values;
+	/* phis found trivial, resolve() follows them to the value replacing them */
+	std::vector <UID> m_replacedBy;
+	std::vector <UID> m_tripletValues;
+
+	/* registers are variables [0, registerCount), names follow them */
+	uint32_t m_registerCount;
+	std::unordered_map <const VarAccess *, uint32_t> m_declarationIndex;
+	SymbolMap <uint32_t> m_nameIndex;
+
+	/* names are dumped with the number of variables of the same spelling before them, x, x#1, ... */
+	struct Name {
+		SymbolId name;
+		uint32_t shadowed;
+	};
+	std::vector <Name> m_names;
+	SymbolMap <uint32_t> m_spellings;
+	std::vector <UID> m_initial;
+
+	/* latest definition of a variable in every block */
+	std::vector <std::unordered_map <uint32_t, UID> > m_currentDef;
+	std::vector <uint32_t> m_unfilledPredecessors;
+	std::vector <bool> m_sealed;
+	std::vector <std::vector <UID> > m_incompletePhis;
+	std::vector <std::vector <UID> > m_phis;
 };
 
 } //namespace SSA
@@ -15,4 +15,7 @@ public:
 	yy::Parser::symbol_type token();
 private:
 	Driver &m_driver;
+	uint32_t m_longCommentStart = 0;
+	unsigned m_longCommentLevel = 0;
+	uint32_t m_longStringStart = 0;
 };
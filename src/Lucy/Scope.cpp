@@ -6,7 +6,7 @@
 #include "Scope.hpp"
 
 Scope::Scope(Scope *parent, Function *function)
-	: m_parent{parent}, m_function{function}
+	: m_parent{parent}, m_function{function}, m_functionBoundary{parent && parent->m_function != function}
 {
 }
 
@@ -25,105 +25,130 @@ Scope * Scope::push()
 	return m_children.back().get();
 }
 
-bool Scope::addFunctionParam(const std::string &name, const yy::location &location)
+bool Scope::addFunctionParam(SymbolId name, const Location &location)
 {
-	if (std::find_if(m_fnParams.begin(), m_fnParams.end(), [&name](const auto &param) { return param.name == name; }) != m_fnParams.end())
+	if (m_fnParamIndex.find(name))
 		return false;
 
+	m_fnParamIndex[name] = m_fnParams.size();
 	m_fnParams.emplace_back(name, location);
-	if (location == yy::location{})
+	if (location == Location{})
 		m_fnParams.back().synthetic = true;
 	return true;
 }
 
-void Scope::addLocalStore(const AST::LValue &var)
+const VarAccess & Scope::addLocalStore(const AST::LValue &var)
 {
-	const std::string &varName = var.resolveName();
-
-	if (Logger::isEnabled(Issue::Type::ShadowingDefinition)) {
-		for (auto iter = m_rwOps.crbegin(); iter != m_rwOps.crend(); ++iter) {
-			if (!(*iter)->isFunctionParameter()) {
-				const std::string &resolvedName = (*iter)->var().resolveName();
-				if (resolvedName != "_" && resolvedName == varName) {
-					Logger::logIssue<Issue::ShadowingDefinition>(var.location(), varName, (*iter)->var().location());
-				}
+	const SymbolId varName = var.resolveName();
+
+	if (varName != SymbolId::Underscore && Logger::isEnabled(Issue::Type::ShadowingDefinition)) {
+		if (const Binding *binding = m_bindings.find(varName)) {
+			for (uint32_t idx = binding->lastAccess; idx != NoAccess; idx = m_previousAccess[idx]) {
+				if (!m_rwOps[idx].isFunctionParameter())
+					Logger::logIssue<Issue::ShadowingDefinition>(var.location(), varName.str(), m_rwOps[idx].var().location());
 			}
 		}
 	}
 
-	m_rwOps.emplace_back(std::make_unique<VarAccess>(var, VarAccess::Type::Write, VarAccess::Storage::Local));
+	return appendAccess(varName, var, VarAccess::Type::Write, VarAccess::Storage::Local, nullptr, true);
 }
 
-void Scope::addVarAccess(const AST::LValue &var, VarAccess::Type type)
+const VarAccess & Scope::addVarAccess(const AST::LValue &var, VarAccess::Type type)
 {
-	const std::string &resolvedName = var.resolveName();
+	const SymbolId resolvedName = var.resolveName();
 
 	VarAccess::Storage storage = VarAccess::Storage::Global;
 	VarAccess *origin = nullptr;
-	Scope *currentScope = this, *originScope = nullptr;
+	Scope *originScope = nullptr;
 	bool closure = false;
 
-	while (!originScope && currentScope) {
-		for (auto iter = currentScope->m_rwOps.crbegin(); iter != currentScope->m_rwOps.crend(); ++iter) {
-			if ((*iter)->type() == VarAccess::Type::Write && (*iter)->var().resolveName() == resolvedName) {
-				storage = (*iter)->storage();
-				if (closure && storage == VarAccess::Storage::Local)
-					storage = VarAccess::Storage::Upvalue;
+	for (Scope *currentScope = this; currentScope; currentScope = currentScope->m_parent) {
+		const Binding *binding = currentScope->m_bindings.find(resolvedName);
+		if (binding && binding->lastWrite != NoAccess) {
+			origin = &currentScope->m_rwOps[binding->lastWrite];
+			storage = origin->storage();
+			if (closure && storage == VarAccess::Storage::Local)
+				storage = VarAccess::Storage::Upvalue;
 
-				originScope = currentScope;
-				origin = iter->get();
-				break;
-			}
+			originScope = currentScope;
+			break;
 		}
 
-		if (originScope)
-			break;
+		if (currentScope->m_functionBoundary) {
+			if (const unsigned *paramIdx = currentScope->m_fnParamIndex.find(resolvedName)) {
+				if (!closure)
+					storage = VarAccess::Storage::Local;
+				else
+					storage = VarAccess::Storage::Upvalue;
 
-		Scope *next = currentScope->parent();
-		if (next && next->functionScope() != currentScope->functionScope()) {
-			for (auto &param : currentScope->m_fnParams) {
-				if (resolvedName == param.name) {
-					if (!closure)
-						storage = VarAccess::Storage::Local;
-					else
-						storage = VarAccess::Storage::Upvalue;
-
-					param.used = true;
-					originScope = currentScope;
-					break;
-				}
+				currentScope->m_fnParams[*paramIdx].used = true;
+				originScope = currentScope;
+				break;
 			}
 
 			closure = true;
 		}
-
-		currentScope = next;
 	}
 
 	if (type == VarAccess::Type::Write) {
-		if (!originScope || (originScope != this && storage == VarAccess::Storage::Global)) {
-			if (resolvedName == "_")
-				Logger::logIssue<Issue::GlobalStore::Underscore>(var.location());
-			else if (isupper(resolvedName[0]))
-				Logger::logIssue<Issue::GlobalStore::UpperCase>(var.location(), resolvedName);
-			else if (!m_function)
-				Logger::logIssue<Issue::GlobalStore::GlobalScope>(var.location(), resolvedName);
-			else
-				Logger::logIssue<Issue::GlobalStore::FunctionScope>(var.location(), resolvedName);
-		}
+		if (!originScope || (originScope != this && storage == VarAccess::Storage::Global))
+			logGlobalStore(resolvedName, var.location(), m_function != nullptr);
 	}
 
-	m_rwOps.emplace_back(std::make_unique<VarAccess>(var, type, storage, origin));
+	return appendAccess(resolvedName, var, type, storage, origin);
+}
+
+const VarAccess * Scope::declaration(const AST::LValue &var)
+{
+	const SymbolId resolvedName = var.resolveName();
+
+	for (Scope *currentScope = this; currentScope; currentScope = currentScope->m_parent) {
+		const Binding *binding = currentScope->m_bindings.find(resolvedName);
+		if (binding && binding->lastWrite != NoAccess)
+			return currentScope->m_rwOps[binding->lastWrite].declaration();
+
+		if (currentScope->m_functionBoundary && currentScope->m_fnParamIndex.find(resolvedName))
+			return nullptr;
+	}
+
+	return nullptr;
+}
+
+void Scope::logGlobalStore(SymbolId name, const Location &location, bool functionScope)
+{
+	const std::string &spelling = name.str();
+	if (name == SymbolId::Underscore)
+		Logger::logIssue<Issue::GlobalStore::Underscore>(location);
+	else if (isupper(spelling[0]))
+		Logger::logIssue<Issue::GlobalStore::UpperCase>(location, spelling);
+	else if (!functionScope)
+		Logger::logIssue<Issue::GlobalStore::GlobalScope>(location, spelling);
+	else
+		Logger::logIssue<Issue::GlobalStore::FunctionScope>(location, spelling);
+}
+
+const VarAccess & Scope::appendAccess(SymbolId name, const AST::LValue &var, VarAccess::Type type, VarAccess::Storage storage, VarAccess *origin,
+	bool declaration)
+{
+	const uint32_t idx = m_rwOps.size();
+	m_rwOps.emplace_back(var, type, storage, origin, declaration);
+
+	Binding &binding = m_bindings[name];
+	m_previousAccess.push_back(binding.lastAccess);
+	binding.lastAccess = idx;
+	if (type == VarAccess::Type::Write)
+		binding.lastWrite = idx;
+	return m_rwOps.back();
 }
 
 void Scope::reportUnusedFnParams() const
 {
 	for (const auto &param : m_fnParams) {
 		if (!param.used && !param.synthetic) {
-			if (param.name == "_")
+			if (param.name == SymbolId::Underscore)
 				Logger::logIssue<Issue::Function::UnusedParamUnderscore>(param.location);
 			else
-				Logger::logIssue<Issue::Function::UnusedParam>(param.location, param.name);
+				Logger::logIssue<Issue::Function::UnusedParam>(param.location, param.name.str());
 		}
 	}
 
@@ -1,15 +1,16 @@
 #pragma once
 
+#include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "AST_fwd.hpp"
+#include "Location.hpp"
+#include "Symbol.hpp"
 #include "VarAccess.hpp"
 
-#include "location.hh"
-
 class Function;
 
 class Scope {
@@ -27,27 +28,49 @@ public:
 	Scope * push();
 
 	//TODO deprecate most of these
-	bool addFunctionParam(const std::string &name, const yy::location &location);
+	bool addFunctionParam(SymbolId name, const Location &location);
 	void addLoad(const AST::LValue &var);
-	void addLocalStore(const AST::LValue &var);
-	void addVarAccess(const AST::LValue &var, VarAccess::Type type);
+	const VarAccess & addLocalStore(const AST::LValue &var);
+	const VarAccess & addVarAccess(const AST::LValue &var, VarAccess::Type type);
+	/* declaration var would refer to, without recording an access */
+	const VarAccess * declaration(const AST::LValue &var);
 
 	void reportUnusedFnParams() const;
 
+	/* issues of an assignment to a global name, also used where no Scope is built */
+	static void logGlobalStore(SymbolId name, const Location &location, bool functionScope);
+
 private:
+	static constexpr uint32_t NoAccess = UINT32_MAX;
+
+	/* latest accesses of a name in this scope, indices to m_rwOps */
+	struct Binding {
+		uint32_t lastAccess = NoAccess;
+		uint32_t lastWrite = NoAccess;
+	};
+
+	const VarAccess & appendAccess(SymbolId name, const AST::LValue &var, VarAccess::Type type, VarAccess::Storage storage, VarAccess *origin,
+		bool declaration = false);
+
 	Scope *m_parent = nullptr;
 	Function *m_function = nullptr;
+	bool m_functionBoundary;
 	std::vector <std::unique_ptr <Scope> > m_children;
-	std::vector <std::unique_ptr <VarAccess> > m_rwOps;
+
+	/* m_previousAccess[i] is the previous access of the same name as m_rwOps[i] */
+	std::deque <VarAccess> m_rwOps;
+	std::vector <uint32_t> m_previousAccess;
+	SymbolMap <Binding> m_bindings;
 
 	struct FnParam {
-		FnParam(const std::string &name, const yy::location &location) : name{name}, location{location} {}
+		FnParam(SymbolId name, const Location &location) : name{name}, location{location} {}
 
-		std::string name;
-		yy::location location;
+		SymbolId name;
+		Location location;
 		bool used = false;
 		bool synthetic = false;
 	};
 
 	std::vector <FnParam> m_fnParams;
+	SymbolMap <unsigned> m_fnParamIndex;
 };
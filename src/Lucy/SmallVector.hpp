@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+/*
+ * Vector with room for N elements inside the object, allocating only when it
+ * grows past them. Meant for short lists of small values such as the edges of
+ * a block, so elements have to be trivially copyable.
+ */
+template <typename T, unsigned N>
+class SmallVector {
+	static_assert(std::is_trivially_copyable_v<T>, "elements are moved by copying them");
+
+public:
+	SmallVector() = default;
+	SmallVector(const SmallVector &) = delete;
+	void operator = (const SmallVector &) = delete;
+	SmallVector(SmallVector &&other) noexcept { *this = std::move(other); }
+	~SmallVector() = default;
+
+	SmallVector & operator = (SmallVector &&other) noexcept
+	{
+		m_heap = std::move(other.m_heap);
+		m_inline = other.m_inline;
+		m_size = other.m_size;
+		m_capacity = other.m_capacity;
+
+		other.m_size = 0;
+		other.m_capacity = N;
+		return *this;
+	}
+
+	T * begin() { return data(); }
+	T * end() { return data() + m_size; }
+	const T * begin() const { return data(); }
+	const T * end() const { return data() + m_size; }
+
+	T & operator [] (size_t idx) { return data()[idx]; }
+	const T & operator [] (size_t idx) const { return data()[idx]; }
+	T & back() { return data()[m_size - 1]; }
+
+	bool empty() const { return m_size == 0; }
+	size_t size() const { return m_size; }
+
+	void clear() { m_size = 0; }
+	void pop_back() { --m_size; }
+
+	void push_back(T value)
+	{
+		if (m_size == m_capacity)
+			grow();
+		data()[m_size++] = value;
+	}
+
+private:
+	T * data() { return m_heap ? m_heap.get() : m_inline.data(); }
+	const T * data() const { return m_heap ? m_heap.get() : m_inline.data(); }
+
+	void grow()
+	{
+		auto heap = std::make_unique<T[]>(m_capacity * 2);
+		std::copy(begin(), end(), heap.get());
+		m_heap = std::move(heap);
+		m_capacity *= 2;
+	}
+
+	std::unique_ptr <T[]> m_heap;
+	std::array <T, N> m_inline;
+	uint32_t m_size = 0;
+	uint32_t m_capacity = N;
+};
@@ -0,0 +1,40 @@
+#include <cassert>
+
+#include "AnalysisSession.hpp"
+#include "Symbol.hpp"
+
+SymbolId::SymbolId(std::string_view name)
+	: SymbolId{AnalysisSession::current().symbols().intern(name)}
+{
+}
+
+const std::string & SymbolId::str() const
+{
+	return AnalysisSession::current().symbols().spelling(*this);
+}
+
+std::ostream & operator << (std::ostream &os, SymbolId symbol)
+{
+	return os << symbol.str();
+}
+
+SymbolTable::SymbolTable()
+{
+	for (const char *name : {"", "_", "self", "arg"})
+		intern(name);
+
+	assert(m_spellings.size() == SymbolId::_PredefinedCount);
+}
+
+SymbolId SymbolTable::intern(std::string_view name)
+{
+	std::lock_guard <std::mutex> lock{m_mutex};
+
+	auto iter = m_ids.find(name);
+	if (iter != m_ids.end())
+		return SymbolId{iter->second};
+
+	const uint32_t id = m_spellings.size();
+	m_ids.emplace(m_spellings.emplace_back(name), id);
+	return SymbolId{id};
+}
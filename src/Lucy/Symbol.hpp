@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Identifier interned in the SymbolTable of the current AnalysisSession.
+ * Comparing and hashing compares the ids only, the spelling is looked up on
+ * demand (for printing and issue messages).
+ */
+class SymbolId {
+public:
+	/* interned by every SymbolTable in this order */
+	enum Predefined : uint32_t {
+		Empty,
+		Underscore,
+		Self,
+		Arg,
+		_PredefinedCount
+	};
+
+	constexpr SymbolId(Predefined id = Empty) : m_id{id} {}
+	SymbolId(const char *name) : SymbolId{std::string_view{name}} {}
+	explicit SymbolId(std::string_view name);
+	explicit SymbolId(const std::string &name) : SymbolId{std::string_view{name}} {}
+
+	bool empty() const { return m_id == Empty; }
+	const std::string & str() const;
+	uint32_t value() const { return m_id; }
+
+	friend bool operator == (SymbolId a, SymbolId b) { return a.m_id == b.m_id; }
+	friend bool operator != (SymbolId a, SymbolId b) { return a.m_id != b.m_id; }
+
+private:
+	friend class SymbolTable;
+	explicit constexpr SymbolId(uint32_t id) : m_id{id} {}
+
+	uint32_t m_id;
+};
+
+std::ostream & operator << (std::ostream &os, SymbolId symbol);
+
+namespace std {
+	template <>
+	struct hash <SymbolId> {
+		size_t operator () (SymbolId symbol) const noexcept { return symbol.value(); }
+	};
+}
+
+class SymbolTable {
+public:
+	SymbolTable();
+	SymbolTable(const SymbolTable &) = delete;
+	void operator = (const SymbolTable &) = delete;
+
+	/* safe to call from threads parsing parts of one file, unlike the lookups of spelling */
+	SymbolId intern(std::string_view name);
+	const std::string & spelling(SymbolId symbol) const { return m_spellings[symbol.value()]; }
+	size_t size() const { return m_spellings.size(); }
+
+private:
+	std::mutex m_mutex;
+	/* deque keeps the strings (and views of them used as keys) in place */
+	std::deque <std::string> m_spellings;
+	std::unordered_map <std::string_view, uint32_t> m_ids;
+};
+
+/*
+ * Open addressing hash map keyed by SymbolId with linear probing. Entries are
+ * never removed, so a lookup stops at the first unused slot.
+ */
+template <typename Value>
+class SymbolMap {
+public:
+	Value * find(SymbolId symbol)
+	{
+		return const_cast<Value *>(std::as_const(*this).find(symbol));
+	}
+
+	const Value * find(SymbolId symbol) const
+	{
+		if (m_slots.empty())
+			return nullptr;
+
+		for (size_t idx = slot(symbol.value()); ; idx = (idx + 1) & (m_slots.size() - 1)) {
+			if (m_slots[idx].key == symbol.value())
+				return &m_slots[idx].value;
+			if (m_slots[idx].key == Unused)
+				return nullptr;
+		}
+	}
+
+	/* inserts a default constructed value for symbols not present yet */
+	Value & operator [] (SymbolId symbol)
+	{
+		if (Value *value = find(symbol))
+			return *value;
+
+		if ((m_size + 1) * 4 > m_slots.size() * 3)
+			grow();
+
+		++m_size;
+		return insert(symbol.value(), Value{});
+	}
+
+	size_t size() const { return m_size; }
+
+private:
+	static constexpr uint32_t Unused = UINT32_MAX;
+
+	struct Slot {
+		uint32_t key = Unused;
+		Value value{};
+	};
+
+	size_t slot(uint32_t key) const
+	{
+		/* Fibonacci hashing, ids are dense so the upper bits of the product spread best */
+		return static_cast<uint32_t>(key * 2654435769u) >> (32 - m_bits);
+	}
+
+	Value & insert(uint32_t key, Value &&value)
+	{
+		size_t idx = slot(key);
+		while (m_slots[idx].key != Unused)
+			idx = (idx + 1) & (m_slots.size() - 1);
+
+		m_slots[idx].key = key;
+		m_slots[idx].value = std::move(value);
+		return m_slots[idx].value;
+	}
+
+	void grow()
+	{
+		std::vector <Slot> old;
+		old.swap(m_slots);
+
+		m_bits = m_bits ? m_bits + 1 : 3;
+		m_slots.resize(size_t{1} << m_bits);
+		for (auto &s : old) {
+			if (s.key != Unused)
+				insert(s.key, std::move(s.value));
+		}
+	}
+
+	std::vector <Slot> m_slots;
+	size_t m_size = 0;
+	unsigned m_bits = 0;
+};
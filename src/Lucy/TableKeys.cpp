@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include "Logger.hpp"
+#include "TableKeys.hpp"
+
+namespace {
+
+enum class KeyKind : uint64_t {
+	String = 1,
+	Integer,
+	Real,
+	Boolean,
+};
+
+uint64_t keyHash(KeyKind kind, uint64_t payload)
+{
+	//splitmix64 finalizer, the kind keeps a string and a number with the same payload apart
+	uint64_t x = payload ^ (static_cast<uint64_t>(kind) * 0x9e3779b97f4a7c15);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	x ^= x >> 31;
+	return x != 0 ? x : 1;
+}
+
+uint64_t stringHash(std::string_view s)
+{
+	//FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (unsigned char c : s)
+		hash = (hash ^ c) * 0x100000001b3;
+	return keyHash(KeyKind::String, hash);
+}
+
+uint64_t integerHash(long value)
+{
+	return keyHash(KeyKind::Integer, static_cast<uint64_t>(value));
+}
+
+uint64_t realHash(double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return keyHash(KeyKind::Real, bits);
+}
+
+std::string quoted(std::string_view s)
+{
+	std::string result;
+	result.reserve(s.size() + 2);
+	result += '"';
+	result += s;
+	result += '"';
+	return result;
+}
+
+template <typename Number>
+std::string numberText(Number value)
+{
+	char buffer[32];
+	const auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	return std::string(buffer, end);
+}
+
+} //namespace
+
+void TableKeys::clear()
+{
+	if (m_size != 0)
+		std::fill(m_slots.begin(), m_slots.end(), Slot{});
+	m_size = 0;
+	m_nextIndex = 1;
+}
+
+void TableKeys::addName(SymbolId name, const Location &field)
+{
+	addString(name.str(), field);
+}
+
+void TableKeys::addString(std::string_view value, const Location &field)
+{
+	if (const Location *first = insert(stringHash(value), field))
+		Logger::logIssue<Issue::Table::DuplicateKey>(field, quoted(value), *first);
+}
+
+void TableKeys::addInteger(long value, const Location &field)
+{
+	if (const Location *first = insert(integerHash(value), field))
+		Logger::logIssue<Issue::Table::DuplicateKey>(field, numberText(value), *first);
+}
+
+void TableKeys::addReal(double value, const Location &field)
+{
+	//[-2^63, 2^63) converts exactly, this also makes -0.0 the same key as 0
+	if (value >= -0x1p63 && value < 0x1p63 && value == static_cast<double>(static_cast<long>(value))) {
+		addInteger(static_cast<long>(value), field);
+		return;
+	}
+
+	if (const Location *first = insert(realHash(value), field))
+		Logger::logIssue<Issue::Table::DuplicateKey>(field, numberText(value), *first);
+}
+
+void TableKeys::addBoolean(bool value, const Location &field)
+{
+	if (const Location *first = insert(keyHash(KeyKind::Boolean, value), field))
+		Logger::logIssue<Issue::Table::DuplicateKey>(field, value ? "true" : "false", *first);
+}
+
+void TableKeys::addPositional(const Location &field)
+{
+	addInteger(m_nextIndex++, field);
+}
+
+const Location * TableKeys::insert(uint64_t hash, const Location &field)
+{
+	if ((m_size + 1) * 4 > m_slots.size() * 3)
+		grow();
+
+	for (size_t idx = hash & (m_slots.size() - 1); ; idx = (idx + 1) & (m_slots.size() - 1)) {
+		Slot &slot = m_slots[idx];
+		if (slot.hash == hash)
+			return &slot.field;
+
+		if (slot.hash == Unused) {
+			slot = Slot{hash, field};
+			++m_size;
+			return nullptr;
+		}
+	}
+}
+
+void TableKeys::grow()
+{
+	std::vector <Slot> slots(m_slots.empty() ? 16 : m_slots.size() * 2);
+	std::swap(slots, m_slots);
+
+	for (const Slot &slot : slots) {
+		if (slot.hash == Unused)
+			continue;
+
+		size_t idx = slot.hash & (m_slots.size() - 1);
+		while (m_slots[idx].hash != Unused)
+			idx = (idx + 1) & (m_slots.size() - 1);
+		m_slots[idx] = slot;
+	}
+}
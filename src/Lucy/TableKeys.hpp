@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "Location.hpp"
+#include "Symbol.hpp"
+
+/*
+ * Constant keys of one table constructor, reporting duplicate keys as they
+ * are added. Only a 64-bit hash of a key and the location of its field are
+ * kept, a table of any size needs no node per field. As in Lua, a name and a
+ * string with the same text are the same key, so are numbers of equal value.
+ */
+class TableKeys {
+public:
+	/* forgets the keys of the previous table, keeping the allocated space */
+	void clear();
+
+	void addName(SymbolId name, const Location &field);
+	void addString(std::string_view value, const Location &field);
+	void addInteger(long value, const Location &field);
+	/* a real with an integer value is the same key as the integer */
+	void addReal(double value, const Location &field);
+	void addBoolean(bool value, const Location &field);
+	/* field without a key, its key is the next integer index */
+	void addPositional(const Location &field);
+
+private:
+	struct Slot {
+		uint64_t hash = Unused;
+		Location field;
+	};
+
+	static constexpr uint64_t Unused = 0;
+
+	/* location of the field with the same key added before, nullptr for a new key */
+	const Location * insert(uint64_t hash, const Location &field);
+	void grow();
+
+	std::vector <Slot> m_slots;
+	size_t m_size = 0;
+	long m_nextIndex = 1;
+};
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
 #include "AST_fwd.hpp"
+#include "RValue.hpp"
 
-class RValue;
-
-using TableReference = std::pair <const RValue *, const RValue *>;
+/* table and key operands of a table assignment */
+using TableReference = std::pair <RValue, RValue>;
 using ResultPack = void *;
 
 using ValueVariant = std::variant <
@@ -15,7 +17,10 @@ using ValueVariant = std::variant <
 	long,
 	double,
 	std::string,
+	/* text owned by the tree or the session: string literals and names */
+	std::string_view,
 	const AST::Function *,
+	const AST::ConstTable *,
 	TableReference,
 	ResultPack
 >;
@@ -1,7 +1,8 @@
 #include "VarAccess.hpp"
 
-VarAccess::VarAccess(const AST::LValue &var, Type type, Storage storage, VarAccess *origin)
-	: m_var{var}, m_type{type}, m_storage{storage}, m_origin{origin}
+VarAccess::VarAccess(const AST::LValue &var, Type type, Storage storage, VarAccess *origin, bool declaration)
+	: m_var{var}, m_type{type}, m_storage{storage}, m_origin{origin},
+	  m_declaration{declaration ? this : origin ? origin->m_declaration : nullptr}
 {
 	if (m_origin)
 		m_origin->m_dependent.push_back(this);
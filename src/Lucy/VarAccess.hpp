@@ -20,7 +20,7 @@ public:
 		Local
 	);
 
-	VarAccess(const AST::LValue &var, Type type, Storage storage, VarAccess *origin = nullptr);
+	VarAccess(const AST::LValue &var, Type type, Storage storage, VarAccess *origin = nullptr, bool declaration = false);
 	VarAccess(const VarAccess &) = delete;
 	VarAccess(VarAccess &&) = default;
 	void operator = (const VarAccess &) = delete;
@@ -30,6 +30,8 @@ public:
 	Storage storage() const { return m_storage; }
 	Type type() const { return m_type; }
 	bool isFunctionParameter() const { return m_type == Type::Read && m_storage == Storage::Local && !m_origin; }
+	/* local store declaring the variable, nullptr for globals and function parameters */
+	const VarAccess * declaration() const { return m_declaration; }
 
 private:
 	const AST::LValue &m_var;
@@ -37,5 +39,6 @@ private:
 	Storage m_storage;
 
 	VarAccess *m_origin;
+	const VarAccess *m_declaration;
 	std::vector <VarAccess *> m_dependent;
 };
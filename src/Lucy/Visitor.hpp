@@ -0,0 +1,217 @@
+#pragma once
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+#include "AST.hpp"
+
+namespace AST {
+
+/* class of the nodes of each Node::Type, the type a node is cast to before being visited */
+template <unsigned type>
+struct NodeClass;
+
+#define AST_NODE_CLASS(T) template <> struct NodeClass <Node::Type::T> { using type = T; }
+
+AST_NODE_CLASS(Chunk);
+AST_NODE_CLASS(ExprList);
+AST_NODE_CLASS(NestedExpr);
+AST_NODE_CLASS(VarList);
+AST_NODE_CLASS(ParamList);
+AST_NODE_CLASS(Ellipsis);
+AST_NODE_CLASS(LValue);
+AST_NODE_CLASS(FunctionCall);
+AST_NODE_CLASS(MethodCall);
+AST_NODE_CLASS(Assignment);
+AST_NODE_CLASS(Value);
+AST_NODE_CLASS(TableCtor);
+AST_NODE_CLASS(ConstTable);
+AST_NODE_CLASS(Field);
+AST_NODE_CLASS(BinOp);
+AST_NODE_CLASS(UnOp);
+AST_NODE_CLASS(Break);
+AST_NODE_CLASS(Return);
+AST_NODE_CLASS(FunctionName);
+AST_NODE_CLASS(Function);
+AST_NODE_CLASS(If);
+AST_NODE_CLASS(While);
+AST_NODE_CLASS(Repeat);
+AST_NODE_CLASS(For);
+AST_NODE_CLASS(ForEach);
+
+#undef AST_NODE_CLASS
+
+/* for visit() templates shared by a fixed set of node classes */
+template <typename T, typename ...Ts>
+constexpr bool isOneOf = (std::is_same_v<T, Ts> || ...);
+
+/*
+ * Walker over Node trees dispatching on the node type through a table built at
+ * compile time, without virtual calls. Derived implements visit() for the class
+ * of every node type (an overload for a base class, like FunctionCall for
+ * MethodCall, is enough), a type without a matching overload fails to compile.
+ * Types a walker never expects to see are listed explicitly and passed to
+ * unexpected().
+ *
+ * Derived may define the hooks called by dispatch() around visit():
+ *  - bool enter(const Node &), false skips the node,
+ *  - void leave(const Node &), called for entered nodes only.
+ * stop() ends the walk, following dispatch() calls return false without
+ * visiting anything.
+ */
+template <typename Derived>
+class Visitor {
+public:
+	/* visits node by its type, false once the walk has been stopped */
+	bool dispatch(const Node &node)
+	{
+		using Thunk = void (*)(Derived &, const Node &);
+		static constexpr std::array <Thunk, Node::Type::_size> table = makeTable(std::make_integer_sequence<unsigned, Node::Type::_size>{});
+
+		if (m_stopped)
+			return false;
+
+		Derived &self = static_cast<Derived &>(*this);
+		if (self.enter(node)) {
+			table[node.type().value()](self, node);
+			self.leave(node);
+		}
+
+		return !m_stopped;
+	}
+
+	/* dispatches the direct children of node in source order */
+	void visitChildren(const Chunk &chunk) { dispatchAll(chunk.children()); }
+	void visitChildren(const ExprList &exprList) { dispatchAll(exprList.exprs()); }
+	void visitChildren(const NestedExpr &expr) { dispatch(expr.expr()); }
+	void visitChildren(const VarList &varList) { dispatchAll(varList.vars()); }
+	void visitChildren(const ParamList &) {}
+	void visitChildren(const Ellipsis &) {}
+
+	void visitChildren(const LValue &lval)
+	{
+		if (lval.lvalueType() != LValue::Type::Name && dispatch(lval.tableExpr()) && lval.lvalueType() == LValue::Type::Bracket)
+			dispatch(lval.keyExpr());
+	}
+
+	void visitChildren(const FunctionCall &call)
+	{
+		if (dispatch(call.functionExpr()))
+			dispatch(call.args());
+	}
+
+	void visitChildren(const Assignment &assignment)
+	{
+		if (dispatch(assignment.varList()))
+			dispatch(assignment.exprList());
+	}
+
+	void visitChildren(const Value &) {}
+	void visitChildren(const TableCtor &table) { dispatchAll(table.fields()); }
+	void visitChildren(const ConstTable &) {}
+
+	void visitChildren(const Field &field)
+	{
+		if (field.fieldType() != Field::Type::Brackets || dispatch(field.keyExpr()))
+			dispatch(field.valueExpr());
+	}
+
+	void visitChildren(const BinOp &binOp)
+	{
+		if (dispatch(binOp.left()))
+			dispatch(binOp.right());
+	}
+
+	void visitChildren(const UnOp &unOp) { dispatch(unOp.operand()); }
+	void visitChildren(const Break &) {}
+
+	void visitChildren(const Return &ret)
+	{
+		if (!ret.empty())
+			dispatch(ret.exprList());
+	}
+
+	void visitChildren(const FunctionName &) {}
+
+	void visitChildren(const Function &fnNode)
+	{
+		if ((fnNode.isAnonymous() || dispatch(fnNode.name())) && dispatch(fnNode.paramList()))
+			dispatch(fnNode.chunk());
+	}
+
+	void visitChildren(const If &ifNode)
+	{
+		for (size_t i = 0; i != ifNode.conditions().size(); ++i) {
+			if (!dispatch(*ifNode.conditions()[i]) || !dispatch(*ifNode.chunks()[i]))
+				return;
+		}
+
+		if (ifNode.hasElse())
+			dispatch(ifNode.elseNode());
+	}
+
+	void visitChildren(const While &loop)
+	{
+		if (dispatch(loop.condition()))
+			dispatch(loop.chunk());
+	}
+
+	void visitChildren(const Repeat &loop)
+	{
+		if (dispatch(loop.chunk()))
+			dispatch(loop.condition());
+	}
+
+	void visitChildren(const For &loop)
+	{
+		if (!dispatch(loop.startExpr()) || !dispatch(loop.limitExpr()))
+			return;
+		if (!loop.hasStepExpression() || dispatch(loop.stepExpr()))
+			dispatch(loop.chunk());
+	}
+
+	void visitChildren(const ForEach &loop)
+	{
+		if (dispatch(loop.variables()) && dispatch(loop.exprList()))
+			dispatch(loop.chunk());
+	}
+
+	bool stopped() const { return m_stopped; }
+
+protected:
+	bool enter(const Node &) { return true; }
+	void leave(const Node &) {}
+	void stop() { m_stopped = true; }
+
+	void unexpected(const Node &node)
+	{
+		FATAL(node.location() << " : Unexpected node type: " << node.type() << '\n');
+	}
+
+private:
+	template <unsigned type>
+	static void visitAs(Derived &self, const Node &node)
+	{
+		self.visit(static_cast<const typename NodeClass<type>::type &>(node));
+	}
+
+	template <unsigned ...types>
+	static constexpr auto makeTable(std::integer_sequence<unsigned, types...>)
+	{
+		return std::array <void (*)(Derived &, const Node &), sizeof...(types)>{&visitAs<types>...};
+	}
+
+	template <typename T>
+	void dispatchAll(const std::vector <NodePtr <T> > &nodes)
+	{
+		for (const auto &n : nodes) {
+			if (!dispatch(*n))
+				return;
+		}
+	}
+
+	bool m_stopped = false;
+};
+
+} //namespace AST
@@ -1,12 +1,9 @@
-%glr-parser
-%expect 130
-%expect-rr 1
-
 %code requires
 {
 
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <variant>
 
 class Driver;
@@ -21,14 +18,28 @@ class Driver;
 #include "Scanner.hpp"
 
 #undef yylex
-#define yylex driver.m_scanner.token
+#define yylex driver.nextToken
+
+/* as the default, plus the file of the location */
+#define YYLLOC_DEFAULT(Current, Rhs, N) \
+	do { \
+		if (N) { \
+			(Current).file = YYRHSLOC(Rhs, 1).file; \
+			(Current).begin = YYRHSLOC(Rhs, 1).begin; \
+			(Current).end = YYRHSLOC(Rhs, N).end; \
+		} else { \
+			(Current).file = YYRHSLOC(Rhs, 0).file; \
+			(Current).begin = (Current).end = YYRHSLOC(Rhs, 0).end; \
+		} \
+	} while (false)
 
 %}
 
 %skeleton "lalr1.cc"
 
 %defines
-%define define_location_comparison true
+%expect 0
+%define api.location.type {Location}
 %define api.parser.class {Parser}
 %define api.token.constructor
 %define api.value.type variant
@@ -39,8 +50,8 @@ class Driver;
 
 %start root
 
-%type <std::unique_ptr <AST::Chunk> > block chunk chunk_base else function_body_block
-%type <std::unique_ptr <AST::Node> > expr prefix_expr statement last_statement
+%type <std::unique_ptr <AST::Chunk> > block chunk chunk_base else function_body_block nonempty_chunk
+%type <std::unique_ptr <AST::Node> > expr prefix_expr statement last_statement table_ctor
 %type <std::pair <std::unique_ptr<AST::Node>, std::unique_ptr<AST::Chunk> > > else_if
 %type <std::vector <std::pair <std::unique_ptr<AST::Node>, std::unique_ptr<AST::Chunk> > > > else_if_list
 %type <std::unique_ptr <AST::If> > if
@@ -49,29 +60,34 @@ class Driver;
 %type <std::unique_ptr <AST::FunctionCall> > function_call
 %type <std::unique_ptr <AST::VarList> > var_list
 %type <std::unique_ptr <AST::LValue> > var
-%type <std::unique_ptr <AST::TableCtor> > field_list field_list_base table_ctor
-%type <std::unique_ptr <AST::Field> > field
+%type <std::vector <AST::TableField> > field_list field_list_base
+%type <AST::TableField> field
 %type <std::unique_ptr <AST::Function> > function function_body
 %type <std::unique_ptr <AST::FunctionName> > function_name function_name_base
 
 %token <long> INT_VALUE
 %token <double> REAL_VALUE
-%token <std::string> ID STRING_VALUE
+%token <SymbolId> ID
+%token <std::string_view> STRING_VALUE
 %token NIL TRUE FALSE ELLIPSIS
 %token BREAK RETURN FUNCTION DO WHILE END REPEAT UNTIL FOR IF THEN ELSE ELSEIF IN LOCAL
 %token HASH NOT
-%token LPAREN RPAREN LBRACKET RBRACKET LBRACE RBRACE DOT COMMA SEMICOLON COLON
+%token ASSIGN LPAREN RPAREN LBRACKET RBRACKET LBRACE RBRACE DOT COMMA SEMICOLON COLON
 %token END_OF_INPUT 0 "eof"
+/* function body up to and including its end, left unparsed by Driver::setLazyFunctions() */
+%token SKIPPED_BODY
 
-%right ASSIGN
-%left COMMA SEMICOLON
+/* A parenthesized expression following a prefix expression is always an
+ * argument list, never the start of a new statement (as in Lua 5.1). */
+%precedence PREFIX_EXPR
+%precedence LPAREN
 %left OR
 %left AND
 %left EQ NE LT LE GT GE
 %left CONCAT
 %left PLUS MINUS
 %left MUL DIV MOD
-%right NOT LENGTH
+%precedence NOT HASH
 %precedence NEGATE
 %right POWER
 
@@ -91,8 +107,17 @@ SEMICOLON {
 ;
 
 chunk :
+nonempty_chunk {
+	$$ = std::move($nonempty_chunk);
+}
+| %empty {
+	$$ = std::make_unique<AST::Chunk>(@$);
+}
+;
+
+nonempty_chunk :
 last_statement {
-	$$ = std::make_unique<AST::Chunk>(std::move(@$));
+	$$ = std::make_unique<AST::Chunk>(@$);
 	$$->append(std::move($last_statement));
 }
 | chunk_base last_statement {
@@ -102,9 +127,6 @@ last_statement {
 | chunk_base {
 	$$ = std::move($chunk_base);
 }
-| %empty {
-	$$ = std::make_unique<AST::Chunk>(@$);
-}
 ;
 
 chunk_base :
@@ -112,8 +134,8 @@ statement opt_semicolon {
 	$$ = std::make_unique<AST::Chunk>(@$);
 	$$->append(std::move($statement));
 }
-| chunk statement opt_semicolon {
-	$$ = std::move($chunk);
+| chunk_base[base] statement opt_semicolon {
+	$$ = std::move($base);
 	$$->append(std::move($statement));
 }
 ;
@@ -140,8 +162,14 @@ statement :
 var_list ASSIGN expr_list {
 	$$ = std::make_unique<AST::Assignment>(std::move($var_list), std::move($expr_list), @$);
 }
-| function_call {
-	$$ = std::move($function_call);
+| prefix_expr %prec PREFIX_EXPR {
+	/* A function call is the only prefix expression allowed as a statement,
+	 * deciding it here keeps the grammar free of reduce/reduce conflicts. */
+	if ($prefix_expr->type() != AST::Node::Type::FunctionCall) {
+		error(@$, "syntax error, unexpected expression statement");
+		YYABORT;
+	}
+	$$ = std::move($prefix_expr);
 }
 | DO block END {
 	$$ = std::move($block);
@@ -230,11 +258,7 @@ ELSEIF expr THEN block {
 ;
 
 else_if_list :
-else_if {
-	$$ = std::vector <std::pair <std::unique_ptr <AST::Node>, std::unique_ptr<AST::Chunk> > >{};
-	$$.emplace_back(std::move($else_if));
-}
-| else_if_list[base] else_if {
+else_if_list[base] else_if {
 	$$ = std::move($base);
 	$$.emplace_back(std::move($else_if));
 }
@@ -293,7 +317,7 @@ prefix_expr args {
 	$$ = std::make_unique<AST::FunctionCall>(std::move($prefix_expr), std::move($args), @$);
 }
 | prefix_expr COLON ID args {
-	yy::location fnExprLocation = @prefix_expr;
+	Location fnExprLocation = @prefix_expr;
 	fnExprLocation.end = @ID.end;
 	$args->prepend($prefix_expr->clone());
 	auto fnExpr = std::make_unique<AST::LValue>(std::move($prefix_expr), $ID, fnExprLocation);
@@ -331,11 +355,17 @@ LPAREN RPAREN function_body_block[block] {
 | LPAREN param_list RPAREN function_body_block[block] {
 	$$ = std::make_unique<AST::Function>(std::move($param_list), std::move($block), @$);
 }
+| LPAREN RPAREN SKIPPED_BODY {
+	$$ = std::make_unique<AST::Function>(std::make_unique<AST::ParamList>(), @SKIPPED_BODY, @$);
+}
+| LPAREN param_list RPAREN SKIPPED_BODY {
+	$$ = std::make_unique<AST::Function>(std::move($param_list), @SKIPPED_BODY, @$);
+}
 ;
 
 function_body_block :
-block END {
-	$$ = std::move($block);
+nonempty_chunk END {
+	$$ = std::move($nonempty_chunk);
 }
 | END {
 	$$ = std::make_unique<AST::Chunk>(@$);
@@ -461,7 +491,7 @@ NIL {
 | table_ctor {
 	$$ = std::move($table_ctor);
 }
-| prefix_expr {
+| prefix_expr %prec PREFIX_EXPR {
 	$$ = std::move($prefix_expr);
 }
 ;
@@ -471,7 +501,12 @@ LBRACE RBRACE {
 	$$ = std::make_unique<AST::TableCtor>(@$);
 }
 | LBRACE field_list RBRACE {
-	$$ = std::move($field_list);
+	/* the constructor is located at its first field */
+	const Location location = $field_list.front().location;
+	if (auto constTable = AST::ConstTable::fromFields(driver.constTables(), $field_list, location))
+		$$ = std::move(constTable);
+	else
+		$$ = std::make_unique<AST::TableCtor>(std::move($field_list), location);
 }
 ;
 
@@ -481,12 +516,11 @@ field_list : field_list_base opt_field_separator {
 
 field_list_base :
 field {
-	$$ = std::make_unique<AST::TableCtor>(@$);
-	$$->append(std::move($field));
+	$$.push_back(std::move($field));
 }
 | field_list_base[fields] field_separator field {
 	$$ = std::move($fields);
-	$$->append(std::move($field));
+	$$.push_back(std::move($field));
 }
 ;
 
@@ -506,19 +540,19 @@ field_separator {
 
 field :
 LBRACKET expr[key] RBRACKET ASSIGN expr[val] {
-	$$ = std::make_unique<AST::Field>(std::move($key), std::move($val), @$);
+	$$ = AST::TableField{AST::Field::Type::Brackets, SymbolId{}, std::move($key), std::move($val), @$};
 }
 | ID[key] ASSIGN expr[val] {
-	$$ = std::make_unique<AST::Field>(std::move($key), std::move($val), @$);
+	$$ = AST::TableField{AST::Field::Type::Literal, $key, nullptr, std::move($val), @$};
 }
 | expr[val] {
-	$$ = std::make_unique<AST::Field>(std::move($val), @$);
+	$$ = AST::TableField{AST::Field::Type::NoIndex, SymbolId{}, nullptr, std::move($val), @$};
 }
 ;
 
 %%
 
-void yy::Parser::error(const location &loc, const std::string &msg)
+void yy::Parser::error(const location_type &loc, const std::string &msg)
 {
 	std::ostringstream ss;
 	ss << "Parse error: " << loc << " : " << msg << '\n';
@@ -1,46 +1,42 @@
+#include <algorithm>
+#include <fstream>
+
+#include "AnalysisSession.hpp"
 #include "Config.hpp"
-#include "ControlFlowGraph.hpp"
-#include "Driver.hpp"
-#include "Scope.hpp"
+#include "Logger.hpp"
+#include "Project.hpp"
 
 int main(int argc, const char **argv)
 {
 	std::ios_base::sync_with_stdio(false);
 
-	Driver d;
 	Config conf;
 
 	conf.parse(getenv("LUCY_OPTIONS"));
 	conf.parse(argc, argv);
 
-	if (!conf.inputFile.empty())
-		d.setInputFile(conf.inputFile);
-
 	if (!conf.logOutput.empty())
 		Logger::setOutput(conf.logOutput);
 
 	if (conf.getOpt(Config::Option::WriteToStdout))
 		Logger::setOutput(std::cout);
 
-	if (d.parse() != 0)
-		return 1;
-
-	assert(d.chunks().size() == 1);
-	if (conf.getOpt(Config::Option::DumpAST)) {
-		d.chunks()[0]->print();
-		std::cout << std::flush;
-	}
+	AnalysisSession::current().setLineFilter(conf.lineFilter);
 
-	Scope globalScope;
-	ControlFlowGraph cfg{*d.chunks()[0], globalScope};
+	Project project{conf};
+	for (const auto &path : conf.inputFiles)
+		project.addPath(path);
 
-	if (conf.getOpt(Config::Option::DumpIR)) {
-		cfg.irDump();
-		std::cout << std::flush;
+	if (conf.fileListInput == "-") {
+		project.addFileList(std::cin);
+	} else if (!conf.fileListInput.empty()) {
+		std::ifstream fileList{conf.fileListInput};
+		if (fileList.fail())
+			FATAL("Unable to open file for reading: " << conf.fileListInput << '\n');
+		project.addFileList(fileList);
 	}
 
-	if (!conf.graphvizOutput.empty())
-		cfg.graphvizDump(conf.graphvizOutput);
+	const int result = project.run();
 
 	if (!conf.issuesOutput.empty()) {
 		std::ofstream output{conf.issuesOutput};
@@ -50,10 +46,10 @@ int main(int argc, const char **argv)
 		};
 
 		auto issueVec = Logger::foundIssues();
-		std::sort(issueVec.begin(), issueVec.end());
+		std::stable_sort(issueVec.begin(), issueVec.end());
 		for (const auto &issue : issueVec)
 			std::visit(printer, issue);
 	}
 
-	return 0;
+	return result;
 }
@@ -1,15 +1,16 @@
 %{
 
 #include "Driver.hpp"
+#include "Logger.hpp"
 
 #undef YY_DECL
 #define YY_DECL yy::Parser::symbol_type Scanner::token()
 
-static yy::position longStringStart;
-
 %}
 
+%x LongComment
 %x LongString
+%x ShortComment
 
 %option c++
 %option noyywrap
@@ -106,33 +107,86 @@ local {
 }
 
 \"(\\.|[^\\"])*\"|\'(\\.|[^\\'])*\' {
-	return yy::Parser::make_STRING_VALUE(std::string{YYText() + 1, static_cast<unsigned>(YYLeng() - 2)}, m_driver.location(YYText()));
+	/* the token text is in the buffer of the scanner, its value is viewed in the input instead */
+	const Location location = m_driver.location(YYLeng());
+	return yy::Parser::make_STRING_VALUE(m_driver.text(location.begin + 1, location.end - 1), location);
+}
+
+"--"\[=*\[ {
+	m_longCommentStart = m_driver.offset();
+	m_longCommentLevel = YYLeng() - 4;
+	m_driver.step(YYLeng());
+	BEGIN(LongComment);
+}
+
+"--" {
+	m_driver.step(YYLeng());
+	BEGIN(ShortComment);
+}
+
+<ShortComment>{
+	[^\n]+ {
+		m_driver.step(YYLeng());
+	}
+	\n {
+		m_driver.step();
+		BEGIN(INITIAL);
+	}
+	<<EOF>> {
+		BEGIN(INITIAL);
+		return yy::Parser::make_END_OF_INPUT(m_driver.location(YYText()));
+	}
+}
+
+<LongComment>{
+	[^\]]+ {
+		m_driver.step(YYLeng());
+	}
+	\]=*\] {
+		if (static_cast<unsigned>(YYLeng() - 2) == m_longCommentLevel) {
+			m_driver.step(YYLeng());
+			BEGIN(INITIAL);
+		} else {
+			//the closing bracket may start the real end of the comment
+			yyless(1);
+			m_driver.step();
+		}
+	}
+	\] {
+		m_driver.step();
+	}
+	<<EOF>> {
+		std::ostringstream ss;
+		ss << '[' << m_driver.locationFrom(m_longCommentStart).resolve().begin << "] Unfinished long comment\n";
+		m_driver.logError(ss.str());
+		Logger::abort();
+	}
 }
 
 \[{2} {
-	longStringStart = m_driver.position();
-	m_driver.location("[[");
+	m_longStringStart = m_driver.offset();
+	m_driver.step(2);
 	BEGIN(LongString);
 }
 
 <LongString>{
-	\n {
-		m_driver.nextLine();
-		yymore();
-	}
 	[^\]] {
 		m_driver.step();
 		yymore();
 	}
 	\][^\]] {
+		m_driver.step(2);
+		yymore();
+	}
+	\] {
 		m_driver.step();
 		yymore();
 	}
 	\]{2} {
 		BEGIN(INITIAL);
-		m_driver.location("]]");
-		const auto longStringEnd = m_driver.position();
-		return yy::Parser::make_STRING_VALUE(std::string{YYText(), static_cast<unsigned>(YYLeng() - 2)}, yy::location{longStringStart, longStringEnd});
+		m_driver.step(2);
+		const Location location = m_driver.locationFrom(m_longStringStart);
+		return yy::Parser::make_STRING_VALUE(m_driver.text(location.begin + 2, location.end - 2), location);
 	}
 }
 
@@ -253,19 +307,13 @@ local {
 }
 
 {ID} {
-	return yy::Parser::make_ID(YYText(), m_driver.location(YYText()));
+	return yy::Parser::make_ID(m_driver.symbols().intern({YYText(), static_cast<size_t>(YYLeng())}), m_driver.location(YYText()));
 }
 
-[ \t] {
-	m_driver.step();
+[ \t\r\n]+ {
+	m_driver.step(YYLeng());
 }
 
-[\n] {
-	m_driver.nextLine();
-}
-
-[\r] ;
-
 <<EOF>> {
 	return yy::Parser::make_END_OF_INPUT(m_driver.location(YYText()));
 }
@@ -274,7 +322,7 @@ local {
 	std::ostringstream ss;
 	ss << '[' << m_driver.location() << "] Unrecognized input token: '" << YYText() << "'\n";
 	m_driver.logError(ss.str());
-	exit(1);
+	Logger::abort();
 }
 
 %%
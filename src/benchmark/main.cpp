@@ -0,0 +1,158 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Lucy/AnalysisSession.hpp"
+#include "Lucy/Driver.hpp"
+#include "Lucy/MappedFile.hpp"
+
+namespace {
+
+struct Input {
+	std::string name;
+	const char *data;
+	size_t size;
+	size_t tokens;
+};
+
+std::string generateInput(size_t size)
+{
+	static const char *fragments[] = {
+		"local value = data[\"key\"] - 1 -- decrement\n",
+		"text = 'it\\'s -- not a comment'\n",
+		"--[==[\n  long comment with ]] and ]=] inside\n]==]\n",
+		"function f(a, b)\n\treturn a - b\nend\n",
+		"t = { name = \"unit\", hp = 100, armor = 25, speed = 1.5 }\n",
+		"-- short comment describing the next block of generated data\n",
+		"s = \"escaped \\\" quote\"\n",
+	};
+
+	std::mt19937 rng{0};
+	std::uniform_int_distribution <size_t> pick{0, std::size(fragments) - 1};
+	std::string result;
+	result.reserve(size + 128);
+	while (result.size() < size)
+		result += fragments[pick(rng)];
+
+	return result;
+}
+
+int withDriver(const Input &input, bool nativeLexer, const std::function <int(Driver &)> &func)
+{
+	std::ostringstream log;
+	AnalysisSession session;
+	session.setOutput(log);
+
+	return session.run([&input, &log, nativeLexer, &func]
+	{
+		Driver driver;
+		driver.setErrorStream(&log);
+		driver.useNativeLexer(nativeLexer);
+		driver.setInputBuffer(input.name, input.data, input.size);
+		return func(driver);
+	});
+}
+
+void measure(const char *label, const std::vector <Input> &inputs, unsigned repeat, const std::function <int(const Input &)> &run)
+{
+	size_t bytes = 0;
+	size_t tokens = 0;
+	int status = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i != repeat; ++i) {
+		for (const auto &input : inputs) {
+			status |= run(input);
+			bytes += input.size;
+			tokens += input.tokens;
+		}
+	}
+	const std::chrono::duration <double> elapsed = std::chrono::steady_clock::now() - start;
+
+	printf("%-10s %10.1f MiB/s %10.2f Mtokens/s%s\n", label, bytes / elapsed.count() / (1024 * 1024),
+		tokens / elapsed.count() / 1e6, status ? "   (parse errors)" : "");
+}
+
+[[noreturn]] void usage()
+{
+	puts(
+R"___(Parser throughput benchmark.
+
+Usage:
+  $ ./benchmark-Lucy [options] [file...]
+
+Without input files, a generated input is used.
+
+Options:
+  -n <count>             number of passes over the input (default: 10)
+  --size <MiB>           size of the generated input (default: 16)
+)___");
+	exit(1);
+}
+
+} //namespace
+
+int main(int argc, char **argv)
+{
+	unsigned repeat = 10;
+	size_t generatedSize = 16;
+	std::vector <std::string> filenames;
+
+	for (int i = 1; i < argc; ++i) {
+		if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--size") == 0) && i + 1 < argc) {
+			const unsigned long value = strtoul(argv[i + 1], nullptr, 10);
+			if (argv[i][1] == 'n')
+				repeat = value;
+			else
+				generatedSize = value;
+			++i;
+		} else if (argv[i][0] == '-') {
+			usage();
+		} else {
+			filenames.emplace_back(argv[i]);
+		}
+	}
+
+	std::string generated;
+	std::vector <MappedFile> files(filenames.size());
+	std::vector <Input> inputs;
+
+	if (filenames.empty()) {
+		generated = generateInput(generatedSize * 1024 * 1024);
+		inputs.push_back({"<generated>", generated.data(), generated.size(), 0});
+	}
+
+	for (size_t i = 0; i != filenames.size(); ++i) {
+		if (!files[i].open(filenames[i])) {
+			fprintf(stderr, "Unable to map file: %s\n", filenames[i].c_str());
+			return 1;
+		}
+		inputs.push_back({filenames[i], files[i].data(), files[i].size(), 0});
+	}
+
+	for (auto &input : inputs) {
+		withDriver(input, true, [&input](Driver &driver)
+		{
+			input.tokens = driver.countTokens();
+			return 0;
+		});
+	}
+
+	for (const bool nativeLexer : {false, true}) {
+		measure(nativeLexer ? "native" : "flex", inputs, repeat, [nativeLexer](const Input &input)
+		{
+			return withDriver(input, nativeLexer, [](Driver &driver)
+			{
+				return driver.parse();
+			});
+		});
+	}
+
+	return 0;
+}
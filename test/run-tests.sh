@@ -3,6 +3,18 @@
 LUCY="$(realpath ${1})"
 TEST_DIR="${2}"
 TMP="tmp.report"
+TMP_PARALLEL="tmp_parallel.report"
+TMP_TOKENS="tmp_tokens.txt"
+TMP_TOKENS_NATIVE="tmp_tokens_native.txt"
+TMP_DEEP="tmp_deep.lua"
+TMP_SSA="tmp.ssa"
+TMP_AST="tmp_ast.txt"
+TMP_AST_EDITED="tmp_ast_edited.txt"
+TMP_GENERATED="tmp_generated.lua"
+TMP_FILTERED="tmp_filtered.report"
+TMP_BAD="tmp_bad.lua"
+TMP_STDERR="tmp_stderr.txt"
+TMP_STDERR_PARALLEL="tmp_stderr_parallel.txt"
 
 RED="\e[1;31m"
 GREEN="\e[1;32m"
@@ -21,4 +33,157 @@ for f in ./test_*.lua; do
 
 	echo -e "[${f}] ${result}${NOCOLOR}"
 done
-rm -f "${TMP}"
+
+# all files in one run: the merged report must not depend on the number of jobs
+if ! "${LUCY}" --jobs 1 --dump-issues "${TMP}" ./test_*.lua > /dev/null 2>&1 \
+	|| ! "${LUCY}" --jobs 4 --dump-issues "${TMP_PARALLEL}" . > /dev/null 2>&1; then
+	result="${RED}ERROR"
+elif ! diff -q "${TMP}" "${TMP_PARALLEL}" || ! diff -q <(sort "${TMP}") <(cat ./test_*.report | sort); then
+	result="${RED}WRONG"
+else
+	result="${GREEN}OK"
+fi
+
+echo -e "[multi-file] ${result}${NOCOLOR}"
+
+# parse errors go to the log with the issues, whatever the number of jobs
+echo "local = 1" > "${TMP_BAD}"
+"${LUCY}" --jobs 1 --output "${TMP}" "${TMP_BAD}" ./test_fibo.lua > /dev/null 2> "${TMP_STDERR}"
+"${LUCY}" --jobs 2 --output "${TMP_PARALLEL}" "${TMP_BAD}" ./test_fibo.lua > /dev/null 2> "${TMP_STDERR_PARALLEL}"
+if ! grep -q "${TMP_BAD}" "${TMP}" || ! grep -q test_fibo "${TMP}"; then
+	result="${RED}WRONG"
+elif ! diff -q "${TMP}" "${TMP_PARALLEL}" || ! diff -q "${TMP_STDERR}" "${TMP_STDERR_PARALLEL}"; then
+	result="${RED}WRONG"
+else
+	result="${GREEN}OK"
+fi
+
+echo -e "[parse-error-jobs] ${result}${NOCOLOR}"
+
+# standard input analyzed through the library interface for in-memory buffers
+result="${GREEN}OK"
+for f in ./test_*.lua; do
+	if ! "${LUCY}" --stdin-name "${f}" --dump-issues "${TMP}" < "${f}" > /dev/null 2>&1; then
+		result="${RED}ERROR"
+		break
+	elif ! diff -q "${TMP}" "$(basename "${f}" lua)report"; then
+		result="${RED}WRONG"
+		break
+	fi
+done
+
+echo -e "[stdin-buffer] ${result}${NOCOLOR}"
+
+# both lexers must produce the same token stream
+result="${GREEN}OK"
+for f in ./test_*.lua; do
+	if ! "${LUCY}" --lexer flex --dump-tokens "${f}" > "${TMP_TOKENS}" 2>&1 \
+		|| ! "${LUCY}" --lexer native --dump-tokens "${f}" > "${TMP_TOKENS_NATIVE}" 2>&1; then
+		result="${RED}ERROR"
+		break
+	elif ! diff -q "${TMP_TOKENS}" "${TMP_TOKENS_NATIVE}"; then
+		result="${RED}WRONG"
+		break
+	fi
+done
+
+echo -e "[tokens] ${result}${NOCOLOR}"
+
+# SSA forms of the files with an expected one
+for f in ./test_*.ssa; do
+
+	if ! "${LUCY}" --dump-ssa "$(basename "${f}" ssa)lua" > "${TMP_SSA}" 2> /dev/null; then
+		result="${RED}ERROR"
+	elif ! diff -q "${TMP_SSA}" "${f}"; then
+		result="${RED}WRONG"
+	else
+		result="${GREEN}OK"
+	fi
+
+	echo -e "[${f}] ${result}${NOCOLOR}"
+done
+
+# a file reached by an incremental edit of its .base must look like the file parsed whole
+for f in ./test_*.base; do
+	lua="$(basename "${f}" base)lua"
+	result="${GREEN}OK"
+
+	for opts in "" "--lazy-functions"; do
+		if ! "${LUCY}" ${opts} --dump-ast --dump-issues "${TMP}" "${lua}" > "${TMP_AST}" 2> /dev/null \
+			|| ! "${LUCY}" ${opts} --edit-from "${f}" --dump-ast --dump-issues "${TMP_PARALLEL}" "${lua}" > "${TMP_AST_EDITED}" 2> /dev/null; then
+			result="${RED}ERROR"
+			break
+		elif ! diff -q "${TMP_AST}" "${TMP_AST_EDITED}" || ! diff -q "${TMP}" "${TMP_PARALLEL}"; then
+			result="${RED}WRONG"
+			break
+		fi
+	done
+
+	echo -e "[${f}] ${result}${NOCOLOR}"
+done
+
+# lazy function bodies and the line filter must not change the issues of the functions analyzed
+for ((i = 1; i <= 2000; ++i)); do
+	printf 'local function f%d(a, unused)\n\tlocal b = a + %d\n\tg%d = function(c) return b + c end\n\tfor k = 1, b do g%d(k) end\n\treturn b\nend\n' \
+		${i} ${i} ${i} ${i}
+done > "${TMP_GENERATED}"
+
+# the functions take lines 6n-5 to 6n, the filter below selects the 2nd and the 5th one
+LINES="7-12,25-26"
+result="${GREEN}OK"
+if ! "${LUCY}" --dump-issues "${TMP}" "${TMP_GENERATED}" > /dev/null 2>&1; then
+	result="${RED}ERROR"
+else
+	awk -F: '{ line = int($2) } (line >= 7 && line <= 12) || (line >= 25 && line <= 30)' "${TMP}" > "${TMP_FILTERED}"
+	for opts in "--lazy-functions" "--lines ${LINES}" "--lazy-functions --lines ${LINES}"; do
+		expected="${TMP}"
+		[[ "${opts}" == *--lines* ]] && expected="${TMP_FILTERED}"
+
+		if ! "${LUCY}" ${opts} --dump-issues "${TMP_PARALLEL}" "${TMP_GENERATED}" > /dev/null 2>&1; then
+			result="${RED}ERROR"
+			break
+		elif ! diff -q "${TMP_PARALLEL}" "${expected}"; then
+			result="${RED}WRONG"
+			break
+		fi
+	done
+fi
+
+echo -e "[lazy-lines] ${result}${NOCOLOR}"
+
+# splitting the input between parse jobs must not change the issues, each part needs at least 64 KiB
+result="${GREEN}OK"
+if (( $(wc -c < "${TMP_GENERATED}") < 4 * 65536 )); then
+	result="${RED}SMALL"
+else
+	for opts in "--parse-jobs 4" "--parse-jobs 4 --lazy-functions"; do
+		if ! "${LUCY}" ${opts} --dump-issues "${TMP_PARALLEL}" "${TMP_GENERATED}" > /dev/null 2>&1; then
+			result="${RED}ERROR"
+			break
+		elif ! diff -q "${TMP_PARALLEL}" "${TMP}"; then
+			result="${RED}WRONG"
+			break
+		fi
+	done
+fi
+
+echo -e "[parse-jobs] ${result}${NOCOLOR}"
+
+# a long chain of merges of one variable must not exhaust the stack while building the SSA form
+{
+	echo "local x"
+	for ((i = 0; i < 60000; ++i)); do
+		echo "if x then x = ${i} end"
+	done
+	echo "print(x)"
+} > "${TMP_DEEP}"
+
+if ! "${LUCY}" --dump-ssa "${TMP_DEEP}" > /dev/null 2>&1; then
+	result="${RED}ERROR"
+else
+	result="${GREEN}OK"
+fi
+
+echo -e "[ssa-depth] ${result}${NOCOLOR}"
+rm -f "${TMP}" "${TMP_PARALLEL}" "${TMP_TOKENS}" "${TMP_TOKENS_NATIVE}" "${TMP_DEEP}" "${TMP_SSA}" "${TMP_AST}" "${TMP_AST_EDITED}" "${TMP_GENERATED}" "${TMP_FILTERED}" \
+	"${TMP_BAD}" "${TMP_STDERR}" "${TMP_STDERR_PARALLEL}"
@@ -0,0 +1,11 @@
+local function defaults()
+	return {
+		size = 10,
+		size = 20,
+		colors = { "red", "green", [2] = "blue" },
+		hidden = nil,
+	}
+end
+
+local options = defaults()
+options.mixed = { 1, 2, [options.size] = 3, 2 }
@@ -0,0 +1,13 @@
+settings = {
+	name = "default",
+	["name"] = "override",
+	"first",
+	"second",
+	[2] = "third",
+	limits = { min = 0, max = nil, [-1] = true, [-1.0] = false },
+}
+
+Defaults = { enabled = true, enabled = false }
+settings.extra = { 1, 2, 3 }
+
+return { version = 1 }
@@ -0,0 +1,13 @@
+local greeting = "hello"
+
+local function greet(name)
+	print(greeting .. ", " .. name)
+end
+
+function shout(name)
+	local loud = string.upper(name)
+	greet(loud)
+end
+
+greet("world")
+shout("everyone")
@@ -0,0 +1,19 @@
+local n, t = 0, data
+for i = 1, #t do
+	local n = t[i]
+	if n then
+		print(n)
+	end
+end
+
+while n < 10 do
+	n = n + 1
+end
+
+local total = tonumber(n)
+print(total)
+local b = nil
+if total == nil then
+	b = total
+end
+print(b)